@@ -14,8 +14,8 @@
 VERSION_NUM=2.00.00
 printf "Quack Compiler - Testbench Version ${VERSION_NUM}\n\n"
 
-if [[ $# -ne 4 ]] ; then
-    echo "Correct command \"test_type_checker.sh <BinFile> <TestCsvFile> <SamplesFolder> <ExpectedOutFolder>\""
+if [[ $# -ne 4 && $# -ne 5 ]] ; then
+    echo "Correct command \"test_type_checker.sh <BinFile> <TestCsvFile> <SamplesFolder> <ExpectedOutFolder> [<Mode>]\""
     exit 1
 fi
 
@@ -25,6 +25,35 @@ SAMPLES_FOLDER=$3
 EXPECTED_OUT_FOLDER=$4
 BUILTINS_C_FILE=builtins.c
 BUILTINS_C_PATH=${SAMPLES_FOLDER}/${BUILTINS_C_FILE}
+# Compiler flag selecting the pipeline to test.  By default, C is generated from the AST.
+#   -O            C generated from the optimized SSA representation
+#   -S            x86-64 assembly linked against the runtime
+#   --run         Bytecode run by the compiler's interpreter
+#   --amalgamate  C that includes the runtime and is compiled alone
+#   --profile     C instrumented and run once, then recompiled with the profile it wrote
+MODE=$5
+COMPILER_FLAGS=${MODE}
+COMPILED_EXT=c
+LINKED_FILES=${BUILTINS_C_PATH}
+case "${MODE}" in
+    ""|-O)
+        ;;
+    -S)
+        COMPILED_EXT=S
+        ;;
+    --run)
+        ;;
+    --amalgamate)
+        LINKED_FILES=
+        ;;
+    --profile)
+        COMPILER_FLAGS=--profile-generate
+        ;;
+    *)
+        echo "Unknown mode \"${MODE}\""
+        exit 1
+        ;;
+esac
 
 PASSING_CNT=0
 TOTAL_TESTS=0
@@ -46,10 +75,11 @@ test_code_file () {
     local EXIT_CODE=$?
 
     BASE_FILENAME=$( echo "${TEST_FILE}" | rev | cut -d '.' -f 2- | rev )
-    COMPILED_C_FILE="${SAMPLES_FOLDER}/${BASE_FILENAME}.c"
-    rm ${COMPILED_C_FILE} &> /dev/null    
+    COMPILED_C_FILE="${SAMPLES_FOLDER}/${BASE_FILENAME}.${COMPILED_EXT}"
+    PROFILE_FILE="${SAMPLES_FOLDER}/${BASE_FILENAME}.profile"
+    rm ${COMPILED_C_FILE} ${PROFILE_FILE} &> /dev/null    
     
-    ${BIN} ${SAMPLES_FOLDER}/${TEST_FILE} &> /dev/null
+    ${BIN} ${COMPILER_FLAGS} ${SAMPLES_FOLDER}/${TEST_FILE} &> /dev/null
     local RETURN_CODE=$?
     if [[ ${RETURN_CODE} == ${TEST_PASSED} ]]; then
         COMPILE_PASSED=true
@@ -62,19 +92,42 @@ test_code_file () {
     if [[ ${RETURN_CODE} = ${EXIT_CODE} ]]; then
         
         if ${COMPILE_PASSED}; then
-            COMPILED_PROG=${SAMPLES_FOLDER}/a.out
-            rm -rf a.out ${COMPILED_PROG} &> /dev/null      
-            gcc ${COMPILED_C_FILE} ${BUILTINS_C_PATH} -o ${COMPILED_PROG} &> /dev/null
-            if [[ $? -ne 0 ]]; then
-                printf "generated output ${RED}does not compile${NOCOLOR}.\n"
-                return;
-            fi
-
             local PROG_OUT=${SAMPLES_FOLDER}/prog_out
             rm -rf ${PROG_OUT} &> /dev/null
-            ${COMPILED_PROG} > ${PROG_OUT}
 
-            if [[ $? -ne 0 ]]; then
+            if [[ ${MODE} == --run ]]; then
+                # The compiler runs the program itself and reports on stderr
+                ${BIN} ${MODE} ${SAMPLES_FOLDER}/${TEST_FILE} > ${PROG_OUT} 2> /dev/null
+                local PROG_CODE=$?
+            else
+                COMPILED_PROG=${SAMPLES_FOLDER}/a.out
+                rm -rf a.out ${COMPILED_PROG} &> /dev/null
+                gcc ${COMPILED_C_FILE} ${LINKED_FILES} -o ${COMPILED_PROG} &> /dev/null
+                if [[ $? -ne 0 ]]; then
+                    printf "generated output ${RED}does not compile${NOCOLOR}.\n"
+                    return;
+                fi
+                ${COMPILED_PROG} > ${PROG_OUT}
+                local PROG_CODE=$?
+            fi
+
+            if [[ ${PROG_CODE} -eq 0 && ${MODE} == --profile ]]; then
+                # The instrumented run wrote the profile that the rebuilt program is optimized with
+                if ! [[ -f ${PROFILE_FILE} ]]; then
+                    printf "instrumented program ${RED}did not write a profile${NOCOLOR}.\n"
+                    return;
+                fi
+                ${BIN} --profile-use ${SAMPLES_FOLDER}/${TEST_FILE} &> /dev/null \
+                    && gcc ${COMPILED_C_FILE} ${LINKED_FILES} -o ${COMPILED_PROG} &> /dev/null
+                if [[ $? -ne 0 ]]; then
+                    printf "output generated with the profile ${RED}does not compile${NOCOLOR}.\n"
+                    return;
+                fi
+                ${COMPILED_PROG} > ${PROG_OUT}
+                PROG_CODE=$?
+            fi
+
+            if [[ ${PROG_CODE} -ne 0 ]]; then
                 printf "generated code ${RED}exited with an error${NOCOLOR}.\n"
                 return;
             fi
@@ -101,7 +154,7 @@ test_code_file () {
     else
         printf "Test #${TOTAL_TESTS}: ${TEST_FILE} ${RED}FAILED${NOCOLOR} with return code ${RETURN_CODE}\n"
         # Rerun the command so the error message is visible.  Can comment out.
-        ${BIN} ${SAMPLES_FOLDER}/${TEST_FILE}
+        ${BIN} ${COMPILER_FLAGS} ${SAMPLES_FOLDER}/${TEST_FILE}
     fi
 }
 
@@ -136,6 +189,8 @@ get_exit_code() {
 ( find ${SAMPLES_FOLDER}*.c -type f -not -name ${BUILTINS_C_FILE} | xargs rm ) &> /dev/null 
 # Delete any already compiled binarys
 ( rm -rf ${SAMPLES_FOLDER}/*.out ) &> /dev/null
+# Delete any profiles left by instrumented programs
+( rm -f ${SAMPLES_FOLDER}/*.profile ) &> /dev/null
 
 # Exit code if the compiler passes
 get_exit_code "PASS"
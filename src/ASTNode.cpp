@@ -2,6 +2,7 @@
 // Created by Michal Young on 9/12/18.
 //
 
+#include <algorithm>
 #include <string>
 
 #include "ASTNode.h"
@@ -22,14 +23,62 @@ namespace AST {
                                          CodeGen::Settings settings,
                                          unsigned indent_lvl, bool is_lhs) const {
     std::string var_name = define_new_temp_var();
+    std::string type_name = type_->generated_object_type_name();
     PRINT_INDENT(indent_lvl);
-    settings.fout_ << type_->generated_object_type_name() << " " << (is_lhs?"* ":"") << var_name
-                   << " = " << (is_lhs ? "&(":"") <<  var_to_store << (is_lhs?")":"") << ";\n";
+    // The stored value may be of a subclass (e.g., a boxed Int in an Obj temporary)
+    if (!is_lhs && settings.hoisted_temps_ != nullptr) {
+      settings.hoisted_temps_->emplace_back(type_name, var_name);
+      settings.fout_ << var_name << " = (" << type_name << ")(" << var_to_store << ");\n";
+      return var_name;
+    }
+    settings.fout_ << type_name << " " << (is_lhs?"* ":"") << var_name << " = "
+                   << (is_lhs ? "&(" : "(" + type_name + ")(") << var_to_store << ")" << ";\n";
     if (!is_lhs)
       return var_name;
     return "(*" + var_name + ")";
   }
 
+  std::string ASTNode::generate_unboxed_temp_var(const std::string &val_to_store,
+                                                 CodeGen::Settings settings,
+                                                 unsigned indent_lvl) const {
+    std::string var_name = define_new_temp_var();
+    PRINT_INDENT(indent_lvl);
+    settings.fout_ << type_->generated_unboxed_type_name() << " " << var_name
+                   << " = " << val_to_store << ";\n";
+    return var_name;
+  }
+
+  bool ASTNode::is_unboxable() const {
+    return type_ != nullptr && type_->is_unboxable();
+  }
+
+  std::string ASTNode::box_value(Quack::Class *q_class, const std::string &val) {
+    if (q_class == Quack::Class::Container::Int())
+      return GENERATE_LIT_INT_FUNC "(" + val + ")";
+    assert(q_class == Quack::Class::Container::Bool());
+    return "(" + val + " ? " GENERATED_LIT_TRUE " : " GENERATED_LIT_FALSE ")";
+  }
+
+  std::string ASTNode::unbox_value(Quack::Class *q_class, const std::string &var) {
+    if (q_class == Quack::Class::Container::Int())
+      return GENERATED_INT_VALUE_FUNC "(" + var + ")";
+    assert(q_class == Quack::Class::Container::Bool());
+    std::string obj_type = Quack::Class::Container::Obj()->generated_object_type_name();
+    return "((" + obj_type + ") " GENERATED_LIT_TRUE " == (" + obj_type + ") " + var + ")";
+  }
+
+  std::string ASTNode::clazz_of(Quack::Class *q_class, const std::string &var) {
+    if (q_class->may_hold_tagged_int())
+      return GENERATED_CLASS_OF_FUNC "(" + var + ")";
+    return var + "->" GENERATED_CLASS_FIELD;
+  }
+
+  std::string ASTNode::generate_unboxed_code(CodeGen::Settings &settings,
+                                             unsigned indent_lvl) const {
+    std::string gen_var = generate_code(settings, indent_lvl, false);
+    return unbox_value(type_, gen_var);
+  }
+
   void ASTNode::generate_eval_branch(CodeGen::Settings settings, const unsigned indent_lvl,
                                      const std::string &true_label, const std::string &false_label){
     if (auto bool_lit = dynamic_cast<BoolLit*>(this)) {
@@ -42,10 +91,9 @@ namespace AST {
     if (auto bool_op = dynamic_cast<BoolOp*>(this))
       return bool_op->generate_eval_bool_op(settings, indent_lvl, true_label, false_label);
 
-    std::string gen_var = this->generate_code(settings, indent_lvl, false);
+    std::string gen_var = this->generate_unboxed_code(settings, indent_lvl);
     PRINT_INDENT(indent_lvl);
-    settings.fout_ << "if(" GENERATED_LIT_TRUE " == " << gen_var << ") { goto "
-                   << true_label << "; }\n";
+    settings.fout_ << "if(" << gen_var << ") { goto " << true_label << "; }\n";
 
     if (false_label != GENERATED_NO_JUMP)
       generate_goto(settings, indent_lvl, false_label, true);
@@ -225,6 +273,10 @@ namespace AST {
     if (is_lhs)
       throw std::runtime_error("Return cannot be on left hand side");
 
+    auto * call = dynamic_cast<ObjectCall*>(right_);
+    if (call != nullptr && call->generate_tail_call(settings, indent_lvl))
+      return NO_RETURN_VAR;
+
     std::string temp_var_name = right_->generate_code(settings, indent_lvl, is_lhs);
 
     PRINT_INDENT(indent_lvl);
@@ -235,6 +287,15 @@ namespace AST {
     return NO_RETURN_VAR;
   }
 
+  std::string UniOp::generate_unboxed_code(CodeGen::Settings &settings,
+                                           unsigned indent_lvl) const {
+    if (opsym != UNARY_OP_NEG || !right_->is_unboxable())
+      return ASTNode::generate_unboxed_code(settings, indent_lvl);
+
+    std::string right_var = right_->generate_unboxed_code(settings, indent_lvl);
+    return generate_unboxed_temp_var("(-" + right_var + ")", settings, indent_lvl);
+  }
+
   bool UniOp::perform_type_inference(TypeCheck::Settings &settings, Quack::Class *) {
     right_->perform_type_inference(settings, nullptr);
     type_ = right_->get_node_type();
@@ -266,6 +327,30 @@ namespace AST {
     return var_out;
   }
 
+  bool BinOp::is_native_op() const {
+    if (!left_->is_unboxable() || !right_->is_unboxable())
+      return false;
+    if (left_->get_node_type() != right_->get_node_type())
+      return false;
+    return left_->get_node_type() == Quack::Class::Container::Int() || opsym == "==";
+  }
+
+  std::string BinOp::generate_unboxed_code(CodeGen::Settings &settings,
+                                           unsigned indent_lvl) const {
+    if (!is_native_op())
+      return ASTNode::generate_unboxed_code(settings, indent_lvl);
+
+    std::string left_var = left_->generate_unboxed_code(settings, indent_lvl);
+    std::string right_var = right_->generate_unboxed_code(settings, indent_lvl);
+    // C lets the compiler assume a divisor is never zero (nor -1 with INT_MIN)
+    auto * divisor = dynamic_cast<IntLit*>(right_);
+    if (opsym == "/" && (divisor == nullptr || divisor->value_ == 0 || divisor->value_ == -1))
+      return generate_unboxed_temp_var(GENERATED_INT_DIVIDE_FUNC "(" + left_var + ", "
+                                       + right_var + ")", settings, indent_lvl);
+    return generate_unboxed_temp_var("(" + left_var + " " + opsym + " " + right_var + ")",
+                                     settings, indent_lvl);
+  }
+
   bool BinOp::perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) {
 
     bool success = left_->perform_type_inference(settings, nullptr);
@@ -324,6 +409,23 @@ namespace AST {
     return true;
   }
 
+  std::string Ident::generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
+                                   bool is_lhs) const {
+    if (is_lhs || !is_unboxed_local(settings))
+      return text_;
+
+    // Unboxed locals escaping into an object context must be boxed
+    Quack::Class * sym_type = settings.st_->get(text_, false)->get_type();
+    return generate_temp_var(box_value(sym_type, text_), settings, indent_lvl, false);
+  }
+
+  std::string Ident::generate_unboxed_code(CodeGen::Settings &settings,
+                                           unsigned indent_lvl) const {
+    if (is_unboxed_local(settings))
+      return text_;
+    return ASTNode::generate_unboxed_code(settings, indent_lvl);
+  }
+
   bool Ident::perform_type_inference(TypeCheck::Settings &settings, Quack::Class *parent_type) {
     // If the identifier is this, then mark as the type of this
     if (settings.this_class_ != nullptr && text_ == OBJECT_SELF) {
@@ -412,13 +514,89 @@ namespace AST {
 
     // Use a dynamic cast to handle a field reference, e.g., obj.<FieldName>
     // Store the field value in a temporary variable
-    if (auto ident = dynamic_cast<Ident*>(next_))
-      return generate_temp_var(left_obj + "->" + ident->text_, settings, indent_lvl, is_lhs);
+    if (auto ident = dynamic_cast<Ident*>(next_)) {
+      std::string field = left_obj + "->" + ident->text_;
+      if (is_unboxed_field()) {
+        assert(!is_lhs);
+        field = box_value(type_, field);
+      } else if (inline_field_class() != nullptr) {
+        assert(!is_lhs);
+        field = "&" + field;
+      }
+      return generate_temp_var(field, settings, indent_lvl, is_lhs);
+    }
 
     // THe code should never get here.  This indicates a logic error in the compiler
     throw std::runtime_error("Unexpected bottoming out of ObjectCall code generation");
   }
 
+  std::string ObjectCall::generate_unboxed_code(CodeGen::Settings &settings,
+                                                unsigned indent_lvl) const {
+    if (!is_unboxed_field())
+      return ASTNode::generate_unboxed_code(settings, indent_lvl);
+
+    // Copied since a later call may assign the field before the value is used
+    std::string left_obj = generate_receiver(settings, indent_lvl, false);
+    return generate_unboxed_temp_var(left_obj + "->" + dynamic_cast<Ident*>(next_)->text_,
+                                     settings, indent_lvl);
+  }
+
+  bool ObjectCall::is_unboxed_field() const {
+    auto * field = dynamic_cast<Ident*>(next_);
+    return field != nullptr && object_->get_node_type()->is_unboxed_field(field->text_);
+  }
+
+  Quack::Class * ObjectCall::inline_field_class() const {
+    auto * field = dynamic_cast<Ident*>(next_);
+    return field != nullptr ? object_->get_node_type()->inline_field_class(field->text_) : nullptr;
+  }
+
+  bool ObjectCall::generate_tail_call(CodeGen::Settings &settings, unsigned indent_lvl) const {
+    auto * func = dynamic_cast<FunctionCall*>(next_);
+    if (func == nullptr || settings.method_ == nullptr)
+      return false;
+    if (object_->get_node_type()->unique_implementation(func->ident_).second != settings.method_)
+      return false;
+
+    // The struct of a stack object is reinitialized if the method runs its constructor again
+    auto * obj = dynamic_cast<Ident*>(object_);
+    if (obj != nullptr && obj->is_stack_local(settings))
+      return false;
+
+    std::string receiver = obj != nullptr ? obj->text_
+                                          : object_->generate_code(settings, indent_lvl, false);
+    std::vector<std::string> * arg_vars = func->args_->generate_args(settings, indent_lvl);
+
+    // Locals are copied first since they may be this or a parameter assigned below
+    if (obj != nullptr && obj->text_ != OBJECT_SELF)
+      receiver = obj->generate_temp_var(receiver, settings, indent_lvl, false);
+    for (unsigned i = 0; i < arg_vars->size(); i++) {
+      ASTNode * arg = func->args_->args_[i];
+      if (dynamic_cast<Ident*>(arg) != nullptr)
+        (*arg_vars)[i] = arg->generate_temp_var((*arg_vars)[i], settings, indent_lvl, false);
+    }
+
+    Quack::Param::Container * params = settings.method_->params_;
+    for (unsigned i = 0; i < params->count(); i++) {
+      PRINT_INDENT(indent_lvl);
+      settings.fout_ << (*params)[i]->name_ << " = ("
+                     << (*params)[i]->type_->generated_object_type_name() << ")"
+                     << (*arg_vars)[i] << ";\n";
+    }
+    if (receiver != OBJECT_SELF) {
+      PRINT_INDENT(indent_lvl);
+      settings.fout_ << OBJECT_SELF << " = ("
+                     << settings.method_->obj_class_->generated_object_type_name() << ")"
+                     << receiver << ";\n";
+    }
+    delete arg_vars;
+
+    if (settings.entry_label_->empty())
+      *settings.entry_label_ = define_new_label("tail_call");
+    generate_goto(settings, indent_lvl, *settings.entry_label_, true);
+    return true;
+  }
+
   bool Typecase::perform_type_inference(TypeCheck::Settings &settings, Quack::Class *) {
     // type case does not have a type
     type_ = Quack::Class::Container::Nothing();
@@ -465,6 +643,22 @@ namespace AST {
     ss << gen_func_name_ << "(" << value_ << ")";
     return generate_temp_var(ss.str(), settings, indent_lvl, false);
   }
+  // Literals are also generated from translation units that cannot see the definition above
+  template std::string Literal<int>::generate_lit_code(CodeGen::Settings &, unsigned,
+                                                       const std::string &) const;
+  template std::string Literal<bool>::generate_lit_code(CodeGen::Settings &, unsigned,
+                                                        const std::string &) const;
+
+  std::string StrLit::generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
+                                    bool is_lhs) const {
+    std::ostringstream ss;
+    if (settings.literal_pool_ == nullptr)
+      ss << GENERATE_LIT_STRING_FUNC << "(\"" << value_ << "\")";
+    else
+      ss << "(" << type_->generated_object_type_name() << ") &"
+         << settings.literal_pool_->add(value_);
+    return generate_temp_var(ss.str(), settings, indent_lvl, false);
+  }
 
   std::string Typing::generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                                     bool is_lhs) const {
@@ -480,8 +674,9 @@ namespace AST {
   }
 
 
-  std::string FunctionCall::generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
-                                          bool is_lhs) const {
+  std::string FunctionCall::generate_constructor_call(CodeGen::Settings &settings,
+                                                      unsigned indent_lvl, bool is_lhs,
+                                                      const std::string &object) const {
     Quack::Class * q_class = Quack::Class::Container::singleton()->get(ident_);
     Quack::Param::Container * params = q_class->get_constructor()->params_;
     assert(q_class);
@@ -491,10 +686,13 @@ namespace AST {
     std::ostringstream ss;
     if (q_class != get_node_type())
       ss << "(" << get_node_type()->generated_object_type_name() << ")";
-    ss << q_class->generated_constructor_name() << "(";
+    if (object.empty())
+      ss << q_class->generated_constructor_name() << "(";
+    else
+      ss << q_class->generated_init_name() << "(" << object;
     assert(arg_vars->size() == params->count());
     for (unsigned i = 0; i < arg_vars->size(); i++) {
-      if (i != 0)
+      if (i != 0 || !object.empty())
         ss << ", ";
       ss << "(" << (*params)[i]->type_->generated_object_type_name() << ")" << (*arg_vars)[i];
     }
@@ -511,20 +709,72 @@ namespace AST {
 
     Quack::Method * method = obj_type->get_method(ident_);
 
+    // Call the implementation directly if it is the only one any receiver can reach
+    std::ostringstream ss;
+    auto impl = obj_type->unique_implementation(ident_);
+    if (impl.second != nullptr) {
+      method = impl.second;
+      ss << Quack::Class::generated_method_name(impl.first, method)
+         << generate_call_args(method, object_name, *func_tmp_args);
+    } else {
+      std::string clazz = clazz_of(obj_type, object_name);
+      std::string call = clazz + "->" + ident_
+                         + generate_call_args(method, object_name, *func_tmp_args);
+
+      // A receiver class that was the only one profiled is tested for and called directly
+      Quack::Class * hot_class = nullptr;
+      if (settings.profile_ != nullptr)
+        hot_class = profile_call_site(settings, indent_lvl, obj_type, clazz);
+      if (hot_class != nullptr) {
+        Quack::Method * hot_method = hot_class->get_method(ident_);
+        ss << "(__builtin_expect(" << clazz << "->" << GENERATED_CLASS_ID_FIELD << " == "
+           << hot_class->class_id_ << ", 1) ? ("
+           << method->return_type_->generated_object_type_name() << ")"
+           << Quack::Class::generated_method_name(hot_method->obj_class_, hot_method)
+           << generate_call_args(hot_method, object_name, *func_tmp_args) << " : " << call
+           << ")";
+      } else {
+        ss << call;
+      }
+    }
+    delete func_tmp_args;
+
+    return generate_temp_var(ss.str(), settings, indent_lvl, is_lhs);
+  }
+
+  std::string FunctionCall::generate_call_args(Quack::Method * method,
+                                               const std::string &object_name,
+                                               const std::vector<std::string> &arg_vars) {
     std::ostringstream ss;
-    ss << object_name << "->" << GENERATED_CLASS_FIELD << "->" << ident_ << "("
-        << "(" << method->obj_class_->generated_object_type_name() << ")" << object_name;
+    ss << "((" << method->obj_class_->generated_object_type_name() << ")" << object_name;
 
     Quack::Param::Container * params = method->params_;
-    assert(func_tmp_args->size() == params->count());
+    assert(arg_vars.size() == params->count());
     for (unsigned i = 0; i < params->count(); i ++) {
       Quack::Class * param_type = (*params)[i]->type_;
-      ss << ", " << "(" << param_type->generated_object_type_name() << ")" << (*func_tmp_args)[i];
+      ss << ", " << "(" << param_type->generated_object_type_name() << ")" << arg_vars[i];
     }
     ss << ")";
-    delete func_tmp_args;
+    return ss.str();
+  }
 
-    return generate_temp_var(ss.str(), settings, indent_lvl, is_lhs);
+  Quack::Class * FunctionCall::profile_call_site(CodeGen::Settings &settings, unsigned indent_lvl,
+                                                 Quack::Class * obj_type,
+                                                 const std::string &clazz) const {
+    unsigned site = settings.profile_->add_site("call:" + ident_);
+    if (settings.profile_->instrument()) {
+      PRINT_INDENT(indent_lvl);
+      settings.fout_ << CodeGen::Profile::generate_record(site, clazz);
+      return nullptr;
+    }
+
+    std::string class_name = settings.profile_->monomorphic_class(site);
+    if (class_name.empty())
+      return nullptr;
+    Quack::Class * hot_class = Quack::Class::Container::singleton()->get(class_name);
+    if (hot_class == OBJECT_NOT_FOUND || !hot_class->is_subtype(obj_type))
+      return nullptr;
+    return hot_class;
   }
 
   std::string Assn::generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
@@ -532,7 +782,48 @@ namespace AST {
     if (is_lhs)
       throw std::runtime_error("Cannot have assignment on LHS");
 
-    std::string rhs_var = rhs_->generate_code(settings, indent_lvl, false);
+    // Unboxed locals are assigned the native value directly
+    if (auto ident = dynamic_cast<Ident*>(lhs_->expr_)) {
+      if (ident->is_unboxed_local(settings)) {
+        std::string rhs_val = rhs_->generate_unboxed_code(settings, indent_lvl);
+        PRINT_INDENT(indent_lvl);
+        settings.fout_ << ident->text_ << " = " << rhs_val << ";\n";
+        return NO_RETURN_VAR;
+      }
+    }
+
+    // Unboxed fields are likewise assigned the native value
+    auto * field = dynamic_cast<ObjectCall*>(lhs_->expr_);
+    if (field != nullptr && field->is_unboxed_field()) {
+      std::string rhs_val = rhs_->generate_unboxed_code(settings, indent_lvl);
+      std::string left_obj = field->generate_receiver(settings, indent_lvl, false);
+      PRINT_INDENT(indent_lvl);
+      settings.fout_ << left_obj << "->" << dynamic_cast<Ident*>(field->next_)->text_ << " = "
+                     << rhs_val << ";\n";
+      return NO_RETURN_VAR;
+    }
+
+    // Inlined fields are only assigned by constructor calls, which initialize the embedded object
+    if (field != nullptr && field->inline_field_class() != nullptr) {
+      std::string left_obj = field->generate_receiver(settings, indent_lvl, false);
+      std::string name = dynamic_cast<Ident*>(field->next_)->text_;
+      PRINT_INDENT(indent_lvl);
+      settings.fout_ << left_obj << "->" << EMBEDDED_HEADER_FIELD << name << " = "
+                     << GENERATED_EMBEDDED_HEADER << ";\n";
+      dynamic_cast<FunctionCall*>(rhs_)->generate_constructor_call(settings, indent_lvl, false,
+                                                                   "&" + left_obj + "->" + name);
+      return NO_RETURN_VAR;
+    }
+
+    // Objects that never escape are constructed in the local's stack struct
+    std::string rhs_var;
+    auto * ident = dynamic_cast<Ident*>(lhs_->expr_);
+    auto * call = dynamic_cast<FunctionCall*>(rhs_);
+    if (ident != nullptr && call != nullptr && ident->is_stack_local(settings))
+      rhs_var = call->generate_constructor_call(settings, indent_lvl, false,
+                                                std::string("&") + STACK_OBJ_HEADER + ident->text_);
+    else
+      rhs_var = rhs_->generate_code(settings, indent_lvl, false);
     std::string lhs_var = lhs_->generate_code(settings, indent_lvl, true);
 
     PRINT_INDENT(indent_lvl);
@@ -604,7 +895,20 @@ namespace AST {
 
     std::string typecase_var = expr_->generate_code(settings, indent_lvl, false);
 
-    for (unsigned i = 0; i < alts_->size(); i++) {
+    // A profile may put the most frequent alternatives first and favor the most frequent class
+    std::vector<unsigned> order(alts_->size());
+    for (unsigned i = 0; i < alts_->size(); i++)
+      order[i] = i;
+    Quack::Class * hot_class = nullptr;
+    if (settings.profile_ != nullptr)
+      hot_class = profile_typecase(settings, indent_lvl, typecase_var, order);
+
+    // With multiple alternatives, a single switch on the class ID jumps to the first match
+    bool use_switch = alts_->size() > 1;
+    if (use_switch)
+      generate_typecase_switch(settings, indent_lvl, typecase_var, labels, hot_class);
+
+    for (unsigned i : order) {
       TypeAlternative * alt = (*alts_)[i];
 
       std::string tc_name = alt->type_names_[1];
@@ -617,14 +921,14 @@ namespace AST {
       Quack::Class * typecase_class = Quack::Class::Container::singleton()->get(tc_name);
 
       // Go To Next typecase check
-      PRINT_INDENT(indent_lvl);
-      settings.fout_ << "if(!" << GENERATED_IS_SUBTYPE_FUNC << "("
-                     << "(" << Quack::Class::Container::Obj()->generated_clazz_type_name() << ")"
-                     << typecase_var << "->"
-                     << GENERATED_CLASS_FIELD << ", "
-                     << "(" << Quack::Class::Container::Obj()->generated_clazz_type_name() << ")"
-                     << "(&" << typecase_class->generated_clazz_obj_struct_name() << ")"
-                     << ")) { goto " << labels[i+1] <<  "; }\n";
+      if (!use_switch) {
+        PRINT_INDENT(indent_lvl);
+        // Subclasses of the typecase class have class IDs within its preorder interval
+        settings.fout_ << "if(!" << GENERATED_CLASS_IN_RANGE << "("
+                       << clazz_of(expr_->get_node_type(), typecase_var) << ", "
+                       << typecase_class->class_id_ << ", " << typecase_class->subtree_end_
+                       << ")) { goto " << labels[i+1] <<  "; }\n";
+      }
 
       // Set assign the expression
       auto * var = new Ident(alt->type_names_[0].c_str());
@@ -634,6 +938,7 @@ namespace AST {
       typing->set_node_type(var_class);
 
       auto * other_var = new Ident(typecase_var.c_str());
+      other_var->set_node_type(var_class);
       Assn assn(typing, other_var);
       assn.generate_code(settings, indent_lvl+1, false);
       // Prevent an issue where the rhs is deleted
@@ -651,4 +956,97 @@ namespace AST {
     return NO_RETURN_VAR;
   }
 
+  void Typecase::generate_typecase_switch(CodeGen::Settings &settings, unsigned indent_lvl,
+                                          const std::string &typecase_var,
+                                          const std::vector<std::string> &labels,
+                                          Quack::Class * hot_class) const {
+    // Map each class ID to the label of the first alternative it matches
+    std::vector<unsigned> matches = match_alternatives();
+    auto num_classes = static_cast<unsigned>(matches.size());
+    std::vector<const std::string *> targets(num_classes);
+    for (unsigned id = 0; id < num_classes; id++)
+      targets[id] = &labels[matches[id]];
+
+    std::string clazz = clazz_of(expr_->get_node_type(), typecase_var);
+    if (hot_class != nullptr) {
+      PRINT_INDENT(indent_lvl);
+      settings.fout_ << "if (__builtin_expect(" << clazz << "->" << GENERATED_CLASS_ID_FIELD
+                     << " == " << hot_class->class_id_ << ", 1)) { goto "
+                     << *targets[hot_class->class_id_] << "; }\n";
+    }
+
+    PRINT_INDENT(indent_lvl);
+    settings.fout_ << "switch (" << clazz << "->" << GENERATED_CLASS_ID_FIELD << ") {\n";
+    // Consecutive IDs with the same target share a case range
+    for (unsigned first = 0; first < num_classes; ) {
+      unsigned last = first;
+      while (last + 1 < num_classes && targets[last + 1] == targets[first])
+        last++;
+      if (targets[first] != &labels.back()) {
+        PRINT_INDENT(indent_lvl + 1);
+        settings.fout_ << "case " << first;
+        if (last != first)
+          settings.fout_ << " ... " << last;
+        settings.fout_ << ": goto " << *targets[first] << ";\n";
+      }
+      first = last + 1;
+    }
+    PRINT_INDENT(indent_lvl + 1);
+    settings.fout_ << "default: goto " << labels.back() << ";\n";
+    PRINT_INDENT(indent_lvl);
+    settings.fout_ << "}\n";
+  }
+
+  Quack::Class * Typecase::profile_typecase(CodeGen::Settings &settings, unsigned indent_lvl,
+                                            const std::string &typecase_var,
+                                            std::vector<unsigned> &order) const {
+    unsigned site = settings.profile_->add_site(KEY_TYPECASE);
+    if (settings.profile_->instrument()) {
+      PRINT_INDENT(indent_lvl);
+      settings.fout_ << CodeGen::Profile::generate_record(
+          site, clazz_of(expr_->get_node_type(), typecase_var));
+      return nullptr;
+    }
+
+    // Alternatives only match classes they cover so the order of the code does not matter
+    std::vector<unsigned> matches = match_alternatives();
+    std::vector<unsigned long> alt_counts(alts_->size() + 1, 0);
+    unsigned long total = 0, hot_count = 0;
+    Quack::Class * hot_class = nullptr;
+    for (const auto &count : settings.profile_->histogram(site)) {
+      Quack::Class * q_class = Quack::Class::Container::singleton()->get(count.first);
+      if (q_class == OBJECT_NOT_FOUND || q_class->class_id_ >= matches.size())
+        continue;
+      alt_counts[matches[q_class->class_id_]] += count.second;
+      total += count.second;
+      if (count.second > hot_count) {
+        hot_class = q_class;
+        hot_count = count.second;
+      }
+    }
+    std::stable_sort(order.begin(), order.end(), [&alt_counts](unsigned a, unsigned b) {
+      return alt_counts[a] > alt_counts[b];
+    });
+
+    // Only a class seen most of the time is worth testing for ahead of the switch
+    return 2 * hot_count > total ? hot_class : nullptr;
+  }
+
+  std::vector<unsigned> Typecase::match_alternatives() const {
+    unsigned num_classes = Quack::Class::Container::Obj()->subtree_end_ + 1;
+    auto num_alts = static_cast<unsigned>(alts_->size());
+    std::vector<unsigned> matches(num_classes, num_alts);
+    for (unsigned id = 0; id < num_classes; id++) {
+      for (unsigned i = 0; i < num_alts; i++) {
+        Quack::Class * alt_class = Quack::Class::Container::singleton()->get(
+            (*alts_)[i]->type_names_[1]);
+        if (alt_class->class_id_ <= id && id <= alt_class->subtree_end_) {
+          matches[id] = i;
+          break;
+        }
+      }
+    }
+    return matches;
+  }
+
 }
@@ -29,6 +29,10 @@
 
 // Forward declaration
 namespace Quack { class Class; }
+namespace IR { struct Instr; struct BasicBlock; class Builder; }
+namespace ConstFold { struct Settings; }
+namespace Escape { struct Settings; }
+namespace Reach { struct Settings; }
 
 namespace AST {
   // Abstract syntax tree.  ASTNode is abstract base class for all other nodes.
@@ -88,9 +92,79 @@ namespace AST {
 
     virtual std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                                       bool is_lhs) const = 0;
+    /**
+     * Checks whether the value of this node can be generated as a native C value (i.e., int or
+     * bool) instead of a boxed object.
+     *
+     * @return True if the node's type is exactly Int or Boolean.
+     */
+    bool is_unboxable() const;
+    /**
+     * Generates the code for the node as a native C value.  By default, the boxed object is
+     * generated and then unboxed.  Nodes that can compute their value natively override this.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @return C expression containing the native value
+     */
+    virtual std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                              unsigned indent_lvl) const;
 
     void generate_eval_branch(CodeGen::Settings settings, const unsigned indent_lvl,
                               const std::string &true_label, const std::string &false_label);
+    /**
+     * Appends the SSA instructions that evaluate the node to the builder's current block.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Value of the node (native or object) or nullptr for statements
+     */
+    virtual IR::Instr * build_ir(IR::Builder &builder) const = 0;
+    /**
+     * Builds the SSA instructions that evaluate a Boolean node and branch on the result.
+     * Short-circuit operators branch directly without materializing their value.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @param true_block Block executed if the node is true
+     * @param false_block Block executed if the node is false
+     */
+    void build_ir_branch(IR::Builder &builder, IR::BasicBlock * true_block,
+                         IR::BasicBlock * false_block) const;
+
+    /**
+     * Folds the constant subexpressions of the node.  Nodes without any foldable children
+     * are returned unchanged.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @return Node that replaces this node.  If not this node, the caller deletes this node.
+     */
+    virtual ASTNode * fold_constants(ConstFold::Settings &settings) { return this; }
+    /**
+     * Folds a child node and replaces it with the result.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @param child Child to fold.  Updated in place.
+     */
+    static void fold_child(ConstFold::Settings &settings, ASTNode *&child) {
+      ASTNode * folded = child->fold_constants(settings);
+      if (folded == child)
+        return;
+      delete child;
+      child = folded;
+    }
+    /**
+     * Records the uses of local variables that may let their objects escape the method.
+     * Nodes without any such uses (e.g., literals) record nothing.
+     *
+     * @param settings Escape analysis settings for the enclosing method
+     */
+    virtual void find_escapes(Escape::Settings &settings) const {}
+    /**
+     * Records the classes and methods the node's generated code may use.  By default, only the
+     * node's type is recorded.
+     *
+     * @param settings Reachability settings for the enclosing method
+     */
+    virtual void find_reachable(Reach::Settings &settings) const;
 
     static std::string indent_str(unsigned indent_level) {
       return std::string(indent_level, '\t');
@@ -155,6 +229,41 @@ namespace AST {
      */
     std::string generate_temp_var(const std::string &var_to_store, CodeGen::Settings settings,
                                   unsigned indent_lvl, bool is_lhs) const;
+    /**
+     * Generates a new temporary variable storing a native (i.e., unboxed) value of the node's type.
+     *
+     * @param val_to_store Native C expression to store in the temporary
+     * @param settings Code generation settings
+     * @param indent_lvl Level of indentation
+     * @return Name of the temporary variable
+     */
+    std::string generate_unboxed_temp_var(const std::string &val_to_store,
+                                          CodeGen::Settings settings, unsigned indent_lvl) const;
+    /**
+     * Builds the C expression that boxes a native value of the specified type.
+     *
+     * @param q_class Either Int or Boolean
+     * @param val Native C value
+     * @return C expression for the boxed object
+     */
+    static std::string box_value(Quack::Class * q_class, const std::string &val);
+    /**
+     * Builds the C expression that extracts the native value from a boxed object.
+     *
+     * @param q_class Either Int or Boolean
+     * @param var Variable containing the boxed object
+     * @return Native C expression
+     */
+    static std::string unbox_value(Quack::Class * q_class, const std::string &var);
+    /**
+     * Builds the C expression for the clazz of an object.  References that may hold a tagged Int
+     * go through the runtime's tag check.
+     *
+     * @param q_class Static type of the object
+     * @param var Variable containing the object
+     * @return C expression for the object's clazz
+     */
+    static std::string clazz_of(Quack::Class * q_class, const std::string &var);
     /**
      * Standardizes creating a one line comment.
      *
@@ -254,8 +363,41 @@ namespace AST {
           return true;
       return false;
     }
+    /**
+     * Builds the SSA instructions for each statement.  Statements that can never execute
+     * (e.g., after a return) are skipped.
+     *
+     * @param builder SSA builder for the enclosing method
+     */
+    void build_ir(IR::Builder &builder) const;
+    /**
+     * Folds the constants in each statement.  If blocks whose condition is constant are
+     * replaced by the statements of the branch taken, While loops that never execute are
+     * removed, and statements after a return are dropped.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     */
+    void fold_constants(ConstFold::Settings &settings);
+    /**
+     * Records the escaping uses of local variables in each statement.
+     *
+     * @param settings Escape analysis settings for the enclosing method
+     */
+    void find_escapes(Escape::Settings &settings) const;
+    /**
+     * Records the classes and methods each statement may use.
+     *
+     * @param settings Reachability settings for the enclosing method
+     */
+    void find_reachable(Reach::Settings &settings) const;
 
     bool empty() { return stmts_.empty(); }
+    /**
+     * Accessor for the statements directly in the block.
+     *
+     * @return Statements in order
+     */
+    const std::vector<ASTNode *> &stmts() const { return stmts_; }
    private:
     std::vector<ASTNode *> stmts_;
   };
@@ -357,6 +499,19 @@ namespace AST {
     }
 
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
+    /**
+     * Detaches the branch selected by a constant condition.
+     *
+     * @return Block always executed or nullptr if the condition is not constant
+     */
+    Block * release_constant_branch();
    private:
     ASTNode *cond_; // The boolean expression to be evaluated
     Block *truepart_; // Execute this block if the condition is true
@@ -436,8 +591,49 @@ namespace AST {
      * @param indent_lvl Level of indentation.
      */
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl ,
-                              bool is_lhs) const override {
-      return text_;
+                              bool is_lhs) const override;
+    /**
+     * Unboxed locals are used directly.  All other identifiers are unboxed from their object.
+     *
+     * @param settings Code generator settings.
+     * @param indent_lvl Level of indentation.
+     */
+    std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                      unsigned indent_lvl) const override;
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+    /**
+     * Local variables known to hold a constant are replaced by a copy of the literal.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @return Literal or this node
+     */
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+    /**
+     * A variable used as a value may have its reference copied anywhere.
+     *
+     * @param settings Escape analysis settings for the enclosing method
+     */
+    void find_escapes(Escape::Settings &settings) const override;
+    /**
+     * Checks whether the identifier is a method local stored as a native C value.
+     *
+     * @param settings Code generator settings
+     * @return True if the identifier is an unboxed local
+     */
+    bool is_unboxed_local(const CodeGen::Settings &settings) const {
+      return settings.st_ != nullptr && settings.st_->exists(text_, false)
+             && settings.st_->get(text_, false)->is_unboxed();
+    }
+    /**
+     * Checks whether the identifier is a local whose object lives on the C stack.
+     *
+     * @param settings Code generator settings
+     * @return True if the local's object is stack allocated
+     */
+    bool is_stack_local(const CodeGen::Settings &settings) const {
+      return settings.st_ != nullptr && settings.st_->exists(text_, false)
+             && settings.st_->get(text_, false)->stack_class() != nullptr;
     }
     /** Identifier name */
     const std::string text_;
@@ -481,11 +677,33 @@ namespace AST {
       std::cout << std::to_string(value_);
     }
 
+    /**
+     * Generates the code for an Int literal.  When a literal pool is available, the literal
+     * references a static object rather than allocating a new one.
+     *
+     * @param settings Code generator setting
+     * @param indent_lvl Level of indention
+     */
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                               bool is_lhs) const override {
-      return generate_lit_code(settings, indent_lvl, GENERATE_LIT_INT_FUNC);
+      if (settings.literal_pool_ == nullptr)
+        return generate_lit_code(settings, indent_lvl, GENERATE_LIT_INT_FUNC);
+
+      const std::string &lit_name = settings.literal_pool_->add(value_);
+      return generate_temp_var(GENERATED_POOLED_INT_LIT "(" + lit_name + ", "
+                               + std::to_string(value_) + ")", settings, indent_lvl, false);
+    }
+
+    std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                      unsigned indent_lvl) const override {
+      // Folded literals may be negative.  Parenthesized so negation never forms a decrement
+      if (value_ < 0)
+        return "(" + std::to_string(value_) + ")";
+      return std::to_string(value_);
     }
 
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
   };
 
@@ -503,6 +721,13 @@ namespace AST {
       return GENERATED_LIT_FALSE;
     }
 
+    std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                      unsigned indent_lvl) const override {
+      return value_ ? "true" : "false";
+    }
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
   };
 
@@ -518,6 +743,8 @@ namespace AST {
       return GENERATED_LIT_NONE;
     }
 
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
   };
 
@@ -528,18 +755,16 @@ namespace AST {
       std::cout  << "\"" << value_ << "\"";
     }
     /**
-     * Generates the code to create a string literal.  It relies on the standardized literal
-     * generation method.
+     * Generates the code to create a string literal.  When a literal pool is available, the
+     * literal references a static object rather than allocating a new one.
      *
      * @param settings Code generator setting
      * @param indent_lvl Level of indention
      */
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
-                              bool is_lhs) const override {
-      std::ostringstream ss;
-      ss << GENERATE_LIT_STRING_FUNC << "(\"" << value_ << "\")";
-      return generate_temp_var(ss.str(), settings, indent_lvl, false);
-    }
+                              bool is_lhs) const override;
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
 
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
   };
@@ -583,6 +808,13 @@ namespace AST {
     bool contains_return_all_paths() override { return true; }
 
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
   };
 
   struct While : public ASTNode {
@@ -658,6 +890,19 @@ namespace AST {
 
       return NO_RETURN_VAR;
     }
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
+    /**
+     * Checks whether the loop condition folded to false.
+     *
+     * @return True if the body can never execute
+     */
+    bool never_executes() const;
   };
 
   struct RhsArgs : public ASTNode {
@@ -701,6 +946,31 @@ namespace AST {
                               bool is_lhs) const override {
       throw std::runtime_error("Cannot generate RHS args similar to normal args");
     }
+    /**
+     * Not supported.  Arguments must be built specially (see build_ir_args).
+     *
+     * @param builder SSA builder for the enclosing method
+     */
+    IR::Instr * build_ir(IR::Builder &builder) const override {
+      throw std::runtime_error("Cannot build RHS args similar to normal args");
+    }
+    /**
+     * Builds the SSA values of all arguments as objects.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Value of each argument
+     */
+    std::vector<IR::Instr*> build_ir_args(IR::Builder &builder) const;
+    /**
+     * Folds each argument in place.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @return Always this node
+     */
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
     /**
      * Generates the source code for all arguments in the argument set.
      *
@@ -713,7 +983,8 @@ namespace AST {
       std::vector<std::string> * gen_args = new std::vector<std::string>();
 
       for (auto * arg: args_) {
-        if (auto arg_cast = dynamic_cast<Ident *>(arg)) {
+        auto arg_cast = dynamic_cast<Ident *>(arg);
+        if (arg_cast && !arg_cast->is_unboxed_local(settings)) {
           gen_args->emplace_back(arg_cast->text_);
         } else {
           // Cannot have ARGS on LHS even if incoming is LHS
@@ -780,7 +1051,20 @@ namespace AST {
      * @return Variable where the output of the constructor is stored.
      */
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
-                              bool is_lhs) const override;
+                              bool is_lhs) const override {
+      return generate_constructor_call(settings, indent_lvl, is_lhs, "");
+    }
+    /**
+     * Generates a constructor call.
+     *
+     * @param settings Code generation settings
+     * @param indent_lvl Level of indentation
+     * @param object Pointer to the storage the caller allocated for the object.  If empty,
+     *               the constructor allocates the object.
+     * @return Variable where the output of the constructor is stored.
+     */
+    std::string generate_constructor_call(CodeGen::Settings &settings, unsigned indent_lvl,
+                                          bool is_lhs, const std::string &object) const;
 
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
     /**
@@ -794,6 +1078,41 @@ namespace AST {
     std::string generate_object_call(Quack::Class * obj_type, std::string object_name,
                                      CodeGen::Settings &settings, unsigned indent_lvl,
                                      bool is_lhs) const;
+    /**
+     * Generates the parenthesized arguments of a method call.  Each is cast to the parameter
+     * type of the implementation.
+     *
+     * @param method Method called
+     * @param object_name Receiver of the call
+     * @param arg_vars Variables holding the other arguments
+     * @return Argument list including the parentheses
+     */
+    static std::string generate_call_args(Quack::Method * method, const std::string &object_name,
+                                          const std::vector<std::string> &arg_vars);
+    /**
+     * Numbers a dynamically dispatched call as a profile site.  An instrumented build counts
+     * the receiver class; otherwise the class profiled as the only receiver is found.
+     *
+     * @param settings Code generator settings.  The profile must not be null.
+     * @param indent_lvl Level of indentation
+     * @param obj_type Static type of the receiver
+     * @param clazz Expression for the clazz of the receiver
+     * @return Class to call directly when it is the receiver's class.  nullptr if none.
+     */
+    Quack::Class * profile_call_site(CodeGen::Settings &settings, unsigned indent_lvl,
+                                     Quack::Class * obj_type, const std::string &clazz) const;
+    /**
+     * Builds a constructor call.  Method calls are built by ObjectCall.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Newly constructed object
+     */
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
   };
 
 
@@ -856,13 +1175,46 @@ namespace AST {
      */
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                               bool is_lhs) const override {
-      // Handle the bottom out of the recursion
-      if (auto obj = dynamic_cast<Ident*>(object_))
-        return process_object_call(obj->text_, settings, indent_lvl, is_lhs);
-
-      std::string left_obj = object_->generate_code(settings, indent_lvl, is_lhs);
+      std::string left_obj = generate_receiver(settings, indent_lvl, is_lhs);
       return process_object_call(left_obj, settings, indent_lvl, is_lhs);
     }
+    /**
+     * Reads an unboxed field without boxing it.  Any other object call is unboxed as usual.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @return Native temporary holding the field's value
+     */
+    std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                      unsigned indent_lvl) const override;
+    /**
+     * Generates the object on the left of the call.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @param is_lhs True if the node corresponds to a left hand side.
+     * @return Variable containing the receiver
+     */
+    std::string generate_receiver(CodeGen::Settings &settings, unsigned indent_lvl,
+                                  bool is_lhs) const {
+      // Handle the bottom out of the recursion.  Unboxed receivers must be boxed first.
+      auto obj = dynamic_cast<Ident*>(object_);
+      if (obj && !obj->is_unboxed_local(settings))
+        return obj->text_;
+      return object_->generate_code(settings, indent_lvl, is_lhs);
+    }
+    /**
+     * Checks whether this is a field reference whose value is stored natively in the object.
+     *
+     * @return True if the field is unboxed
+     */
+    bool is_unboxed_field() const;
+    /**
+     * Class of the object embedded in the receiver if this is a reference to an inlined field.
+     *
+     * @return Embedded class or nullptr
+     */
+    Quack::Class * inline_field_class() const;
     /**
      * After the left object is processed, process the right object.
      *
@@ -874,11 +1226,49 @@ namespace AST {
      */
     const std::string process_object_call(const std::string &left_obj, CodeGen::Settings &settings,
                                           unsigned indent_lvl, bool is_lhs) const;
+    /**
+     * Generates a returned call as a jump to the start of the method being generated.  This
+     * is only possible when the call can only reach that method, in which case the receiver
+     * and arguments are assigned to this and the parameters before the jump.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @return True if the jump was generated.  Otherwise, nothing is generated.
+     */
+    bool generate_tail_call(CodeGen::Settings &settings, unsigned indent_lvl) const;
 
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
 
     bool update_inferred_type(TypeCheck::Settings &settings, Quack::Class *inferred_type,
                               bool is_field) override;
+    /**
+     * Builds either a field load or a method call.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Field value or method result
+     */
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+    /**
+     * Folds the receiver and any method arguments.  A field name is never folded.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @return Always this node
+     */
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+    /**
+     * A method call on a local is recorded for the receiver's class to decide.  Reading a
+     * field of a local does not use the local's reference.
+     *
+     * @param settings Escape analysis settings for the enclosing method
+     */
+    void find_escapes(Escape::Settings &settings) const override;
+    /**
+     * A method call is recorded with the receiver's static type, which determines every
+     * implementation it may reach.
+     *
+     * @param settings Reachability settings for the enclosing method
+     */
+    void find_reachable(Reach::Settings &settings) const override;
   };
 
   struct BinOp : public ASTNode {
@@ -952,6 +1342,12 @@ namespace AST {
       if (is_lhs)
         throw std::runtime_error("Boolean operator cannot be on LHS");
 
+      // Operations on exact Int/Boolean operands are computed natively then boxed
+      if (is_native_op()) {
+        std::string native_var = generate_unboxed_code(settings, indent_lvl);
+        return generate_temp_var(box_value(type_, native_var), settings, indent_lvl, false);
+      }
+
       // Create the ObjectCall stand-in AST node
       RhsArgs args;
       args.add(right_);
@@ -973,28 +1369,80 @@ namespace AST {
       // No deletion needed.  Relies on the destructor of ObjectCall which is on the stack
       return obj_out;
     }
+    /**
+     * When both operands are exactly Int (or Boolean for equality), the operator is computed
+     * directly in C rather than through the clazz method table.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @return Temporary variable storing the native result
+     */
+    std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                      unsigned indent_lvl) const override;
+    /**
+     * Checks whether the operator can be computed natively in C.  This requires both operands
+     * have the same unboxable type.  Boolean only supports equality.
+     *
+     * @return True if the binary operator can be computed without a method call.
+     */
+    bool is_native_op() const;
 
     virtual bool perform_type_inference(TypeCheck::Settings &settings,
                                         Quack::Class * parent_type) override;
+    /**
+     * Native operators become native instructions.  All others are method calls.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Result of the operator
+     */
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+    /**
+     * Int arithmetic and comparisons as well as String concatenation and equality are
+     * evaluated when both operands are literals.  Operations the runtime could fail on
+     * (e.g., division by zero or overflow) are left for the runtime.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @return Literal result or this node
+     */
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
   };
 
   struct BoolOp : public BinOp {
     /** Boolean operator constructor */
     BoolOp(const std::string &sym, ASTNode *l, ASTNode *r) : BinOp(sym, l, r) {};
 
+    /** Boolean operators are computed inline and call no method. */
+    void find_reachable(Reach::Settings &settings) const override;
+
+    /**
+     * Boolean operators are always computed natively and then boxed.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @param is_lhs Must be false
+     * @return Temporary variable storing the boxed result
+     */
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                               bool is_lhs) const override {
       if (is_lhs)
         throw std::runtime_error("BoolOp cannot be a left hand side");
 
+      std::string native_var = generate_unboxed_code(settings, indent_lvl);
+      return generate_temp_var(box_value(type_, native_var), settings, indent_lvl, false);
+    }
+
+    std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                      unsigned indent_lvl) const override {
       if (opsym == UNARY_OP_NOT) {
         generate_one_line_comment(settings, indent_lvl, "NOT Start");
-        std::string op_var = left_->generate_code(settings, indent_lvl, is_lhs);
-        std::string gen_var = "(" + op_var + " == " + GENERATED_LIT_FALSE + ")";
-        return generate_temp_var(gen_var, settings, indent_lvl, false);
+        std::string op_var = left_->generate_unboxed_code(settings, indent_lvl);
+        return generate_unboxed_temp_var("(!" + op_var + ")", settings, indent_lvl);
       }
       // Variable that will store the evaluated result
-      std::string eval_bool = generate_temp_var(GENERATED_LIT_FALSE, settings, indent_lvl, false);
+      std::string eval_bool = generate_unboxed_temp_var("false", settings, indent_lvl);
 
       // Labels for jumping
       std::string bool_halfway = define_new_label(opsym + "_HALFWAY");
@@ -1020,7 +1468,7 @@ namespace AST {
       generate_one_line_comment(settings, indent_lvl, "Boolean Get True");
       generate_label(settings, indent_lvl, bool_true, true);
       PRINT_INDENT(indent_lvl);
-      settings.fout_ << eval_bool << " = " << GENERATED_LIT_TRUE << ";\n";
+      settings.fout_ << eval_bool << " = true;\n";
 
 
       // End Boolean
@@ -1059,6 +1507,21 @@ namespace AST {
     }
 
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class *parent_type) override;
+    /**
+     * Short-circuit operators branch to blocks that merge the native result in a phi.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Native Boolean result
+     */
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+    /**
+     * Short-circuit operators with a literal operand reduce to the other operand or to a
+     * literal.  The left operand is only dropped if evaluating it has no side effects.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @return Literal result, one of the operands, or this node
+     */
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
   };
 
   struct UniOp : public ASTNode {
@@ -1087,8 +1550,24 @@ namespace AST {
 
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                               bool is_lhs) const override;
+    /**
+     * Negation of an exact Int is computed natively.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @return Temporary variable storing the native result
+     */
+    std::string generate_unboxed_code(CodeGen::Settings &settings,
+                                      unsigned indent_lvl) const override;
 
     bool perform_type_inference(TypeCheck::Settings &settings, Quack::Class * parent_type) override;
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
   };
 
   struct Typing : public ASTNode {
@@ -1109,6 +1588,8 @@ namespace AST {
 
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                               bool is_lhs) const override;
+
+    IR::Instr * build_ir(IR::Builder &builder) const override;
 //    /**
 //     * Helper function used to check if the specified type name actually exists.
 //     *
@@ -1233,6 +1714,28 @@ namespace AST {
      */
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                               bool is_lhs) const override;
+    /**
+     * Builds an assignment to either a variable or a field.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Always nullptr
+     */
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+    /**
+     * Folds the right hand side and records the assigned value for constant propagation.
+     *
+     * @param settings Constant folding settings for the enclosing method
+     * @return Always this node
+     */
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+    /**
+     * Records assignments to locals.  Assigning a field never leaks the object whose field
+     * is assigned, but the assigned value escapes.
+     *
+     * @param settings Escape analysis settings for the enclosing method
+     */
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
   };
 
   struct Typecase : public ASTNode {
@@ -1302,8 +1805,56 @@ namespace AST {
 
     std::string generate_code(CodeGen::Settings &settings, unsigned indent_lvl,
                               bool is_lhs) const override;
+    /**
+     * Builds a switch on the class ID of the expression that goes to the first alternative
+     * each class matches.
+     *
+     * @param builder SSA builder for the enclosing method
+     * @return Always nullptr
+     */
+    IR::Instr * build_ir(IR::Builder &builder) const override;
+
+    ASTNode * fold_constants(ConstFold::Settings &settings) override;
+
+    void find_escapes(Escape::Settings &settings) const override;
+    void find_reachable(Reach::Settings &settings) const override;
 
    private:
+    /**
+     * Generates a switch on the class ID of the typecase expression.  Each class ID jumps
+     * directly to the first alternative it matches or to the end of the typecase if none match.
+     *
+     * @param settings Code generator settings
+     * @param indent_lvl Level of indentation
+     * @param typecase_var Variable holding the typecase expression
+     * @param labels Label of each alternative followed by the end of the typecase label
+     * @param hot_class If not null, this class is tested for before the switch
+     */
+    void generate_typecase_switch(CodeGen::Settings &settings, unsigned indent_lvl,
+                                  const std::string &typecase_var,
+                                  const std::vector<std::string> &labels,
+                                  Quack::Class * hot_class) const;
+    /**
+     * Numbers the typecase as a profile site.  An instrumented build counts the class of the
+     * expression; otherwise the alternatives are sorted so that the most frequent come first.
+     *
+     * @param settings Code generator settings.  The profile must not be null.
+     * @param indent_lvl Level of indentation
+     * @param typecase_var Variable holding the typecase expression
+     * @param order Order in which the alternatives are generated.  Updated in place.
+     * @return Class seen in most of the profiled executions.  nullptr if none.
+     */
+    Quack::Class * profile_typecase(CodeGen::Settings &settings, unsigned indent_lvl,
+                                    const std::string &typecase_var,
+                                    std::vector<unsigned> &order) const;
+    /**
+     * Finds the first alternative matched by each class.
+     *
+     * @return Index of the first matching alternative for each class ID.  If no alternative
+     *         matches, the number of alternatives.
+     */
+    std::vector<unsigned> match_alternatives() const;
+
     ASTNode* expr_;
     std::vector<TypeAlternative*>* alts_;
   };
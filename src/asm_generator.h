@@ -0,0 +1,225 @@
+//
+// Generation of x86-64 assembly for a whole Quack program.
+//
+
+#ifndef TYPE_CHECKER_ASM_GENERATOR_H
+#define TYPE_CHECKER_ASM_GENERATOR_H
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+
+#include "quack_program.h"
+#include "quack_class.h"
+#include "code_generator.h"
+#include "code_gen_utils.h"
+#include "ir_asm_emitter.h"
+#include "keywords.h"
+
+namespace CodeGen {
+  /**
+   * Alternative to Gen that writes x86-64 System V assembly rather than C.  Method bodies are
+   * generated from the SSA intermediate representation.  Objects and clazzes are laid out
+   * exactly as the C compiler lays out the structs of builtins.h and of the generated C on
+   * LP64 targets, so the output links directly against builtins.c:
+   *
+   *     gcc <quack_program_filename.S> builtins.c
+   *
+   * The ".S" output is run through the C preprocessor so that defining QUACK_GC or
+   * QUACK_NO_TAGGED_INT selects the matching runtime configuration just as for the C output.
+   */
+  class AsmGen {
+   public:
+    /** Offset of the class ID in a clazz */
+    static const unsigned CLASS_ID_OFFSET = 16;
+    /** Offset of the end of the class ID subtree in a clazz */
+    static const unsigned SUBTREE_END_OFFSET = 20;
+    /** Offset of the constructor in a clazz.  The methods follow. */
+    static const unsigned CONSTRUCTOR_OFFSET = 24;
+
+    /**
+     * Creates an assembly generator for a program.
+     *
+     * @param prog Type checked program
+     * @param quack_filename Path of the Quack source.  The ".S" file is written next to it.
+     * @param print_ir If true, the SSA form of each method is printed
+     */
+    AsmGen(Quack::Program * prog, const std::string &quack_filename, bool print_ir = false)
+        : prog_(prog), print_ir_(print_ir) {
+      output_file_path_ = Gen::output_path(quack_filename, ".S");
+      fout_.open(output_file_path_);
+    }
+
+    ~AsmGen() {
+      fout_.close();
+    }
+    /**
+     * Generates the output file associated with the specified program.
+     */
+    void run() {
+      Quack::Class::number_classes();
+
+      // Literals are only known after all code is generated but must be defined first
+      std::ostringstream code;
+      LiteralPool literal_pool;
+      CodeGen::Settings settings(code);
+      settings.literal_pool_ = &literal_pool;
+      settings.use_ir_ = true;
+      settings.print_ir_ = print_ir_;
+
+      fout_ << "/* Generated x86-64 assembly.  Assemble and link with builtins.c. */\n";
+      for (auto &class_pair : *Quack::Class::Container::singleton()) {
+        Quack::Class * q_class = class_pair.second;
+        if (!q_class->is_user_class())
+          continue;
+        export_clazz(q_class);
+
+        IR::AsmEmitter::generate_function(settings, q_class->generated_constructor_name(),
+                                          q_class->get_constructor(), q_class, true);
+        for (const auto &method_info : *q_class->methods_)
+          IR::AsmEmitter::generate_function(
+              settings, Quack::Class::generated_method_name(q_class, method_info.second),
+              method_info.second, q_class, false);
+      }
+      IR::AsmEmitter::generate_function(settings, METHOD_MAIN, prog_->main_, nullptr, false);
+      export_main(code);
+
+      export_literal_pool(literal_pool);
+      fout_ << code.str()
+            << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+      std::cout << "Code generation completed successfully." << std::endl;
+    }
+    /**
+     * Offset of a field within objects of a class.
+     *
+     * @param q_class Static type of the object
+     * @param name Field name
+     * @return Byte offset from the start of the object
+     */
+    static unsigned field_offset(Quack::Class * q_class, const std::string &name) {
+      return 8 * (q_class->generated_field_index(name) + 1);
+    }
+    /**
+     * Offset of a method's function pointer within the clazz of a class.
+     *
+     * @param q_class Static type of the receiver
+     * @param name Method name
+     * @return Byte offset from the start of the clazz
+     */
+    static unsigned method_offset(Quack::Class * q_class, const std::string &name) {
+      return CONSTRUCTOR_OFFSET + 8 * (q_class->generated_method_index(name) + 1);
+    }
+    /**
+     * Size of an object of a class.
+     *
+     * @param q_class User class
+     * @return Bytes allocated for each object
+     */
+    static unsigned object_size(Quack::Class * q_class) {
+      return 8 * static_cast<unsigned>(Quack::Class::build_generated_fields(q_class)->size() + 1);
+    }
+
+   private:
+    /**
+     * Writes the reference field offsets, the clazz, and the clazz pointer of a user class.
+     *
+     * @param q_class User class
+     */
+    void export_clazz(Quack::Class * q_class) {
+      fout_ << "\n\t.section .rodata\n\t.p2align 3\n"
+            << q_class->generated_ref_offsets_name() << ":\n";
+      // Unboxed fields keep their native value sign extended to the whole slot
+      for (const auto &field_info : *Quack::Class::build_generated_fields(q_class))
+        if (!q_class->is_unboxed_field(field_info.second->name_))
+          fout_ << "\t.quad " << field_offset(q_class, field_info.second->name_) << "\n";
+      fout_ << "\t.quad 0\n";
+
+      std::string clazz_struct = q_class->generated_clazz_obj_struct_name();
+      fout_ << "\n\t.data\n\t.p2align 3\n\t.globl " << clazz_struct << "\n" << clazz_struct
+            << ":\n"
+            << "\t.quad " << q_class->super_->generated_clazz_obj_struct_name() << "\n"
+            << "\t.quad " << q_class->generated_ref_offsets_name() << "\n"
+            << "\t.long " << q_class->class_id_ << ", " << q_class->subtree_end_ << "\n"
+            << "\t.quad " << q_class->generated_constructor_name() << "\n";
+      for (const auto &method_info : *Quack::Class::build_generated_methods(q_class))
+        fout_ << "\t.quad "
+              << Quack::Class::generated_method_name(method_info.first, method_info.second)
+              << "\n";
+
+      std::string clazz = q_class->generated_clazz_obj_name();
+      fout_ << "\t.globl " << clazz << "\n" << clazz << ":\n\t.quad " << clazz_struct << "\n";
+    }
+    /**
+     * Writes the statically allocated objects for all literals in the program.  Int literals
+     * are only needed when the runtime does not tag Int values.
+     *
+     * @param literal_pool Literals used by the program
+     */
+    void export_literal_pool(const LiteralPool &literal_pool) {
+      if (literal_pool.ints().empty() && literal_pool.strs().empty())
+        return;
+
+      fout_ << "\n/*======================= Literal Pool =======================*/\n"
+            << "\t.data\n\t.p2align 3\n";
+      Quack::Class * int_class = Quack::Class::Container::Int();
+      if (!literal_pool.ints().empty()) {
+        fout_ << "#ifdef QUACK_NO_TAGGED_INT\n";
+        for (const auto &lit : literal_pool.ints())
+          fout_ << lit.second << ":\n\t.quad " << int_class->generated_clazz_obj_struct_name()
+                << "\n\t.long " << lit.first << ", 0\n";
+        fout_ << "#endif\n";
+      }
+
+      // The length is the number of bytes the assembler produces for the escaped text
+      Quack::Class * str_class = Quack::Class::Container::Str();
+      for (const auto &lit : literal_pool.strs())
+        fout_ << lit.second << ":\n\t.quad " << str_class->generated_clazz_obj_struct_name()
+              << "\n\t.quad " << lit.second << "_text\n"
+              << "\t.quad " << lit.second << "_end - " << lit.second << "_text\n"
+              << "\t.quad 0, 0\n";
+
+      fout_ << "\t.section .rodata\n";
+      for (const auto &lit : literal_pool.strs())
+        fout_ << lit.second << "_text:\n\t.ascii \"" << lit.first << "\"\n"
+              << lit.second << "_end:\n\t.byte 0\n";
+    }
+    /**
+     * Writes the main() function.  It fills in the builtin class intervals then calls the
+     * function generated for the main block.
+     *
+     * @param out Stream to write to
+     */
+    void export_main(std::ostream &out) {
+      out << "\n\t.text\n\t.p2align 4\n\t.globl main\n\t.type main, @function\nmain:\n"
+          << "\tpushq %rbp\n\tmovq %rsp, %rbp\n";
+
+      // The runtime cannot know how user classes extend the builtin class intervals
+      for (auto &class_pair : *Quack::Class::Container::singleton()) {
+        Quack::Class * q_class = class_pair.second;
+        if (q_class->is_user_class())
+          continue;
+        std::string clazz_struct = q_class->generated_clazz_obj_struct_name();
+        out << "\tmovl $" << q_class->class_id_ << ", " << clazz_struct << "+"
+            << CLASS_ID_OFFSET << "(%rip)\n"
+            << "\tmovl $" << q_class->subtree_end_ << ", " << clazz_struct << "+"
+            << SUBTREE_END_OFFSET << "(%rip)\n";
+      }
+
+      out << "\tcall " << METHOD_MAIN << "\n"
+          << "\txorl %eax, %eax\n\tpopq %rbp\n\tret\n"
+          << "\t.size main, .-main\n";
+    }
+
+    /** Location to which the generated assembly is written */
+    std::string output_file_path_;
+    /** Filestream where the generated assembly is written */
+    std::ofstream fout_;
+
+    const Quack::Program * prog_;
+    /** Print the SSA form of each method */
+    const bool print_ir_;
+  };
+}
+
+#endif //TYPE_CHECKER_ASM_GENERATOR_H
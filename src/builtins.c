@@ -7,10 +7,389 @@
 #include <stdlib.h>  /* Malloc lives here; might replace with gc.h    */
 #include <string.h>  /* For strcpy; might replace with cords.h from gc */
 #include <stdbool.h>
+#include <stdarg.h>
+#include <unistd.h>  /* For isatty */
+#include <limits.h>
+#include <signal.h>
 
 #include "builtins.h"
 
 
+/* ==============
+ * Allocation
+ * ==============
+ */
+
+/* Every block starts with a one word header holding the block size and flags */
+#define QUACK_BLOCK_MARKED ((size_t) 1)
+#define QUACK_BLOCK_RAW ((size_t) 2)
+#define QUACK_BLOCK_FREE ((size_t) 4)
+#define QUACK_BLOCK_FLAGS (QUACK_BLOCK_MARKED | QUACK_BLOCK_RAW | QUACK_BLOCK_FREE)
+/* Sizes are multiples of QUACK_ALLOC_ALIGN, so no block header has QUACK_EMBEDDED_HEADER set */
+#define QUACK_HEADER_SIZE sizeof(size_t)
+
+#define QUACK_HEADER(payload) ((size_t *) (payload) - 1)
+#define QUACK_BLOCK_SIZE(header) (*(header) & ~QUACK_BLOCK_FLAGS)
+
+/* A free block threads the free list through its own storage */
+typedef struct quack_free_block {
+  size_t header;
+  struct quack_free_block *next;
+} quack_free_block;
+
+/* A chunk is either shared by many bump allocated blocks or holds one oversized block */
+typedef struct quack_chunk {
+  char *start;
+  char *end;      /* End of the allocated blocks */
+  size_t size;
+  bool is_large;
+} quack_chunk;
+
+static _Thread_local char *quack_bump_start = NULL;
+static _Thread_local char *quack_bump_ptr = NULL;
+static _Thread_local char *quack_bump_end = NULL;
+static _Thread_local quack_free_block *quack_free_lists[QUACK_ALLOC_NUM_SIZE_CLASSES];
+/* Free blocks too big for any size class.  Allocation from it is first fit. */
+static _Thread_local quack_free_block *quack_large_free_list = NULL;
+
+/* All chunks sorted by start address */
+static _Thread_local quack_chunk *quack_chunks = NULL;
+static _Thread_local size_t quack_num_chunks = 0;
+static _Thread_local size_t quack_chunks_capacity = 0;
+
+static _Thread_local size_t quack_bytes_since_gc = 0;
+
+static void quack_out_of_memory(void) {
+  fprintf(stderr, "Out of memory\n");
+  exit(EXIT_FAILURE);
+}
+
+/* Finds the chunk containing an address.  Returns NULL if not in the heap. */
+static quack_chunk * quack_find_chunk(const void *addr) {
+  const char *p = (const char *) addr;
+  size_t lo = 0, hi = quack_num_chunks;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (p < quack_chunks[mid].start)
+      hi = mid;
+    else if (p >= quack_chunks[mid].start + quack_chunks[mid].size)
+      lo = mid + 1;
+    else
+      return &quack_chunks[mid];
+  }
+  return NULL;
+}
+
+static char * quack_new_chunk(size_t size, bool is_large) {
+  char *start = (char *) malloc(size);
+  if (start == NULL)
+    quack_out_of_memory();
+
+  if (quack_num_chunks == quack_chunks_capacity) {
+    quack_chunks_capacity = (quack_chunks_capacity == 0) ? 16 : 2 * quack_chunks_capacity;
+    quack_chunks = (quack_chunk *) realloc(quack_chunks,
+                                           quack_chunks_capacity * sizeof(quack_chunk));
+    if (quack_chunks == NULL)
+      quack_out_of_memory();
+  }
+  size_t i = quack_num_chunks++;
+  for (; i > 0 && quack_chunks[i - 1].start > start; i--)
+    quack_chunks[i] = quack_chunks[i - 1];
+  quack_chunks[i].start = start;
+  quack_chunks[i].end = is_large ? start + size : start;
+  quack_chunks[i].size = size;
+  quack_chunks[i].is_large = is_large;
+  return start;
+}
+
+/* Records how much of the bump chunk is in use so that its blocks can be walked */
+static void quack_sync_bump_chunk(void) {
+  if (quack_bump_start != NULL)
+    quack_find_chunk(quack_bump_start)->end = quack_bump_ptr;
+}
+
+/* Slow path: Start a new chunk or allocate an oversized block in its own chunk */
+static char * quack_alloc_slow(size_t size) {
+  if (size > QUACK_ALLOC_CHUNK_SIZE / 4)
+    return quack_new_chunk(size, true);
+
+  /* The tail of the old chunk is abandoned */
+  quack_sync_bump_chunk();
+  char *chunk = quack_new_chunk(QUACK_ALLOC_CHUNK_SIZE, false);
+  quack_bump_start = chunk;
+  quack_bump_ptr = chunk + size;
+  quack_bump_end = chunk + QUACK_ALLOC_CHUNK_SIZE;
+  return chunk;
+}
+
+static void * quack_alloc_block(size_t size, size_t flags) {
+  size = (size + QUACK_HEADER_SIZE + QUACK_ALLOC_ALIGN - 1) & ~((size_t) QUACK_ALLOC_ALIGN - 1);
+
+  #ifdef QUACK_GC
+    if (quack_bytes_since_gc >= quack_gc_threshold)
+      quack_gc_collect();
+  #endif
+
+  char *block = NULL;
+  if (size <= QUACK_ALLOC_MAX_SMALL) {
+    quack_free_block **free_list = &quack_free_lists[size / QUACK_ALLOC_ALIGN - 1];
+    if (*free_list != NULL) {
+      block = (char *) *free_list;
+      *free_list = (*free_list)->next;
+    }
+  } else {
+    for (quack_free_block **prev = &quack_large_free_list; *prev != NULL;
+         prev = &(*prev)->next) {
+      if (QUACK_BLOCK_SIZE(&(*prev)->header) >= size) {
+        block = (char *) *prev;
+        size = QUACK_BLOCK_SIZE(&(*prev)->header);
+        *prev = (*prev)->next;
+        break;
+      }
+    }
+  }
+
+  if (block == NULL) {
+    if ((size_t) (quack_bump_end - quack_bump_ptr) >= size) {
+      block = quack_bump_ptr;
+      quack_bump_ptr += size;
+    } else {
+      block = quack_alloc_slow(size);
+    }
+  }
+
+  quack_bytes_since_gc += size;
+  *(size_t *) block = size | flags;
+  void *payload = block + QUACK_HEADER_SIZE;
+  #ifdef QUACK_GC
+    /* The collector may trace an object before all of its fields are assigned */
+    memset(payload, 0, size - QUACK_HEADER_SIZE);
+  #endif
+  return payload;
+}
+
+QUACK_API void * quack_alloc(size_t size) {
+  return quack_alloc_block(size, 0);
+}
+
+QUACK_API void * quack_alloc_raw(size_t size) {
+  return quack_alloc_block(size, QUACK_BLOCK_RAW);
+}
+
+/* Replacement for asprintf that allocates with quack_alloc_raw */
+static char * quack_sprintf(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+
+  char *buf = (char *) quack_alloc_raw((size_t) len + 1);
+  va_start(args, fmt);
+  vsnprintf(buf, (size_t) len + 1, fmt, args);
+  va_end(args);
+  return buf;
+}
+
+/* ==============
+ * Output
+ *
+ * Quack output is collected in one large buffer.  It is
+ * written to stdout when full and at exit.  If stdout is a
+ * terminal, it is also written at the end of each line.
+ * ==============
+ */
+#define QUACK_OUT_BUF_SIZE (64 * 1024)
+/* Enough for the sign and digits of any int */
+#define QUACK_ITOA_BUF_SIZE 12
+
+static char quack_out_buf[QUACK_OUT_BUF_SIZE];
+static size_t quack_out_len = 0;
+static bool quack_out_started = false;
+static bool quack_out_is_tty = false;
+
+static void quack_out_flush(void) {
+  fwrite(quack_out_buf, 1, quack_out_len, stdout);
+  fflush(stdout);
+  quack_out_len = 0;
+}
+
+static void quack_out_write(const char *text, size_t len) {
+  if (!quack_out_started) {
+    atexit(quack_out_flush);
+    quack_out_is_tty = isatty(STDOUT_FILENO);
+    quack_out_started = true;
+  }
+
+  if (quack_out_len + len > QUACK_OUT_BUF_SIZE) {
+    quack_out_flush();
+    if (len > QUACK_OUT_BUF_SIZE) {
+      fwrite(text, 1, len, stdout);
+      return;
+    }
+  }
+  memcpy(quack_out_buf + quack_out_len, text, len);
+  quack_out_len += len;
+
+  if (quack_out_is_tty && memchr(text, '\n', len) != NULL)
+    quack_out_flush();
+}
+
+/*
+ * Formats an int into the characters just before end.  Returns a
+ * pointer to the first character.  Not null terminated.
+ */
+static char * quack_itoa(int value, char *end) {
+  unsigned magnitude = (value < 0) ? 0u - (unsigned) value : (unsigned) value;
+  char *digits = end;
+  do {
+    *--digits = (char) ('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0)
+    *--digits = '-';
+  return digits;
+}
+
+/* ==============
+ * Garbage Collection
+ *
+ * Precise, non-moving mark-sweep.  Roots are the frames on
+ * the shadow stack.  Objects are traced using the reference
+ * offsets stored in their clazz.  Blocks allocated with
+ * quack_alloc_raw are kept alive but never traced.
+ * ==============
+ */
+#ifdef QUACK_GC
+
+_Thread_local struct quack_gc_frame *quack_gc_top = NULL;
+_Thread_local size_t quack_gc_threshold = QUACK_GC_MIN_THRESHOLD;
+
+static _Thread_local void **quack_mark_stack = NULL;
+static _Thread_local size_t quack_mark_stack_size = 0;
+static _Thread_local size_t quack_mark_stack_capacity = 0;
+
+/*
+ * Marks a reference if it points to a heap block.  Tagged values, static
+ * objects, and objects embedded in other objects are skipped.
+ */
+static void quack_gc_mark(void *ref) {
+  if (ref == NULL || QUACK_IS_TAGGED_INT(ref) || quack_find_chunk(ref) == NULL)
+    return;
+  size_t *header = QUACK_HEADER(ref);
+  if (*header & (QUACK_BLOCK_MARKED | QUACK_EMBEDDED_HEADER))
+    return;
+  *header |= QUACK_BLOCK_MARKED;
+  if (*header & QUACK_BLOCK_RAW)
+    return;
+
+  if (quack_mark_stack_size == quack_mark_stack_capacity) {
+    quack_mark_stack_capacity = (quack_mark_stack_capacity == 0) ? 256
+                                                                 : 2 * quack_mark_stack_capacity;
+    quack_mark_stack = (void **) realloc(quack_mark_stack,
+                                         quack_mark_stack_capacity * sizeof(void *));
+    if (quack_mark_stack == NULL)
+      quack_out_of_memory();
+  }
+  quack_mark_stack[quack_mark_stack_size++] = ref;
+}
+
+static void quack_gc_trace(void) {
+  while (quack_mark_stack_size > 0) {
+    obj_Obj obj = (obj_Obj) quack_mark_stack[--quack_mark_stack_size];
+    /* An object is zeroed until its constructor stores the clazz */
+    if (obj->clazz == NULL)
+      continue;
+    for (const size_t *offset = obj->clazz->ref_offsets_; *offset != 0; offset++)
+      quack_gc_mark(*(void **) ((char *) obj + *offset));
+  }
+}
+
+/* Adds a dead block to the free list for its size */
+static void quack_gc_release(char *block, size_t size) {
+  quack_free_block *free_block = (quack_free_block *) block;
+  free_block->header = size | QUACK_BLOCK_FREE;
+  if (size <= QUACK_ALLOC_MAX_SMALL) {
+    free_block->next = quack_free_lists[size / QUACK_ALLOC_ALIGN - 1];
+    quack_free_lists[size / QUACK_ALLOC_ALIGN - 1] = free_block;
+  } else {
+    free_block->next = quack_large_free_list;
+    quack_large_free_list = free_block;
+  }
+}
+
+static void quack_free_chunk(quack_chunk *chunk) {
+  free(chunk->start);
+  size_t i = (size_t) (chunk - quack_chunks);
+  memmove(chunk, chunk + 1, (quack_num_chunks - i - 1) * sizeof(quack_chunk));
+  quack_num_chunks--;
+}
+
+/* Returns the number of bytes still live */
+static size_t quack_gc_sweep(void) {
+  size_t live_bytes = 0;
+  memset(quack_free_lists, 0, sizeof(quack_free_lists));
+  quack_large_free_list = NULL;
+
+  for (size_t i = quack_num_chunks; i-- > 0; ) {
+    quack_chunk *chunk = &quack_chunks[i];
+    bool is_bump_chunk = chunk->start == quack_bump_start;
+
+    bool has_live = false;
+    for (char *block = chunk->start; block < chunk->end && !has_live;
+         block += QUACK_BLOCK_SIZE((size_t *) block))
+      has_live = (*(size_t *) block & QUACK_BLOCK_MARKED) != 0;
+
+    /* Entirely dead chunks are returned to the system (or rewound if bump allocating) */
+    if (!has_live) {
+      if (is_bump_chunk) {
+        quack_bump_ptr = chunk->start;
+        chunk->end = chunk->start;
+      } else {
+        quack_free_chunk(chunk);
+      }
+      continue;
+    }
+
+    for (char *block = chunk->start; block < chunk->end; ) {
+      size_t *header = (size_t *) block;
+      size_t size = QUACK_BLOCK_SIZE(header);
+      if (*header & QUACK_BLOCK_MARKED) {
+        *header &= ~QUACK_BLOCK_MARKED;
+        live_bytes += size;
+      } else if (!chunk->is_large) {
+        quack_gc_release(block, size);
+      }
+      block += size;
+    }
+  }
+  return live_bytes;
+}
+
+QUACK_API void quack_gc_collect(void) {
+  quack_sync_bump_chunk();
+
+  for (struct quack_gc_frame *frame = quack_gc_top; frame != NULL; frame = frame->prev)
+    for (size_t i = 0; i < frame->num_roots; i++)
+      quack_gc_mark(*frame->roots[i]);
+  quack_gc_trace();
+
+  size_t live_bytes = quack_gc_sweep();
+
+  /* Let the heap grow in proportion to the live data */
+  quack_gc_threshold = (live_bytes > QUACK_GC_MIN_THRESHOLD) ? live_bytes
+                                                             : QUACK_GC_MIN_THRESHOLD;
+  quack_bytes_since_gc = 0;
+}
+
+#endif
+
+
+/* Reference field offsets for classes whose objects hold no references */
+static const size_t quack_no_ref_offsets[] = { 0 };
+
+
+static void quack_string_write(obj_String str);
+
 /* ==============
  * Obj
  * Fields: None
@@ -26,29 +405,42 @@
 class_Obj the_class_Obj;
 
 /* Constructor */
-obj_Obj new_Obj() {
-  obj_Obj new_thing = (obj_Obj) malloc(sizeof(struct obj_Obj_struct));
+QUACK_API obj_Obj new_Obj() {
+  obj_Obj new_thing = (obj_Obj) quack_alloc(sizeof(struct obj_Obj_struct));
   new_thing->clazz = the_class_Obj;
   return new_thing;
 }
 
 /* Obj:STR */
-obj_String Obj_method_STR(obj_Obj this) {
-  char * rep;
-  asprintf(&rep, "<Object at %08x>", (unsigned)this);
+QUACK_API obj_String Obj_method_STR(obj_Obj this) {
+  char * rep = quack_sprintf("<Object at %08x>", (unsigned)this);
   obj_String str = str_literal(rep);
   return str;
 }
 
 /* Obj:PRINT */
-obj_Obj Obj_method_PRINT(obj_Obj this) {
-  obj_String str = this->clazz->STR(this);
-  fprintf(stdout, "%s", str->text);
+QUACK_API obj_Obj Obj_method_PRINT(obj_Obj this) {
+  class_Obj clazz = QUACK_CLAZZ(this);
+
+  /* Builtin values are written directly without building a String */
+  if (clazz == (class_Obj) the_class_Int) {
+    char buf[QUACK_ITOA_BUF_SIZE];
+    char *digits = quack_itoa(QUACK_INT_VALUE(this), buf + QUACK_ITOA_BUF_SIZE);
+    quack_out_write(digits, (size_t) (buf + QUACK_ITOA_BUF_SIZE - digits));
+  } else if (clazz == (class_Obj) the_class_String) {
+    quack_string_write((obj_String) this);
+  } else if (this == (obj_Obj) lit_true) {
+    quack_out_write("true", 4);
+  } else if (this == (obj_Obj) lit_false) {
+    quack_out_write("false", 5);
+  } else {
+    quack_string_write(clazz->STR(this));
+  }
   return this;
 }
 
 /* Obj:EQUALS (Note we may want to replace this */
-obj_Boolean Obj_method_EQUALS(obj_Obj this, obj_Obj other) {
+QUACK_API obj_Boolean Obj_method_EQUALS(obj_Obj this, obj_Obj other) {
   if (this == other) {
     return lit_true;
   } else {
@@ -60,6 +452,8 @@ obj_Boolean Obj_method_EQUALS(obj_Obj this, obj_Obj other) {
 /* The Obj Class (a singleton) */
 struct class_Obj_struct  the_class_Obj_struct = {
   NULL,
+  quack_no_ref_offsets,
+  0, 4,  /* Class interval; set by the generated main */
   new_Obj,     /* Constructor */
   Obj_method_EQUALS,
   Obj_method_PRINT,
@@ -72,23 +466,99 @@ class_Obj the_class_Obj = &the_class_Obj_struct;
 /* ================
  * String
  * Fields:
- *    One hidden field, currently holding char*
- *    (change later to a rope for garbage collection)
+ *    Hidden fields holding a rope.  A leaf holds its text.
+ *    A concatenation holds its left and right operands until
+ *    the text is needed, at which point it is flattened into
+ *    a leaf.
  * Methods:
  *    Those of Obj, plus ordering, concatenation
  *    (Incomplete for now.)
  * ==================
  */
 
+/* Results shorter than this are copied immediately rather than building a rope node */
+#define QUACK_ROPE_MIN_CONCAT 32
+
+static const size_t quack_string_ref_offsets[] = {
+  offsetof(struct obj_String_struct, text),
+  offsetof(struct obj_String_struct, left),
+  offsetof(struct obj_String_struct, right),
+  0
+};
+
 /* Constructor */
-obj_String new_String(  ) {
-  obj_String new_thing = (obj_String) malloc(sizeof(struct obj_String_struct));
+QUACK_API obj_String new_String(  ) {
+  obj_String new_thing = (obj_String) quack_alloc(sizeof(struct obj_String_struct));
   new_thing->clazz = the_class_String;
   return new_thing;
 }
 
+/* Stack of rope nodes used to walk a rope without recursion */
+typedef struct quack_rope_stack {
+  obj_String *nodes;
+  size_t size;
+  size_t capacity;
+} quack_rope_stack;
+
+static void quack_rope_push(quack_rope_stack *stack, obj_String node) {
+  if (stack->size == stack->capacity) {
+    stack->capacity = (stack->capacity == 0) ? 32 : 2 * stack->capacity;
+    stack->nodes = (obj_String *) realloc(stack->nodes, stack->capacity * sizeof(obj_String));
+    if (stack->nodes == NULL)
+      quack_out_of_memory();
+  }
+  stack->nodes[stack->size++] = node;
+}
+
+/*
+ * Visits the leaves of a rope from left to right.  Concatenations are pushed
+ * right operand first so the left operand is visited first.
+ */
+#define QUACK_ROPE_FOR_EACH_LEAF(root, leaf, body) \
+  do { \
+    quack_rope_stack stack_ = { NULL, 0, 0 }; \
+    quack_rope_push(&stack_, (root)); \
+    while (stack_.size > 0) { \
+      obj_String leaf = stack_.nodes[--stack_.size]; \
+      if (leaf->text == NULL) { \
+        quack_rope_push(&stack_, leaf->right); \
+        quack_rope_push(&stack_, leaf->left); \
+        continue; \
+      } \
+      body \
+    } \
+    free(stack_.nodes); \
+  } while (0)
+
+/* Gets the text of a String, flattening it into a leaf first if needed */
+QUACK_API char * quack_string_text(obj_String str) {
+  if (str->text != NULL)
+    return str->text;
+
+  char *text = (char *) quack_alloc_raw(str->length + 1);
+  char *dest = text;
+  QUACK_ROPE_FOR_EACH_LEAF(str, leaf, {
+    memcpy(dest, leaf->text, leaf->length);
+    dest += leaf->length;
+  });
+  *dest = '\0';
+
+  /* Dropping the operands lets the collector reclaim them */
+  str->text = text;
+  str->left = NULL;
+  str->right = NULL;
+  return text;
+}
+
+/* Writes a String to the output buffer without flattening it */
+static void quack_string_write(obj_String str) {
+  QUACK_ROPE_FOR_EACH_LEAF(str, leaf, {
+    quack_out_write(leaf->text, leaf->length);
+  });
+}
+
 /* String:STR */
-obj_String String_method_STR(obj_String this) {
+QUACK_API obj_String String_method_STR(obj_String this) {
   return this;
 }
 
@@ -99,39 +569,57 @@ obj_String String_method_STR(obj_String this) {
 //}
 
 /* String:EQUALS (Note we may want to replace this */
-obj_Boolean String_method_EQUALS(obj_String this, obj_Obj other) {
+QUACK_API obj_Boolean String_method_EQUALS(obj_String this, obj_Obj other) {
   obj_String other_str = (obj_String) other;
   /* But is it really? */
-  if (other_str->clazz == the_class_String && strcmp(this->text, other_str->text) == 0)
+  if (QUACK_CLAZZ(other_str) != the_class_String || this->length != other_str->length)
+    return lit_false;
+  if (strcmp(quack_string_text(this), quack_string_text(other_str)) == 0)
     return lit_true;
   return lit_false;
 }
 
-obj_String String_method_PLUS(obj_String this, obj_String other) {
-  char* combo;
-  asprintf(&combo, "%s%s", this->text, other->text);
-  return str_literal(combo);
+QUACK_API obj_String String_method_PLUS(obj_String this, obj_String other) {
+  size_t length = this->length + other->length;
+  if (length < QUACK_ROPE_MIN_CONCAT) {
+    /* Flatten first.  The texts stay reachable through the operands. */
+    char *left = quack_string_text(this);
+    char *right = quack_string_text(other);
+    char *combo = (char *) quack_alloc_raw(length + 1);
+    memcpy(combo, left, this->length);
+    memcpy(combo + this->length, right, other->length + 1);
+    return str_literal(combo);
+  }
+
+  obj_String concat = the_class_String->constructor();
+  concat->text = NULL;
+  concat->length = length;
+  concat->left = this;
+  concat->right = other;
+  return concat;
 }
 
-obj_Boolean String_method_LESS(obj_String this, obj_String other) {
-  return (strcmp(this->text, other->text) < 0) ? lit_true : lit_false;
+QUACK_API obj_Boolean String_method_LESS(obj_String this, obj_String other) {
+  return (strcmp(quack_string_text(this), quack_string_text(other)) < 0) ? lit_true : lit_false;
 }
 
-obj_Boolean String_method_MORE(obj_String this, obj_String other) {
-  return (strcmp(this->text, other->text) > 0) ? lit_true : lit_false;
+QUACK_API obj_Boolean String_method_MORE(obj_String this, obj_String other) {
+  return (strcmp(quack_string_text(this), quack_string_text(other)) > 0) ? lit_true : lit_false;
 }
 
-obj_Boolean String_method_ATLEAST(obj_String this, obj_String other) {
-  return (strcmp(this->text, other->text) <= 0) ? lit_true : lit_false;
+QUACK_API obj_Boolean String_method_ATLEAST(obj_String this, obj_String other) {
+  return (strcmp(quack_string_text(this), quack_string_text(other)) <= 0) ? lit_true : lit_false;
 }
 
-obj_Boolean String_method_ATMOST(obj_String this, obj_String other) {
-  return (strcmp(this->text, other->text) >= 0) ? lit_true : lit_false;
+QUACK_API obj_Boolean String_method_ATMOST(obj_String this, obj_String other) {
+  return (strcmp(quack_string_text(this), quack_string_text(other)) >= 0) ? lit_true : lit_false;
 }
 
 /* The String Class (a singleton) */
 struct  class_String_struct  the_class_String_struct = {
   &the_class_Obj_struct,
+  quack_string_ref_offsets,
+  4, 4,  /* Class interval; set by the generated main */
   new_String,     /* Constructor */
   String_method_EQUALS,
   Obj_method_PRINT,
@@ -149,10 +637,15 @@ class_String the_class_String = &the_class_String_struct;
  * Internal use function for creating String objects
  * from char*.  Use this to create string literals.
  */
-obj_String str_literal(char *s) {
-  char *rep;
+QUACK_API obj_String str_literal(char *s) {
+  /* The text may itself be on the heap */
+  QUACK_GC_FRAME(1);
+  QUACK_GC_ROOT(0, s);
   obj_String str = the_class_String->constructor();
   str->text = s;
+  str->length = strlen(s);
+  str->left = NULL;
+  str->right = NULL;
   return str;
 }
 
@@ -165,15 +658,14 @@ obj_String str_literal(char *s) {
  * =================
  */
 /* Constructor */
-obj_Boolean new_Boolean(  ) {
-  obj_Boolean new_thing = (obj_Boolean)
-    malloc(sizeof(struct obj_Boolean_struct));
+QUACK_API obj_Boolean new_Boolean(  ) {
+  obj_Boolean new_thing = (obj_Boolean) quack_alloc(sizeof(struct obj_Boolean_struct));
   new_thing->clazz = the_class_Boolean;
   return new_thing;
 }
 
 /* Boolean:STR */
-obj_String Boolean_method_STR(obj_Boolean this) {
+QUACK_API obj_String Boolean_method_STR(obj_Boolean this) {
   if (this == lit_true) {
     return str_literal("true");
   } else if (this == lit_false) {
@@ -194,6 +686,8 @@ obj_String Boolean_method_STR(obj_Boolean this) {
 /* The Boolean Class (a singleton) */
 struct  class_Boolean_struct  the_class_Boolean_struct = {
   &the_class_Obj_struct,
+  quack_no_ref_offsets,
+  1, 1,  /* Class interval; set by the generated main */
   new_Boolean,     /* Constructor */
   Obj_method_EQUALS,
   Obj_method_PRINT,
@@ -224,12 +718,12 @@ obj_Boolean lit_true = &lit_true_struct;
  * ==============
  */
 /*  Constructor */
-obj_Nothing new_Nothing(  ) {
+QUACK_API obj_Nothing new_Nothing(  ) {
   return none;
 }
 
 /* Boolean:STR */
-obj_String Nothing_method_STR(obj_Nothing this) {
+QUACK_API obj_String Nothing_method_STR(obj_Nothing this) {
     return str_literal("<nothing>");
 }
 
@@ -242,6 +736,8 @@ obj_String Nothing_method_STR(obj_Nothing this) {
 /* The Nothing Class (a singleton) */
 struct  class_Nothing_struct  the_class_Nothing_struct = {
   &the_class_Obj_struct,
+  quack_no_ref_offsets,
+  3, 3,  /* Class interval; set by the generated main */
   new_Nothing,     /* Constructor */
   Obj_method_EQUALS,
   Obj_method_PRINT,
@@ -270,25 +766,34 @@ obj_Nothing none = &nothing_struct;
  */
 
 /* Constructor */
-obj_Int new_Int(  ) {
-  obj_Int new_thing = (obj_Int)malloc(sizeof(struct obj_Int_struct));
+QUACK_API obj_Int new_Int(  ) {
+#ifdef QUACK_TAGGED_INT
+  return QUACK_TAG_INT(0);
+#else
+  obj_Int new_thing = (obj_Int) quack_alloc(sizeof(struct obj_Int_struct));
   new_thing->clazz = the_class_Int;
   new_thing->value = 0;
   return new_thing;
+#endif
 }
 
 /* Int:STR */
-obj_String Int_method_STR(obj_Int this) {
-  char *rep;
-  asprintf(&rep, "%d", this->value);
+QUACK_API obj_String Int_method_STR(obj_Int this) {
+  char buf[QUACK_ITOA_BUF_SIZE];
+  char *digits = quack_itoa(QUACK_INT_VALUE(this), buf + QUACK_ITOA_BUF_SIZE);
+  size_t len = (size_t) (buf + QUACK_ITOA_BUF_SIZE - digits);
+
+  char *rep = (char *) quack_alloc_raw(len + 1);
+  memcpy(rep, digits, len);
+  rep[len] = '\0';
   return str_literal(rep);
 }
 
 /* Int:EQUALS */
-obj_Boolean Int_method_EQUALS(obj_Int this, obj_Obj other) {
-  obj_Int other_int = (obj_Int) other;
+QUACK_API obj_Boolean Int_method_EQUALS(obj_Int this, obj_Obj other) {
   /* But is it? */
-  if (other_int->clazz != this->clazz || this->value != other_int->value) {
+  if (QUACK_CLAZZ(other) != (class_Obj) the_class_Int
+      || QUACK_INT_VALUE(this) != QUACK_INT_VALUE(other)) {
     return lit_false;
   }
   return lit_true;
@@ -298,45 +803,47 @@ obj_Boolean Int_method_EQUALS(obj_Int this, obj_Obj other) {
 // FixMe Inherit Obj::Print
 
 /* LESS (new method) */
-obj_Boolean Int_method_LESS(obj_Int this, obj_Int other) {
-  return this->value < other->value ? lit_true: lit_false;
+QUACK_API obj_Boolean Int_method_LESS(obj_Int this, obj_Int other) {
+  return QUACK_INT_VALUE(this) < QUACK_INT_VALUE(other) ? lit_true: lit_false;
 }
 /* MORE (new method) */
-obj_Boolean Int_method_MORE(obj_Int this, obj_Int other) {
-  return this->value > other->value ? lit_true: lit_false;
+QUACK_API obj_Boolean Int_method_MORE(obj_Int this, obj_Int other) {
+  return QUACK_INT_VALUE(this) > QUACK_INT_VALUE(other) ? lit_true: lit_false;
 }
 /* ATLEAST (new method) */
-obj_Boolean Int_method_ATMOST(obj_Int this, obj_Int other) {
-  return this->value <= other->value ? lit_true: lit_false;
+QUACK_API obj_Boolean Int_method_ATMOST(obj_Int this, obj_Int other) {
+  return QUACK_INT_VALUE(this) <= QUACK_INT_VALUE(other) ? lit_true: lit_false;
 }
 /* ATMOST (new method) */
-obj_Boolean Int_method_ATLEAST(obj_Int this, obj_Int other) {
-  return this->value >= other->value ? lit_true: lit_false;
+QUACK_API obj_Boolean Int_method_ATLEAST(obj_Int this, obj_Int other) {
+  return QUACK_INT_VALUE(this) >= QUACK_INT_VALUE(other) ? lit_true: lit_false;
 }
 
 /* PLUS (new method) */
-obj_Int Int_method_PLUS(obj_Int this, obj_Int other) {
-  return int_literal(this->value + other->value);
+QUACK_API obj_Int Int_method_PLUS(obj_Int this, obj_Int other) {
+  return int_literal(QUACK_INT_VALUE(this) + QUACK_INT_VALUE(other));
 }
 
 /* SUBTRACT (new method) */
-obj_Int Int_method_MINUS(obj_Int this, obj_Int other) {
-  return int_literal(this->value - other->value);
+QUACK_API obj_Int Int_method_MINUS(obj_Int this, obj_Int other) {
+  return int_literal(QUACK_INT_VALUE(this) - QUACK_INT_VALUE(other));
 }
 
 /* PLUS (new method) */
-obj_Int Int_method_TIMES(obj_Int this, obj_Int other) {
-  return int_literal(this->value * other->value);
+QUACK_API obj_Int Int_method_TIMES(obj_Int this, obj_Int other) {
+  return int_literal(QUACK_INT_VALUE(this) * QUACK_INT_VALUE(other));
 }
 
 /* SUBTRACT (new method) */
-obj_Int Int_method_DIVIDE(obj_Int this, obj_Int other) {
-  return int_literal(this->value / other->value);
+QUACK_API obj_Int Int_method_DIVIDE(obj_Int this, obj_Int other) {
+  return int_literal(quack_int_divide(QUACK_INT_VALUE(this), QUACK_INT_VALUE(other)));
 }
 
 /* The Int Class (a singleton) */
 struct class_Int_struct  the_class_Int_struct = {
   &the_class_Obj_struct,
+  quack_no_ref_offsets,
+  2, 2,  /* Class interval; set by the generated main */
   new_Int,     /* Constructor */
   Int_method_EQUALS,
   Obj_method_PRINT,
@@ -357,20 +864,27 @@ class_Int the_class_Int = &the_class_Int_struct;
  * used by compiler and not otherwise available in
  * Quack programs.
  */
-obj_Int int_literal(int n) {
+QUACK_API obj_Int int_literal(int n) {
+#ifdef QUACK_TAGGED_INT
+  return QUACK_TAG_INT(n);
+#else
   obj_Int boxed = new_Int();
   boxed->value = n;
   return boxed;
+#endif
+}
+
+QUACK_API int quack_int_divide(int left, int right) {
+  /* The check keeps the trap when the compiler sees a constant divisor */
+  if (right == 0 || (right == -1 && left == INT_MIN))
+    raise(SIGFPE);
+  return left / right;
 }
 
-bool is_subtype(class_Obj obj, class_Obj other) {
-  if (obj == other)
-    return true;
-  if (obj->super_ == NULL)
-    return false;
-  return is_subtype(obj->super_, other);
+QUACK_API bool is_subtype(class_Obj obj, class_Obj other) {
+  return QUACK_CLASS_IN_RANGE(obj, other->class_id_, other->subtree_end_);
 }
 
-bool is_bool_true(obj_Boolean cond_val) {
+QUACK_API bool is_bool_true(obj_Boolean cond_val) {
   return cond_val == lit_true;
 }
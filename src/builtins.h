@@ -9,6 +9,20 @@
 #define Builtins_h
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defining QUACK_AMALGAMATION and including builtins.c in the
+ * generated code, rather than linking it separately, compiles
+ * the whole program as one translation unit.  The runtime
+ * functions are then static inline so the C compiler can
+ * inline them into user methods.
+ */
+#ifdef QUACK_AMALGAMATION
+#define QUACK_API static inline
+#else
+#define QUACK_API
+#endif
 
 /* Naming conventions:
  * class_X means a reference to the class structure for class X,
@@ -33,6 +47,81 @@
  * in Quack but an explicit argument in the runtime.
  */
 
+/* ================
+ * Allocation
+ *
+ * All runtime and generated objects are allocated with
+ * quack_alloc.  Memory comes from per-thread chunks using
+ * a bump pointer.  Small requests are rounded up to one of
+ * a set of size classes, each with its own free list that
+ * is checked first.  Blocks that hold no references (e.g.,
+ * character buffers) are allocated with quack_alloc_raw.
+ * ================
+ */
+#define QUACK_ALLOC_ALIGN 16
+#define QUACK_ALLOC_NUM_SIZE_CLASSES 16
+#define QUACK_ALLOC_MAX_SMALL (QUACK_ALLOC_ALIGN * QUACK_ALLOC_NUM_SIZE_CLASSES)
+#define QUACK_ALLOC_CHUNK_SIZE (1 << 20)
+
+QUACK_API void * quack_alloc(size_t size);
+QUACK_API void * quack_alloc_raw(size_t size);
+
+/* ================
+ * Garbage Collection
+ *
+ * Enabled by compiling both the runtime and the generated
+ * code with QUACK_GC defined.  Otherwise, memory is never
+ * freed and the frame macros below expand to nothing.
+ *
+ * Each generated function pushes a frame onto a shadow
+ * stack.  The frame holds the addresses of every local and
+ * temporary that holds an object reference.  The frame is
+ * popped automatically when the function returns.
+ *
+ * Each clazz records the offsets of the reference fields
+ * in its objects as a zero terminated array.
+ * ================
+ */
+#ifdef QUACK_GC
+
+#ifndef QUACK_GC_MIN_THRESHOLD
+#define QUACK_GC_MIN_THRESHOLD ((size_t) 4 << 20)
+#endif
+
+struct quack_gc_frame {
+  struct quack_gc_frame *prev;
+  size_t num_roots;
+  void ***roots;
+};
+
+extern _Thread_local struct quack_gc_frame *quack_gc_top;
+extern _Thread_local size_t quack_gc_threshold;
+
+QUACK_API void quack_gc_collect(void);
+
+static inline void quack_gc_pop_frame(struct quack_gc_frame *frame) {
+  quack_gc_top = frame->prev;
+}
+
+#define QUACK_GC_FRAME(n) \
+  void **quack_gc_roots_[n]; \
+  struct quack_gc_frame quack_gc_frame_ __attribute__((cleanup(quack_gc_pop_frame))) \
+    = { quack_gc_top, (n), quack_gc_roots_ }; \
+  quack_gc_top = &quack_gc_frame_
+#define QUACK_GC_ROOT(i, var) (quack_gc_roots_[i] = (void **) &(var))
+
+#else
+#define QUACK_GC_FRAME(n) ((void) 0)
+#define QUACK_GC_ROOT(i, var) ((void) 0)
+#endif
+
+/* An object embedded in the struct of another object is
+ * preceded by this in place of a block header.  It is never
+ * marked itself; its fields are traced as part of the
+ * enclosing object.
+ */
+#define QUACK_EMBEDDED_HEADER ((size_t) 8)
+
 /* The following object types are "known" from Obj, in the
  * sense that there are Obj methods that return these types.
  */
@@ -63,6 +152,9 @@ typedef struct obj_Obj_struct {
 
 struct class_Obj_struct {
   class_Obj super_;
+  const size_t *ref_offsets_;
+  unsigned class_id_;
+  unsigned subtree_end_;
 
   /* Method table */
   obj_Obj (*constructor) ( void );
@@ -77,8 +169,7 @@ extern struct class_Obj_struct the_class_Obj_struct;
 /* ================
  * String
  * Fields:
- *    One hidden field, currently holding char*
- *    (change later to a rope for garbage collection)
+ *    Hidden fields holding a rope (see below)
  * Methods:
  *    Those of Obj, plus ordering, concatenation
  *    (Incomplete for now.)
@@ -88,13 +179,24 @@ extern struct class_Obj_struct the_class_Obj_struct;
 struct class_String_struct;
 typedef struct class_String_struct* class_String;
 
+/* A String is either a leaf, whose text is set, or a concatenation,
+ * whose text is NULL until flattened and whose left and right
+ * operands are set.  Concatenation is therefore constant time.
+ * Use quack_string_text to get the characters of any String.
+ */
 typedef struct obj_String_struct {
   class_String clazz;
-  char *text;     /* FIXME: Make this a garbage-collectable rope */
+  char *text;
+  size_t length;
+  struct obj_String_struct *left;
+  struct obj_String_struct *right;
 } * obj_String;
 
 struct class_String_struct {
   class_Obj super_;
+  const size_t *ref_offsets_;
+  unsigned class_id_;
+  unsigned subtree_end_;
 
   /* Method table: Inherited or overridden */
   obj_String (*constructor) ( void );
@@ -120,7 +222,10 @@ extern struct class_String_struct the_class_String_struct;
  * is used by the compiler to create a literal string
  * from a Quack literal string.
  */
-extern obj_String str_literal(char *s);
+QUACK_API obj_String str_literal(char *s);
+
+/* Gets the null terminated text of a String, flattening it if needed */
+QUACK_API char * quack_string_text(obj_String str);
 
 /* ================
  * Boolean
@@ -141,6 +246,9 @@ typedef struct obj_Boolean_struct {
 
 struct class_Boolean_struct {
   class_Obj super_;
+  const size_t *ref_offsets_;
+  unsigned class_id_;
+  unsigned subtree_end_;
 
   /* Method table: Inherited or overridden */
   obj_Boolean (*constructor) ( void );
@@ -188,6 +296,9 @@ typedef struct obj_Nothing_struct {
  */
 struct class_Nothing_struct {
   class_Obj super_;
+  const size_t *ref_offsets_;
+  unsigned class_id_;
+  unsigned subtree_end_;
 
   /* Method table */
   obj_Nothing (*constructor) ( void );
@@ -233,6 +344,9 @@ typedef struct obj_Int_struct {
 
 struct class_Int_struct {
   class_Obj super_;
+  const size_t *ref_offsets_;
+  unsigned class_id_;
+  unsigned subtree_end_;
 
   /* Method table: Inherited or overridden */
   obj_Int (*constructor) ( void );
@@ -258,7 +372,51 @@ extern struct class_Int_struct the_class_Int_struct;
  * used by compiler and not otherwise available in
  * Quack programs.
  */
-extern obj_Int int_literal(int n);
+QUACK_API obj_Int int_literal(int n);
+
+/* Native Int division, used by compiled code when the
+ * divisor may be zero.  Dividing by zero (or INT_MIN by
+ * -1) raises SIGFPE however the C compiler optimizes
+ * the caller.
+ */
+QUACK_API int quack_int_divide(int left, int right);
+
+/* ================
+ * Tagged Int
+ *
+ * On 64-bit targets, Int objects are not allocated. The value
+ * is instead shifted into the pointer itself with the low bit
+ * set as a tag. Objects are at least word aligned so the tag
+ * bit can never be set on a real object reference.
+ *
+ * Any code that may see an Int must use QUACK_CLAZZ rather than
+ * reading obj->clazz and QUACK_INT_VALUE rather than reading
+ * ((obj_Int) obj)->value.  Define QUACK_NO_TAGGED_INT to fall
+ * back to boxed Int objects.
+ *
+ * QUACK_INT_LIT(lit, n) gives the Int for literal n, where lit
+ * is the statically allocated object used when Int is boxed.
+ * =================
+ */
+#if !defined(QUACK_NO_TAGGED_INT) && UINTPTR_MAX > 0xFFFFFFFFu
+#define QUACK_TAGGED_INT
+#endif
+
+#ifdef QUACK_TAGGED_INT
+#define QUACK_IS_TAGGED_INT(obj) ((((uintptr_t) (obj)) & 1) != 0)
+#define QUACK_TAG_INT(n) ((obj_Int) ((((uintptr_t) (intptr_t) (n)) << 1) | 1))
+#define QUACK_INT_VALUE(obj) \
+  (QUACK_IS_TAGGED_INT(obj) ? (int) (((intptr_t) (obj)) >> 1) : ((obj_Int) (obj))->value)
+#define QUACK_CLAZZ(obj) \
+  ((__typeof__((obj)->clazz)) \
+     (QUACK_IS_TAGGED_INT(obj) ? (void *) the_class_Int : (void *) (obj)->clazz))
+#define QUACK_INT_LIT(lit, n) QUACK_TAG_INT(n)
+#else
+#define QUACK_INT_LIT(lit, n) ((obj_Int) &(lit))
+#define QUACK_IS_TAGGED_INT(obj) false
+#define QUACK_INT_VALUE(obj) (((obj_Int) (obj))->value)
+#define QUACK_CLAZZ(obj) ((obj)->clazz)
+#endif
 
 
 /* ===============================
@@ -266,38 +424,44 @@ extern obj_Int int_literal(int n);
  * inherit visible to user code
  *================================
  */
-obj_Obj new_Obj();
-obj_String Obj_method_STR(obj_Obj this);
-obj_Obj Obj_method_PRINT(obj_Obj this);
-obj_Boolean Obj_method_EQUALS(obj_Obj this, obj_Obj other);
+QUACK_API obj_Obj new_Obj();
+QUACK_API obj_String Obj_method_STR(obj_Obj this);
+QUACK_API obj_Obj Obj_method_PRINT(obj_Obj this);
+QUACK_API obj_Boolean Obj_method_EQUALS(obj_Obj this, obj_Obj other);
 
-obj_String new_String();
-obj_String String_method_STR(obj_String this);
+QUACK_API obj_String new_String();
+QUACK_API obj_String String_method_STR(obj_String this);
 //obj_String String_method_PRINT(obj_String this);
-obj_Boolean String_method_EQUALS(obj_String this, obj_Obj other);
-obj_String String_method_PLUS(obj_String this, obj_String other);
-obj_Boolean String_method_LESS(obj_String this, obj_String other);
-obj_Boolean String_method_MORE(obj_String this, obj_String other);
-obj_Boolean String_method_ATLEAST(obj_String this, obj_String other);
-obj_Boolean String_method_ATMOST(obj_String this, obj_String other);
-
-obj_String Nothing_method_STR(obj_Nothing this);
-
-obj_Boolean new_Boolean();
-obj_String Boolean_method_STR(obj_Boolean this);
-
-obj_Int new_Int();
-obj_String Int_method_STR(obj_Int this);
-obj_Boolean Int_method_EQUALS(obj_Int this, obj_Obj other);
-obj_Boolean Int_method_LESS(obj_Int this, obj_Int other);
-obj_Boolean Int_method_MORE(obj_Int this, obj_Int other);
-obj_Boolean Int_method_ATLEAST(obj_Int this, obj_Int other);
-obj_Boolean Int_method_ATMOST(obj_Int this, obj_Int other);
-obj_Int Int_method_PLUS(obj_Int this, obj_Int other);
-obj_Int Int_method_MINUS(obj_Int this, obj_Int other);
-obj_Int Int_method_DIVIDE(obj_Int this, obj_Int other);
-obj_Int Int_method_TIMES(obj_Int this, obj_Int other);
-
-bool is_subtype(class_Obj obj, class_Obj other);
+QUACK_API obj_Boolean String_method_EQUALS(obj_String this, obj_Obj other);
+QUACK_API obj_String String_method_PLUS(obj_String this, obj_String other);
+QUACK_API obj_Boolean String_method_LESS(obj_String this, obj_String other);
+QUACK_API obj_Boolean String_method_MORE(obj_String this, obj_String other);
+QUACK_API obj_Boolean String_method_ATLEAST(obj_String this, obj_String other);
+QUACK_API obj_Boolean String_method_ATMOST(obj_String this, obj_String other);
+
+QUACK_API obj_String Nothing_method_STR(obj_Nothing this);
+
+QUACK_API obj_Boolean new_Boolean();
+QUACK_API obj_String Boolean_method_STR(obj_Boolean this);
+
+QUACK_API obj_Int new_Int();
+QUACK_API obj_String Int_method_STR(obj_Int this);
+QUACK_API obj_Boolean Int_method_EQUALS(obj_Int this, obj_Obj other);
+QUACK_API obj_Boolean Int_method_LESS(obj_Int this, obj_Int other);
+QUACK_API obj_Boolean Int_method_MORE(obj_Int this, obj_Int other);
+QUACK_API obj_Boolean Int_method_ATLEAST(obj_Int this, obj_Int other);
+QUACK_API obj_Boolean Int_method_ATMOST(obj_Int this, obj_Int other);
+QUACK_API obj_Int Int_method_PLUS(obj_Int this, obj_Int other);
+QUACK_API obj_Int Int_method_MINUS(obj_Int this, obj_Int other);
+QUACK_API obj_Int Int_method_DIVIDE(obj_Int this, obj_Int other);
+QUACK_API obj_Int Int_method_TIMES(obj_Int this, obj_Int other);
+
+/* Classes are numbered in preorder.  A class's subclasses are those
+ * whose class_id_ is in [class_id_, subtree_end_] of that class.
+ */
+#define QUACK_CLASS_IN_RANGE(clazz, lo, hi) \
+  ((unsigned) ((clazz)->class_id_ - (lo)) <= (unsigned) ((hi) - (lo)))
+
+QUACK_API bool is_subtype(class_Obj obj, class_Obj other);
 
 #endif
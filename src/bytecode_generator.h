@@ -0,0 +1,124 @@
+//
+// Compilation of a whole Quack program to bytecode for immediate execution.
+//
+
+#ifndef TYPE_CHECKER_BYTECODE_GENERATOR_H
+#define TYPE_CHECKER_BYTECODE_GENERATOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "quack_program.h"
+#include "quack_class.h"
+#include "ir_bytecode_emitter.h"
+#include "quack_vm.h"
+#include "keywords.h"
+
+namespace CodeGen {
+  /**
+   * Alternative to Gen that runs the program instead of writing it out.  Each method is
+   * translated from the SSA intermediate representation into bytecode, and the program is
+   * then executed by the interpreter in quack_vm.c, which is linked into the compiler along
+   * with builtins.c.  There is no C compiler in the loop so programs start immediately.
+   *
+   * Memory is never reclaimed while the program runs (i.e., as if QUACK_GC were not defined).
+   */
+  class BytecodeGen {
+   public:
+    /**
+     * Creates a bytecode generator for a program.
+     *
+     * @param prog Type checked program
+     * @param print_ir If true, the SSA form of each method is printed
+     */
+    explicit BytecodeGen(Quack::Program * prog, bool print_ir = false)
+        : prog_(prog), print_ir_(print_ir) {}
+    /**
+     * Translates the program into bytecode then runs it.
+     */
+    void run() {
+      Quack::Class::number_classes();
+
+      std::vector<Quack::Class*> classes;
+      for (auto &class_pair : *Quack::Class::Container::singleton())
+        classes.emplace_back(class_pair.second);
+      std::sort(classes.begin(), classes.end(), [](Quack::Class * a, Quack::Class * b) {
+        return a->class_id_ < b->class_id_;
+      });
+
+      // Functions are numbered before any is generated since class tables refer to them
+      std::vector<std::pair<Quack::Class*, Quack::Method*>> sources;
+      std::map<const Quack::Method*, int> function_ids;
+      for (auto * q_class : classes) {
+        if (!q_class->is_user_class())
+          continue;
+        function_ids[q_class->get_constructor()] = static_cast<int>(sources.size());
+        sources.emplace_back(q_class, q_class->get_constructor());
+        for (const auto &method_info : *q_class->methods_) {
+          function_ids[method_info.second] = static_cast<int>(sources.size());
+          sources.emplace_back(q_class, method_info.second);
+        }
+      }
+      auto main_function = static_cast<unsigned>(sources.size());
+      sources.emplace_back(nullptr, prog_->main_);
+
+      IR::BytecodeEmitter::Constants constants;
+      std::vector<IR::BytecodeEmitter::Code> codes;
+      std::vector<quack_vm_function> functions;
+      for (const auto &source : sources) {
+        bool is_constructor = source.first != nullptr
+                              && source.second == source.first->get_constructor();
+        codes.emplace_back(IR::BytecodeEmitter::generate_function(constants, print_ir_,
+                                                                  source.second, source.first,
+                                                                  is_constructor));
+      }
+      for (unsigned i = 0; i < sources.size(); i++) {
+        const auto &code = codes[i];
+        functions.push_back({sources[i].second->name_.c_str(), code.num_params_, code.num_regs_,
+                             code.max_args_, code.words_.data()});
+      }
+
+      std::vector<std::vector<quack_vm_method>> method_tables;
+      for (auto * q_class : classes) {
+        method_tables.emplace_back();
+        for (const auto &method_info : *Quack::Class::build_generated_methods(q_class)) {
+          quack_vm_method method = {method_info.second->name_.c_str(), -1, 0};
+          if (method_info.first->is_user_class())
+            method.function = function_ids.at(method_info.second);
+          else
+            method.builtin_class = method_info.first->class_id_;
+          method_tables.back().emplace_back(method);
+        }
+      }
+      std::vector<quack_vm_class> vm_classes;
+      for (unsigned i = 0; i < classes.size(); i++) {
+        Quack::Class * q_class = classes[i];
+        int constructor = -1;
+        if (q_class->is_user_class())
+          constructor = function_ids.at(q_class->get_constructor());
+        vm_classes.push_back({q_class->name_.c_str(), !q_class->is_user_class(),
+                              q_class->super_ ? static_cast<int>(q_class->super_->class_id_) : -1,
+                              q_class->subtree_end_,
+                              static_cast<unsigned>(
+                                  Quack::Class::build_generated_fields(q_class)->size()),
+                              constructor, static_cast<unsigned>(method_tables[i].size()),
+                              method_tables[i].data()});
+      }
+
+      quack_vm_program program = {static_cast<unsigned>(vm_classes.size()), vm_classes.data(),
+                                  static_cast<unsigned>(functions.size()), functions.data(),
+                                  static_cast<unsigned>(constants.table().size()),
+                                  constants.table().data(), main_function};
+      quack_vm_run(&program);
+    }
+
+   private:
+    const Quack::Program * prog_;
+    /** Print the SSA form of each method */
+    const bool print_ir_;
+  };
+}
+
+#endif //TYPE_CHECKER_BYTECODE_GENERATOR_H
@@ -5,19 +5,274 @@
 #ifndef TYPE_CHECKER_CODE_GEN_UTILS_H
 #define TYPE_CHECKER_CODE_GEN_UTILS_H
 
+#include <cstdlib>
 #include <fstream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <utility>
+#include <vector>
 #include "symbol_table.h"
+#include "keywords.h"
 
 // Forward Declaration
-namespace Quack { class Class; }
+namespace Quack { class Class; class Method; }
 
 namespace CodeGen {
+  /** How code generation uses receiver class profiles */
+  enum class ProfileMode {
+    /** No profile */
+    None,
+    /** Instrument the program so that running it writes a profile */
+    Generate,
+    /** Optimize using a profile written by an instrumented build */
+    Use
+  };
+
+  /** Type and name of an object temporary declared at the top of a function */
+  typedef std::vector<std::pair<std::string, std::string>> HoistedTemps;
+
+  /**
+   * Deduplicated Int and String literals.  Each is defined once as a statically allocated object
+   * at file scope so evaluating a literal never allocates.
+   */
+  class LiteralPool {
+   public:
+    /**
+     * Gets the name of the static object for an Int literal.  It is added to the pool if new.
+     *
+     * @param value Literal value
+     * @return Name of the static object
+     */
+    const std::string &add(int value) {
+      return add(ints_, value, LIT_POOL_INT_HEADER);
+    }
+    /**
+     * Gets the name of the static object for a String literal.  It is added to the pool if new.
+     *
+     * @param value Literal text exactly as it appears in the source (i.e., escapes intact)
+     * @return Name of the static object
+     */
+    const std::string &add(const std::string &value) {
+      return add(strs_, value, LIT_POOL_STR_HEADER);
+    }
+    /** Int literals and the names of their static objects */
+    const std::map<int, std::string> &ints() const { return ints_; }
+    /** String literals and the names of their static objects */
+    const std::map<std::string, std::string> &strs() const { return strs_; }
+
+   private:
+    template <typename _T>
+    static const std::string &add(std::map<_T, std::string> &pool, const _T &value,
+                                  const std::string &header) {
+      auto itr = pool.find(value);
+      if (itr != pool.end())
+        return itr->second;
+
+      std::stringstream ss;
+      ss << header << std::setfill('0') << std::setw(4) << pool.size();
+      return pool.emplace(value, ss.str()).first->second;
+    }
+
+    std::map<int, std::string> ints_;
+    std::map<std::string, std::string> strs_;
+  };
+
+  /**
+   * Receiver class counts for the dynamically dispatched calls and typecases of a program.
+   * Each such call or typecase is a site.  Sites are numbered in the order code is generated,
+   * so the same program always yields the same numbering.  Each site also has a label that is
+   * checked against the loaded profile; a stale profile is therefore ignored site by site
+   * rather than misapplied.
+   */
+  class Profile {
+   public:
+    /** Number of times each class was seen at a site, keyed by class name */
+    typedef std::map<std::string, unsigned long> Histogram;
+
+    /**
+     * @param instrument If true, the generated code counts the classes seen at each site.
+     *                   Otherwise the counts are loaded and used to optimize each site.
+     */
+    explicit Profile(bool instrument) : instrument_(instrument) {}
+    /** True if the generated code counts the classes seen at each site */
+    bool instrument() const { return instrument_; }
+    /**
+     * Numbers the next site.
+     *
+     * @param label Description of the site (e.g., "call:PRINT" or "typecase")
+     * @return Site number
+     */
+    unsigned add_site(const std::string &label) {
+      sites_.emplace_back(label);
+      return static_cast<unsigned>(sites_.size() - 1);
+    }
+    /**
+     * Statement that counts the class of an object at a site.
+     *
+     * @param site Site number
+     * @param clazz Expression for the clazz of the object
+     * @return Statement without indentation
+     */
+    static std::string generate_record(unsigned site, const std::string &clazz) {
+      std::stringstream ss;
+      ss << GENERATED_PROFILE_COUNTS << "[" << site << "][" << clazz << "->"
+         << GENERATED_CLASS_ID_FIELD << "]++;\n";
+      return ss.str();
+    }
+    /**
+     * Loaded counts for a site.
+     *
+     * @param site Site number
+     * @return Class counts.  Empty if the site never ran or the profile does not match it.
+     */
+    const Histogram &histogram(unsigned site) const {
+      static const Histogram empty;
+      auto itr = counts_.find(site);
+      if (itr == counts_.end() || site >= sites_.size() || itr->second.first != sites_[site])
+        return empty;
+      return itr->second.second;
+    }
+    /**
+     * Name of the only class seen at a site.
+     *
+     * @param site Site number
+     * @return Class name.  Empty if the site never ran or saw more than one class.
+     */
+    std::string monomorphic_class(unsigned site) const {
+      const Histogram &counts = histogram(site);
+      return counts.size() == 1 ? counts.begin()->first : "";
+    }
+    /**
+     * Reads a profile written by an instrumented build.  Each line after the header is a site
+     * number and label followed by "class:count" pairs.
+     *
+     * @param path Profile file
+     * @return True if the profile was read
+     */
+    bool load(const std::string &path) {
+      std::ifstream fin(path);
+      std::string line;
+      if (!fin || !std::getline(fin, line) || line != PROFILE_FILE_HEADER)
+        return false;
+      while (std::getline(fin, line)) {
+        std::istringstream ss(line);
+        unsigned site;
+        std::string label, entry;
+        if (!(ss >> site >> label))
+          continue;
+        auto &site_counts = counts_[site];
+        site_counts.first = label;
+        while (ss >> entry) {
+          std::size_t colon = entry.rfind(':');
+          if (colon != std::string::npos)
+            site_counts.second[entry.substr(0, colon)]
+                += std::strtoul(entry.c_str() + colon + 1, nullptr, 10);
+        }
+      }
+      return true;
+    }
+    /**
+     * Writes the counters and the function that saves them when the program ends.  It must
+     * be called after all code is generated so that every site is known.
+     *
+     * @param out Stream to write to
+     * @param class_names Name of each class indexed by class ID
+     * @param path Profile file the program writes
+     */
+    void export_runtime(std::ostream &out, const std::vector<std::string> &class_names,
+                        const std::string &path) const {
+      std::string indent(2, ' ');
+      out << "/*======================= Profile =======================*/\n";
+      if (!sites_.empty()) {
+        out << "static unsigned long " << GENERATED_PROFILE_COUNTS << "[" << sites_.size()
+            << "][" << class_names.size() << "];\n";
+        out << "static const char * const quack_profile_sites[] = {";
+        for (unsigned i = 0; i < sites_.size(); i++)
+          out << (i == 0 ? "" : ", ") << "\"" << sites_[i] << "\"";
+        out << "};\n";
+        out << "static const char * const quack_profile_classes[] = {";
+        for (unsigned i = 0; i < class_names.size(); i++)
+          out << (i == 0 ? "" : ", ") << "\"" << class_names[i] << "\"";
+        out << "};\n";
+      }
+
+      std::string escaped_path;
+      for (char c : path) {
+        if (c == '\\' || c == '"')
+          escaped_path += '\\';
+        escaped_path += c;
+      }
+      out << "static void " << GENERATED_PROFILE_WRITE_FUNC << "(void) {\n"
+          << indent << "FILE * f = fopen(\"" << escaped_path << "\", \"w\");\n"
+          << indent << "if (f == NULL)\n" << indent << indent << "return;\n"
+          << indent << "fputs(\"" << PROFILE_FILE_HEADER << "\\n\", f);\n";
+      if (!sites_.empty()) {
+        out << indent << "for (unsigned site = 0; site < " << sites_.size() << "; site++) {\n"
+            << indent << indent << "fprintf(f, \"%u %s\", site, quack_profile_sites[site]);\n"
+            << indent << indent << "for (unsigned id = 0; id < " << class_names.size()
+            << "; id++)\n"
+            << indent << indent << indent << "if (" << GENERATED_PROFILE_COUNTS
+            << "[site][id] != 0)\n"
+            << indent << indent << indent << indent << "fprintf(f, \" %s:%lu\", "
+            << "quack_profile_classes[id], " << GENERATED_PROFILE_COUNTS << "[site][id]);\n"
+            << indent << indent << "fputc('\\n', f);\n"
+            << indent << "}\n";
+      }
+      out << indent << "fclose(f);\n}\n\n";
+    }
+
+   private:
+    const bool instrument_;
+    /** Label of each site numbered so far */
+    std::vector<std::string> sites_;
+    /** Loaded label and class counts of each site */
+    std::map<unsigned, std::pair<std::string, Histogram>> counts_;
+  };
+
   struct Settings {
-    std::ofstream & fout_;
+    std::ostream & fout_;
     Quack::Class * return_type_;
     Symbol::Table * st_;
+    /** If not null, object temporaries are declared here instead of where they are assigned */
+    HoistedTemps * hoisted_temps_;
+    /** If not null, Int and String literals reference static objects in this pool */
+    LiteralPool * literal_pool_;
+    /** If true, method bodies are generated from the SSA intermediate representation */
+    bool use_ir_;
+    /** If true, the SSA form of each method is printed as it is generated */
+    bool print_ir_;
+    /** If true, the runtime is compiled into the generated file so functions are static */
+    bool amalgamate_;
+    /** If not null, dynamically dispatched calls and typecases are instrumented or optimized */
+    Profile * profile_;
+    /** Method whose body is being generated.  nullptr for constructors and main. */
+    Quack::Method * method_;
+    /**
+     * Label of the start of method_'s statements.  It is named by the first tail call that
+     * jumps to it so that it is only generated when used.
+     */
+    std::string * entry_label_;
 
-    explicit Settings(std::ofstream& fout) : fout_(fout), return_type_(nullptr), st_(nullptr) {}
+    explicit Settings(std::ostream& fout) : fout_(fout), return_type_(nullptr), st_(nullptr),
+                                            hoisted_temps_(nullptr), literal_pool_(nullptr),
+                                            use_ir_(false), print_ir_(false),
+                                            amalgamate_(false), profile_(nullptr),
+                                            method_(nullptr), entry_label_(nullptr) {}
+    /**
+     * Copies the settings but writes to a different stream.
+     *
+     * @param fout Stream where code will be written
+     * @param other Settings to copy
+     */
+    Settings(std::ostream& fout, const Settings &other)
+        : fout_(fout), return_type_(other.return_type_), st_(other.st_),
+          hoisted_temps_(other.hoisted_temps_), literal_pool_(other.literal_pool_),
+          use_ir_(other.use_ir_), print_ir_(other.print_ir_),
+          amalgamate_(other.amalgamate_), profile_(other.profile_), method_(other.method_),
+          entry_label_(other.entry_label_) {}
   };
 }
 
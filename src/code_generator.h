@@ -9,7 +9,10 @@
 #include <iomanip>
 #include <sstream>
 #include <fstream>
-#include <stack>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <iostream>
 
 #include "quack_program.h"
 #include "quack_class.h"
@@ -21,25 +24,24 @@ namespace CodeGen {
   class Gen {
    public:
 
-    Gen(Quack::Program * prog, const std::string &quack_filename) : prog_(prog) {
-      #ifdef _WIN32
-        char file_sep = '\\';
-      #else
-        char file_sep = '/';
-      #endif
-      std::size_t per_loc = quack_filename.rfind('.');
-      std::size_t slash_loc = quack_filename.rfind(file_sep);
-
-      // Preserve path and filename for the generated code
-      if (per_loc==std::string::npos || (slash_loc != std::string::npos && per_loc < slash_loc)) {
-        output_file_path_ = quack_filename;
-      } else if (per_loc == 0 || (slash_loc != std::string::npos && per_loc == slash_loc + 1)) {
-        throw std::runtime_error("It appears you have only file extension and no file name");
-      } else {
-        output_file_path_ = quack_filename.substr(0, per_loc);
-      }
-      output_file_path_ += ".c";
-
+    /**
+     * Creates a code generator for a program.
+     *
+     * @param prog Type checked program
+     * @param quack_filename Path of the Quack source.  The C file is written next to it.
+     * @param use_ir If true, method bodies are generated from the SSA intermediate representation
+     * @param print_ir If true, the SSA form of each method is printed
+     * @param amalgamate If true, builtins.c is included in the C file instead of linked with it
+     * @param profile_mode Whether to instrument the program or to optimize it with a profile.
+     *                     The profile is next to the Quack source with the extension ".profile".
+     */
+    Gen(Quack::Program * prog, const std::string &quack_filename, bool use_ir = false,
+        bool print_ir = false, bool amalgamate = false,
+        ProfileMode profile_mode = ProfileMode::None)
+        : prog_(prog), use_ir_(use_ir), print_ir_(print_ir), amalgamate_(amalgamate),
+          profile_mode_(profile_mode) {
+      output_file_path_ = output_path(quack_filename, ".c");
+      profile_path_ = output_path(quack_filename, ".profile");
       fout_.open(output_file_path_);
     }
 
@@ -53,66 +55,170 @@ namespace CodeGen {
       export_includes();
 
       std::vector<Quack::Class*> user_classes = topologically_sort_classes();
+      Quack::Class::number_classes();
 
-      CodeGen::Settings settings(fout_);
+      // Literals are only known after all code is generated but must be defined first
+      std::ostringstream code;
+      LiteralPool literal_pool;
+      CodeGen::Settings settings(code);
+      settings.literal_pool_ = &literal_pool;
+      settings.use_ir_ = use_ir_;
+      settings.print_ir_ = print_ir_;
+      settings.amalgamate_ = amalgamate_;
+
+      std::unique_ptr<Profile> profile;
+      if (profile_mode_ != ProfileMode::None) {
+        profile.reset(new Profile(profile_mode_ == ProfileMode::Generate));
+        if (!profile->instrument() && !profile->load(profile_path_))
+          std::cerr << "Warning: Unable to read profile " << profile_path_ << std::endl;
+        settings.profile_ = profile.get();
+      }
+      // Guarded direct calls may target methods of classes generated later
+      if (profile && !profile->instrument())
+        export_forward_declarations(settings, user_classes);
       for (auto q_class : user_classes)
         q_class->generate_code(settings);
 
       export_main(settings);
+
+      export_literal_pool(literal_pool);
+      if (profile && profile->instrument())
+        profile->export_runtime(fout_, class_names(), profile_path_);
+      fout_ << code.str();
       std::cout << "Code generation completed successfully." << std::endl;
     }
 
+    /**
+     * Builds the path of a generated file.  It is in the same location and has the same name as
+     * the Quack source; only the extension changes.
+     *
+     * @param quack_filename Path of the Quack source
+     * @param extension Extension of the generated file including the period
+     * @return Path of the generated file
+     */
+    static std::string output_path(const std::string &quack_filename,
+                                   const std::string &extension) {
+      #ifdef _WIN32
+        char file_sep = '\\';
+      #else
+        char file_sep = '/';
+      #endif
+      std::size_t per_loc = quack_filename.rfind('.');
+      std::size_t slash_loc = quack_filename.rfind(file_sep);
+
+      // Preserve path and filename for the generated code
+      std::string path;
+      if (per_loc==std::string::npos || (slash_loc != std::string::npos && per_loc < slash_loc)) {
+        path = quack_filename;
+      } else if (per_loc == 0 || (slash_loc != std::string::npos && per_loc == slash_loc + 1)) {
+        throw std::runtime_error("It appears you have only file extension and no file name");
+      } else {
+        path = quack_filename.substr(0, per_loc);
+      }
+      return path + extension;
+    }
+
    private:
     /**
      * Classes are topologically sorted.  This is needed to ensure that inherited classes
-     * have the functions of their super classes already defined in the generated code.
-     * This approach relies on a stack to ensure super classes are found before sub classes
+     * have the functions of their super classes already defined in the generated code.  The
+     * struct of an object embedded in an inlined field must likewise be defined first.
      *
      * @return Tpologically sorted classes
      */
     static std::vector<Quack::Class*> topologically_sort_classes() {
       std::vector<Quack::Class*> user_classes;
-      for (auto & class_pair : *Quack::Class::Container::singleton()) {
-        std::stack<Quack::Class*> stack;
-        Quack::Class* q_class = class_pair.second;
-        if (!q_class->is_user_class())
-          continue;
-        do {
-          bool found = false;
-          for (auto * temp_class : user_classes) {
-            if (temp_class->name_ == q_class->name_) {
-              found = true;
-              break;
-            }
-          }
-
-          if (found)
-            break;
-
-          stack.push(q_class);
-          q_class = q_class->super_;
-        } while(q_class && q_class->is_user_class());
-
-        // Add all new classes with super classes first
-        while(!stack.empty()) {
-          user_classes.emplace_back(stack.top());
-          stack.pop();
-        }
-      }
+      for (auto & class_pair : *Quack::Class::Container::singleton())
+        add_sorted_class(class_pair.second, user_classes);
       return user_classes;
     }
-    /** Write any includes to the beginning of the generated file. */
+    /**
+     * Adds a user class to the sorted classes after all the classes it depends on.
+     *
+     * @param q_class Class to add
+     * @param user_classes Classes sorted so far
+     */
+    static void add_sorted_class(Quack::Class * q_class, std::vector<Quack::Class*> &user_classes) {
+      if (q_class == nullptr || !q_class->is_user_class() || !q_class->is_reachable()
+          || std::find(user_classes.begin(), user_classes.end(), q_class) != user_classes.end())
+        return;
+
+      add_sorted_class(q_class->super_, user_classes);
+      for (const auto &field_info : *Quack::Class::build_generated_fields(q_class))
+        add_sorted_class(q_class->inline_field_class(field_info.second->name_), user_classes);
+      user_classes.emplace_back(q_class);
+    }
+    /**
+     * Declares the object type and the functions of every user class ahead of all definitions.
+     *
+     * @param settings Code generator settings
+     * @param user_classes All user classes
+     */
+    static void export_forward_declarations(CodeGen::Settings settings,
+                                            const std::vector<Quack::Class*> &user_classes) {
+      for (auto * q_class : user_classes)
+        settings.fout_ << "typedef struct " << q_class->generated_malloc_obj_name() << " * "
+                       << q_class->generated_object_type_name() << ";\n";
+      for (auto * q_class : user_classes)
+        q_class->generate_all_prototypes(settings);
+      settings.fout_ << std::endl;
+    }
+    /**
+     * Name of each class indexed by class ID.  Classes must already be numbered.
+     *
+     * @return Class names
+     */
+    static std::vector<std::string> class_names() {
+      std::vector<std::string> names(Quack::Class::Container::singleton()->count());
+      for (auto &class_pair : *Quack::Class::Container::singleton())
+        names.at(class_pair.second->class_id_) = class_pair.second->name_;
+      return names;
+    }
+    /**
+     * Write any includes to the beginning of the generated file.  When amalgamating, the
+     * runtime source itself is included so that the whole program is one translation unit.
+     */
     void export_includes() {
-      std::pair<std::string, bool> libs[] = {{"stdlib", false},
-                                             {"stdio", false},
-                                             {"stdbool", false},
-                                             {"builtins", true}};
+      std::pair<std::string, bool> libs[] = {{"stdlib.h", false},
+                                             {"stdio.h", false},
+                                             {"stdbool.h", false},
+                                             {amalgamate_ ? "builtins.c" : "builtins.h", true}};
+      if (amalgamate_)
+        fout_ << "#define QUACK_AMALGAMATION\n";
       for (auto &lib_pair : libs) {
         fout_ << "#include " << (lib_pair.second ? "\"" : "<")
-              << lib_pair.first << ".h" << (lib_pair.second ? "\"" : ">") << "\n";
+              << lib_pair.first << (lib_pair.second ? "\"" : ">") << "\n";
       }
       fout_ << std::endl;
     }
+    /**
+     * Writes the statically allocated objects for all literals in the program.  Int literals
+     * are only needed when the runtime does not tag Int values.
+     *
+     * @param literal_pool Literals used by the program
+     */
+    void export_literal_pool(const LiteralPool &literal_pool) {
+      if (literal_pool.ints().empty() && literal_pool.strs().empty())
+        return;
+
+      fout_ << "/*======================= Literal Pool =======================*/\n";
+      Quack::Class * int_class = Quack::Class::Container::Int();
+      if (!literal_pool.ints().empty()) {
+        fout_ << "#ifndef QUACK_TAGGED_INT\n";
+        for (const auto &lit : literal_pool.ints())
+          fout_ << "static struct " << int_class->generated_malloc_obj_name() << " "
+                << lit.second << " = { &" << int_class->generated_clazz_obj_struct_name()
+                << ", " << lit.first << " };\n";
+        fout_ << "#endif\n";
+      }
+
+      Quack::Class * str_class = Quack::Class::Container::Str();
+      for (const auto &lit : literal_pool.strs())
+        fout_ << "static struct " << str_class->generated_malloc_obj_name() << " "
+              << lit.second << " = { &" << str_class->generated_clazz_obj_struct_name()
+              << ", \"" << lit.first << "\", sizeof(\"" << lit.first << "\") - 1, NULL, NULL };\n";
+      fout_ << std::endl;
+    }
     /**
      * Helper function to generate the C code associated with the main function call.
      *
@@ -121,18 +227,17 @@ namespace CodeGen {
     void generate_main(CodeGen::Settings settings, const std::string &main_subfunc_name) {
       Quack::Class * nothing_class = Quack::Class::Container::Nothing();
 
-      fout_ << "\n"
-            << nothing_class->generated_object_type_name() << " " << main_subfunc_name << "() {\n";
+      settings.fout_ << "\n" << (settings.amalgamate_ ? "static " : "")
+                     << nothing_class->generated_object_type_name() << " "
+                     << main_subfunc_name << "() {\n";
 
       settings.return_type_ = Quack::Class::Container::Nothing();
       settings.st_ = prog_->main_->symbol_table_;
 
-      Quack::Class::generate_symbol_table(settings, 1, prog_->main_);
-      AST::ASTNode::generate_one_line_comment(settings, 1, "main Method Body");
-      prog_->main_->block_->generate_code(settings, 0);
+      Quack::Class::generate_method_body(settings, prog_->main_, nullptr, false);
 
-      fout_ << AST::ASTNode::indent_str(1) << "return none;\n"
-            << "}" << std::endl;
+      settings.fout_ << AST::ASTNode::indent_str(1) << "return none;\n"
+                     << "}" << std::endl;
 
       settings.return_type_ = nullptr;
       settings.st_ = nullptr;
@@ -141,9 +246,26 @@ namespace CodeGen {
     void export_main(CodeGen::Settings settings) {
       generate_main(settings, METHOD_MAIN);
 
-      fout_ << "\n" << "int main() {"
-            << "\n" << AST::ASTNode::indent_str(1) << METHOD_MAIN << "();\n"
-            << "}" << std::endl;
+      settings.fout_ << "\n" << "int main() {\n";
+
+      // The runtime cannot know how user classes extend the builtin class intervals
+      for (auto &class_pair : *Quack::Class::Container::singleton()) {
+        Quack::Class * q_class = class_pair.second;
+        if (q_class->is_user_class())
+          continue;
+        std::string clazz_struct = q_class->generated_clazz_obj_struct_name();
+        settings.fout_ << AST::ASTNode::indent_str(1)
+                       << clazz_struct << "." << GENERATED_CLASS_ID_FIELD << " = "
+                       << q_class->class_id_ << ";\n"
+                       << AST::ASTNode::indent_str(1)
+                       << clazz_struct << "." << GENERATED_SUBTREE_END_FIELD << " = "
+                       << q_class->subtree_end_ << ";\n";
+      }
+
+      settings.fout_ << AST::ASTNode::indent_str(1) << METHOD_MAIN << "();\n";
+      if (settings.profile_ != nullptr && settings.profile_->instrument())
+        settings.fout_ << AST::ASTNode::indent_str(1) << GENERATED_PROFILE_WRITE_FUNC << "();\n";
+      settings.fout_ << "}" << std::endl;
     }
     /** Location to which the generated code is written */
     std::string output_file_path_;
@@ -151,6 +273,16 @@ namespace CodeGen {
     std::ofstream fout_;
 
     const Quack::Program * prog_;
+    /** Generate method bodies from the SSA intermediate representation */
+    const bool use_ir_;
+    /** Print the SSA form of each method */
+    const bool print_ir_;
+    /** Include the runtime in the generated file */
+    const bool amalgamate_;
+    /** Whether dynamically dispatched calls and typecases are instrumented or optimized */
+    const ProfileMode profile_mode_;
+    /** Location of the profile written by an instrumented build */
+    std::string profile_path_;
   };
 }
 
@@ -0,0 +1,380 @@
+//
+// Compile-time folding of Int, Boolean, and String constants.
+//
+
+#include <climits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "constant_folder.h"
+#include "ASTNode.h"
+#include "quack_class.h"
+#include "keywords.h"
+
+namespace AST {
+  /**
+   * Creates a typed Int literal.
+   *
+   * @param value Value of the literal
+   * @return New literal node
+   */
+  static ASTNode * make_int(int value) {
+    auto * lit = new IntLit(value);
+    lit->set_node_type(Quack::Class::Container::Int());
+    return lit;
+  }
+
+  static ASTNode * make_bool(bool value) {
+    auto * lit = new BoolLit(value);
+    lit->set_node_type(Quack::Class::Container::Bool());
+    return lit;
+  }
+  /**
+   * Creates a typed String literal.
+   *
+   * @param text Text of the literal as it appears in the source (i.e., with escape codes)
+   * @return New literal node
+   */
+  static ASTNode * make_str(const std::string &text) {
+    auto * lit = new StrLit(text.c_str());
+    lit->set_node_type(Quack::Class::Container::Str());
+    return lit;
+  }
+  /**
+   * Copies an Int, Boolean, or String literal.
+   *
+   * @param node Node to copy
+   * @return New literal or nullptr if the node is not one of the supported literals
+   */
+  static ASTNode * copy_literal(const ASTNode * node) {
+    if (auto * int_lit = dynamic_cast<const IntLit*>(node))
+      return make_int(int_lit->value_);
+    if (auto * bool_lit = dynamic_cast<const BoolLit*>(node))
+      return make_bool(bool_lit->value_);
+    if (auto * str_lit = dynamic_cast<const StrLit*>(node))
+      return make_str(str_lit->value_);
+    return nullptr;
+  }
+  /**
+   * Checks whether two literals have the same type and value.
+   *
+   * @param a First literal
+   * @param b Second literal
+   * @return True if the literals are identical
+   */
+  static bool same_literal(const ASTNode * a, const ASTNode * b) {
+    if (a->get_node_type() != b->get_node_type())
+      return false;
+    if (auto * int_lit = dynamic_cast<const IntLit*>(a))
+      return int_lit->value_ == dynamic_cast<const IntLit*>(b)->value_;
+    if (auto * bool_lit = dynamic_cast<const BoolLit*>(a))
+      return bool_lit->value_ == dynamic_cast<const BoolLit*>(b)->value_;
+    return dynamic_cast<const StrLit*>(a)->value_ == dynamic_cast<const StrLit*>(b)->value_;
+  }
+  /**
+   * Replaces the escape codes in a String literal with the characters they represent.
+   *
+   * @param text Literal text as it appears in the source
+   * @param decoded Text with the escape codes replaced
+   * @return False if the text contains a null character, which the runtime treats as the
+   *         end of the string
+   */
+  static bool decode_string(const std::string &text, std::string &decoded) {
+    decoded.clear();
+    for (unsigned i = 0; i < text.size(); i++) {
+      if (text[i] != '\\') {
+        decoded += text[i];
+        continue;
+      }
+      switch (text[++i]) {
+        case '0': return false;
+        case 'b': decoded += '\b'; break;
+        case 't': decoded += '\t'; break;
+        case 'n': decoded += '\n'; break;
+        case 'r': decoded += '\r'; break;
+        case 'f': decoded += '\f'; break;
+        default: decoded += text[i]; break;
+      }
+    }
+    return true;
+  }
+  /**
+   * Escapes the text of a String so it can be written as a literal.
+   *
+   * @param decoded String value
+   * @return Literal text
+   */
+  static std::string encode_string(const std::string &decoded) {
+    std::string text;
+    for (char c : decoded) {
+      switch (c) {
+        case '\b': text += "\\b"; break;
+        case '\t': text += "\\t"; break;
+        case '\n': text += "\\n"; break;
+        case '\r': text += "\\r"; break;
+        case '\f': text += "\\f"; break;
+        case '"': text += "\\\""; break;
+        case '\\': text += "\\\\"; break;
+        default: text += c; break;
+      }
+    }
+    return text;
+  }
+  /**
+   * Checks whether evaluating the node can have side effects.
+   *
+   * @param node Node to check
+   * @return True if the node is a literal or a variable
+   */
+  static bool is_pure(const ASTNode * node) {
+    return dynamic_cast<const Ident*>(node) != nullptr || dynamic_cast<const IntLit*>(node)
+           || dynamic_cast<const BoolLit*>(node) || dynamic_cast<const StrLit*>(node);
+  }
+  /**
+   * Evaluates an Int operator the way the runtime would.
+   *
+   * @param opsym Operator symbol
+   * @param left Left operand
+   * @param right Right operand
+   * @return Literal result or nullptr if the operation cannot be safely evaluated
+   */
+  static ASTNode * fold_int_op(const std::string &opsym, int left, int right) {
+    long long l = left, r = right, result;
+    if (opsym == "+")
+      result = l + r;
+    else if (opsym == "-")
+      result = l - r;
+    else if (opsym == "*")
+      result = l * r;
+    else if (opsym == "/") {
+      if (r == 0)
+        return nullptr;
+      result = l / r;
+    } else if (opsym == "<")
+      return make_bool(l < r);
+    else if (opsym == "<=")
+      return make_bool(l <= r);
+    else if (opsym == ">")
+      return make_bool(l > r);
+    else if (opsym == ">=")
+      return make_bool(l >= r);
+    else if (opsym == "==")
+      return make_bool(l == r);
+    else
+      return nullptr;
+
+    if (result < INT_MIN || result > INT_MAX)
+      return nullptr;
+    return make_int((int) result);
+  }
+
+  void Block::fold_constants(ConstFold::Settings &settings) {
+    std::vector<ASTNode *> stmts;
+    for (auto * stmt : stmts_) {
+      // Once a return is reached, the remaining statements never execute
+      if (!stmts.empty() && stmts.back()->contains_return_all_paths()) {
+        delete stmt;
+        continue;
+      }
+
+      ASTNode::fold_child(settings, stmt);
+      if (auto * if_stmt = dynamic_cast<If*>(stmt)) {
+        if (Block * branch = if_stmt->release_constant_branch()) {
+          for (auto * branch_stmt : branch->stmts_)
+            if (stmts.empty() || !stmts.back()->contains_return_all_paths())
+              stmts.emplace_back(branch_stmt);
+            else
+              delete branch_stmt;
+          branch->stmts_.clear();
+          delete branch;
+          delete if_stmt;
+          continue;
+        }
+      }
+      if (auto * while_stmt = dynamic_cast<While*>(stmt)) {
+        if (while_stmt->never_executes()) {
+          delete while_stmt;
+          continue;
+        }
+      }
+      stmts.emplace_back(stmt);
+    }
+    stmts_ = stmts;
+  }
+
+  ASTNode * If::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, cond_);
+    truepart_->fold_constants(settings);
+    if (falsepart_)
+      falsepart_->fold_constants(settings);
+    return this;
+  }
+
+  Block * If::release_constant_branch() {
+    auto * cond = dynamic_cast<BoolLit*>(cond_);
+    if (cond == nullptr)
+      return nullptr;
+
+    Block *&branch = cond->value_ ? truepart_ : falsepart_;
+    Block * taken = branch != nullptr ? branch : new Block();
+    branch = nullptr;
+    return taken;
+  }
+
+  ASTNode * Ident::fold_constants(ConstFold::Settings &settings) {
+    const ASTNode * lit = settings.get_constant(text_);
+    return lit != nullptr ? copy_literal(lit) : this;
+  }
+
+  ASTNode * Return::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, right_);
+    return this;
+  }
+
+  ASTNode * While::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, cond_);
+    body_->fold_constants(settings);
+    return this;
+  }
+
+  bool While::never_executes() const {
+    auto * cond = dynamic_cast<BoolLit*>(cond_);
+    return cond != nullptr && !cond->value_;
+  }
+
+  ASTNode * RhsArgs::fold_constants(ConstFold::Settings &settings) {
+    for (auto &arg : args_)
+      fold_child(settings, arg);
+    return this;
+  }
+
+  ASTNode * FunctionCall::fold_constants(ConstFold::Settings &settings) {
+    args_->fold_constants(settings);
+    return this;
+  }
+
+  ASTNode * ObjectCall::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, object_);
+    if (auto * func = dynamic_cast<FunctionCall*>(next_))
+      func->fold_constants(settings);
+    return this;
+  }
+
+  ASTNode * BinOp::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, left_);
+    fold_child(settings, right_);
+
+    auto * l_int = dynamic_cast<IntLit*>(left_);
+    auto * r_int = dynamic_cast<IntLit*>(right_);
+    if (l_int != nullptr && r_int != nullptr) {
+      ASTNode * folded = fold_int_op(opsym, l_int->value_, r_int->value_);
+      return folded != nullptr ? folded : this;
+    }
+
+    auto * l_bool = dynamic_cast<BoolLit*>(left_);
+    auto * r_bool = dynamic_cast<BoolLit*>(right_);
+    if (l_bool != nullptr && r_bool != nullptr && opsym == "==")
+      return make_bool(l_bool->value_ == r_bool->value_);
+
+    auto * l_str = dynamic_cast<StrLit*>(left_);
+    auto * r_str = dynamic_cast<StrLit*>(right_);
+    std::string l_text, r_text;
+    if (l_str == nullptr || r_str == nullptr || !decode_string(l_str->value_, l_text)
+        || !decode_string(r_str->value_, r_text))
+      return this;
+    if (opsym == "+")
+      return make_str(encode_string(l_text + r_text));
+    if (opsym == "==")
+      return make_bool(l_text == r_text);
+    // String ordering is left to the runtime
+    return this;
+  }
+
+  ASTNode * BoolOp::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, left_);
+    if (opsym == UNARY_OP_NOT) {
+      auto * operand = dynamic_cast<BoolLit*>(left_);
+      return operand != nullptr ? make_bool(!operand->value_) : this;
+    }
+    fold_child(settings, right_);
+
+    // Value that decides the result regardless of the other operand
+    bool dominant = opsym == METHOD_OR;
+    if (auto * left = dynamic_cast<BoolLit*>(left_)) {
+      if (left->value_ == dominant)
+        return make_bool(dominant);
+      ASTNode * right = right_;
+      right_ = nullptr;
+      return right;
+    }
+    if (auto * right = dynamic_cast<BoolLit*>(right_)) {
+      if (right->value_ == dominant)
+        return is_pure(left_) ? make_bool(dominant) : this;
+      ASTNode * left = left_;
+      left_ = nullptr;
+      return left;
+    }
+    return this;
+  }
+
+  ASTNode * UniOp::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, right_);
+    auto * operand = dynamic_cast<IntLit*>(right_);
+    if (opsym == UNARY_OP_NEG && operand != nullptr && operand->value_ != INT_MIN)
+      return make_int(-operand->value_);
+    return this;
+  }
+
+  ASTNode * Assn::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, rhs_);
+    if (auto * var = dynamic_cast<Ident*>(lhs_->expr_))
+      settings.record_assignment(var->text_, rhs_);
+    return this;
+  }
+
+  ASTNode * Typecase::fold_constants(ConstFold::Settings &settings) {
+    fold_child(settings, expr_);
+    for (auto * alt : *alts_) {
+      settings.record_assignment(alt->type_names_[0], nullptr);
+      alt->block_->fold_constants(settings);
+    }
+    return this;
+  }
+}
+
+namespace ConstFold {
+
+  void Settings::record_assignment(const std::string &name, const AST::ASTNode * rhs) {
+    if (non_constants_.count(name) != 0)
+      return;
+
+    AST::ASTNode * lit = rhs != nullptr ? AST::copy_literal(rhs) : nullptr;
+    auto itr = assignments_.find(name);
+    if (itr == assignments_.end()) {
+      assignments_[name].reset(lit);
+      return;
+    }
+    if (lit == nullptr || itr->second == nullptr || !AST::same_literal(itr->second.get(), lit))
+      itr->second.reset();
+    delete lit;
+  }
+
+  bool Settings::update_constants() {
+    bool changed = false;
+    for (auto &assignment : assignments_) {
+      const std::string &name = assignment.first;
+      auto &lit = assignment.second;
+      if (lit == nullptr || constants_.count(name) != 0)
+        continue;
+
+      // Variables declared with a wider type keep their declared type
+      if (!st_->exists(name, false) || st_->get(name, false)->get_type() != lit->get_node_type())
+        continue;
+      constants_[name] = std::move(lit);
+      changed = true;
+    }
+    assignments_.clear();
+    return changed;
+  }
+}
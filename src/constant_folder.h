@@ -0,0 +1,101 @@
+//
+// Compile-time folding of Int, Boolean, and String constants.
+//
+
+#ifndef TYPE_CHECKER_CONSTANT_FOLDER_H
+#define TYPE_CHECKER_CONSTANT_FOLDER_H
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "quack_program.h"
+#include "quack_class.h"
+#include "ASTNode.h"
+
+namespace ConstFold {
+  struct Settings {
+    explicit Settings(Symbol::Table * st) : st_(st) {}
+    /**
+     * Accessor for the literal a local variable is known to hold.
+     *
+     * @param name Variable name
+     * @return Literal node or nullptr if the variable is not constant
+     */
+    const AST::ASTNode * get_constant(const std::string &name) const {
+      auto itr = constants_.find(name);
+      return itr == constants_.end() ? nullptr : itr->second.get();
+    }
+    /**
+     * Records an assignment to a local variable.
+     *
+     * @param name Variable name
+     * @param rhs Assigned expression.  nullptr if the assigned value is not known.
+     */
+    void record_assignment(const std::string &name, const AST::ASTNode * rhs);
+    /**
+     * Marks local variables as constant when every assignment recorded since the last update
+     * stores the same literal.  Since each variable is initialized before use on all paths,
+     * every read of such a variable sees that literal.
+     *
+     * @return True if any new variable became constant
+     */
+    bool update_constants();
+
+    /** Symbol table of the method being folded */
+    Symbol::Table * st_;
+    /** Variables that are never constant (e.g., parameters) */
+    std::set<std::string> non_constants_;
+
+   private:
+    /** Copy of the literal assigned to each variable.  nullptr if the assignments differ. */
+    std::map<std::string, std::unique_ptr<AST::ASTNode>> assignments_;
+    /** Copy of the literal each constant variable holds */
+    std::map<std::string, std::unique_ptr<AST::ASTNode>> constants_;
+  };
+}
+
+namespace Quack {
+  /**
+   * Folds operators whose operands are Int, Boolean, or String literals (or locals proven to
+   * hold one) into a single literal and removes If and While blocks whose conditions fold to
+   * a constant.  Runs after type inference so that the type of every node is known.
+   */
+  class ConstantFolder {
+   public:
+    ConstantFolder() = default;
+
+    void run(Program * prog) {
+      for (auto &class_pair : *Class::Container::singleton()) {
+        Class * q_class = class_pair.second;
+        if (!q_class->is_user_class())
+          continue;
+
+        fold_method(q_class->constructor_);
+        for (auto &method_pair : *q_class->methods_)
+          fold_method(method_pair.second);
+      }
+      fold_method(prog->main_);
+    }
+
+   private:
+    /**
+     * Folds a method's block until no more locals are found to be constant.
+     *
+     * @param method Method, constructor, or main to fold
+     */
+    static void fold_method(Method * method) {
+      ConstFold::Settings settings(method->symbol_table_);
+      for (auto * param : *method->params_)
+        settings.non_constants_.emplace(param->name_);
+      settings.non_constants_.emplace(OBJECT_SELF);
+
+      do {
+        method->block_->fold_constants(settings);
+      } while (settings.update_constants());
+    }
+  };
+}
+
+#endif //TYPE_CHECKER_CONSTANT_FOLDER_H
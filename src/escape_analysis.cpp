@@ -0,0 +1,348 @@
+//
+// Intraprocedural escape analysis that finds objects which can live on the C stack.
+//
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "escape_analysis.h"
+#include "ASTNode.h"
+#include "quack_class.h"
+#include "keywords.h"
+
+namespace AST {
+  /**
+   * Identifies the field an object call refers to.
+   *
+   * @param field Object call of the form obj.<FieldName>
+   * @return Class that declares the field and the field's name
+   */
+  static Escape::FieldKey field_key(const ObjectCall * field) {
+    const std::string &name = dynamic_cast<Ident*>(field->next_)->text_;
+    return Escape::FieldKey(field->object_->get_node_type()->field_owner(name), name);
+  }
+  /**
+   * Class constructed by the right side of an assignment.
+   *
+   * @param rhs Right side of the assignment
+   * @return User class or nullptr if the right side is not a user constructor call
+   */
+  static Quack::Class * constructed_class(const ASTNode * rhs) {
+    auto * call = dynamic_cast<const FunctionCall*>(rhs);
+    if (call == nullptr)
+      return nullptr;
+    Quack::Class * q_class = Quack::Class::Container::singleton()->get(call->ident_);
+    return q_class->is_user_class() ? q_class : nullptr;
+  }
+
+  void Block::find_escapes(Escape::Settings &settings) const {
+    for (auto * stmt : stmts_) {
+      settings.discards_value_ = dynamic_cast<ObjectCall*>(stmt) != nullptr;
+      stmt->find_escapes(settings);
+    }
+  }
+
+  void If::find_escapes(Escape::Settings &settings) const {
+    cond_->find_escapes(settings);
+    truepart_->find_escapes(settings);
+    if (falsepart_)
+      falsepart_->find_escapes(settings);
+  }
+
+  void Ident::find_escapes(Escape::Settings &settings) const {
+    settings.escape(text_);
+  }
+
+  void Return::find_escapes(Escape::Settings &settings) const {
+    right_->find_escapes(settings);
+  }
+
+  void While::find_escapes(Escape::Settings &settings) const {
+    cond_->find_escapes(settings);
+    body_->find_escapes(settings);
+  }
+
+  void RhsArgs::find_escapes(Escape::Settings &settings) const {
+    for (auto * arg : args_)
+      arg->find_escapes(settings);
+  }
+
+  void FunctionCall::find_escapes(Escape::Settings &settings) const {
+    args_->find_escapes(settings);
+  }
+
+  void ObjectCall::find_escapes(Escape::Settings &settings) const {
+    auto * receiver = dynamic_cast<Ident*>(object_);
+    auto * func = dynamic_cast<FunctionCall*>(next_);
+    // The builtin PRINT returns its receiver, so a used result is another reference to it
+    bool returns_receiver = func != nullptr && func->ident_ == METHOD_PRINT
+                            && !settings.discards_value_;
+    settings.discards_value_ = false;
+    if (func != nullptr)
+      func->find_escapes(settings);
+    else
+      settings.fields_.escaped_.emplace(field_key(this));
+
+    // Like a local's, a field's object only escapes through a call if the method lets it
+    auto * field = dynamic_cast<ObjectCall*>(object_);
+    if (func != nullptr && field != nullptr && dynamic_cast<Ident*>(field->next_) != nullptr) {
+      settings.fields_.calls_.emplace_back(field_key(field), func->ident_);
+      if (returns_receiver)
+        settings.fields_.escaped_.emplace(field_key(field));
+      if (dynamic_cast<Ident*>(field->object_) == nullptr)
+        field->object_->find_escapes(settings);
+      return;
+    }
+
+    if (receiver == nullptr)
+      object_->find_escapes(settings);
+    else if (returns_receiver)
+      settings.escape(receiver->text_);
+    else if (func != nullptr)
+      settings.call(receiver->text_, func->ident_);
+  }
+
+  void BinOp::find_escapes(Escape::Settings &settings) const {
+    // The right operand of a not is empty
+    left_->find_escapes(settings);
+    if (right_)
+      right_->find_escapes(settings);
+  }
+
+  void UniOp::find_escapes(Escape::Settings &settings) const {
+    right_->find_escapes(settings);
+  }
+
+  void Assn::find_escapes(Escape::Settings &settings) const {
+    auto * var = dynamic_cast<Ident*>(lhs_->expr_);
+    if (var == nullptr) {
+      // The left side is a field.  Only its receiver is evaluated.
+      auto * field = dynamic_cast<ObjectCall*>(lhs_->expr_);
+      if (dynamic_cast<Ident*>(field->object_) == nullptr)
+        field->object_->find_escapes(settings);
+      rhs_->find_escapes(settings);
+      settings.fields_.stores_.emplace_back(field_key(field), constructed_class(rhs_));
+      return;
+    }
+
+    Quack::Class * q_class = constructed_class(rhs_);
+    rhs_->find_escapes(settings);
+    settings.assign(var->text_, q_class);
+  }
+
+  void Typecase::find_escapes(Escape::Settings &settings) const {
+    expr_->find_escapes(settings);
+    for (auto * alt : *alts_) {
+      settings.assign(alt->type_names_[0], nullptr);
+      alt->block_->find_escapes(settings);
+    }
+  }
+}
+
+namespace Escape {
+
+  void Settings::assign(const std::string &name, Quack::Class * q_class) {
+    // Reusing the stack struct is only safe if each execution replaces the previous object
+    if (++num_assignments_[name] > 1 || q_class == nullptr) {
+      escape(name);
+      return;
+    }
+    classes_[name] = q_class;
+    // The constructor runs on the object like any method called on it
+    call(name, METHOD_CONSTRUCTOR);
+  }
+
+  void Settings::finish() {
+    for (const auto &call : calls_) {
+      auto itr = classes_.find(call.first);
+      if (itr == classes_.end() || call_escapes(itr->second, call.second))
+        escape(call.first);
+    }
+  }
+
+  bool Settings::call_escapes(Quack::Class * q_class, const std::string &method_name) const {
+    if (method_name == METHOD_CONSTRUCTOR)
+      return this_escapes_.count(MethodKey(q_class, method_name)) != 0;
+
+    Quack::Method * method = q_class->get_method(method_name);
+    if (method == nullptr)
+      return true;
+    if (method->obj_class_->is_user_class())
+      return this_escapes_.count(MethodKey(q_class, method_name)) != 0;
+    // Of the builtin methods, only PRINT calls back into the user's code.  Uses of the
+    // receiver it returns are handled where the call is found.
+    return method_name == METHOD_PRINT && call_escapes(q_class, METHOD_STR);
+  }
+
+  Quack::Class * Settings::stack_class(const std::string &name) const {
+    if (escaped_.count(name) != 0)
+      return nullptr;
+    auto itr = classes_.find(name);
+    return itr == classes_.end() ? nullptr : itr->second;
+  }
+}
+
+namespace Quack {
+
+  void EscapeAnalysis::summarize_methods() {
+    std::vector<std::pair<Escape::MethodKey, Method*>> bodies;
+    for (auto &class_pair : *Class::Container::singleton()) {
+      Class * q_class = class_pair.second;
+      if (!q_class->is_user_class())
+        continue;
+
+      bodies.emplace_back(Escape::MethodKey(q_class, METHOD_CONSTRUCTOR), q_class->constructor_);
+      for (const auto &method_info : *Class::build_generated_methods(q_class))
+        if (method_info.first->is_user_class())
+          bodies.emplace_back(Escape::MethodKey(q_class, method_info.second->name_),
+                              method_info.second);
+    }
+
+    bool changed;
+    do {
+      changed = false;
+      for (const auto &body : bodies) {
+        if (this_escapes_.count(body.first) != 0)
+          continue;
+
+        Escape::Settings settings(this_escapes_);
+        settings.set_class(OBJECT_SELF, body.first.first);
+        body.second->block_->find_escapes(settings);
+        settings.finish();
+        if (settings.stack_class(OBJECT_SELF) == nullptr) {
+          this_escapes_.emplace(body.first);
+          changed = true;
+        }
+      }
+    } while (changed);
+  }
+
+  Escape::FieldUses EscapeAnalysis::find_field_uses(Method * method) const {
+    Escape::Settings settings(this_escapes_);
+    method->block_->find_escapes(settings);
+    return settings.fields_;
+  }
+  bool EscapeAnalysis::has_top_level_store(Method * constructor, const std::string &name) {
+    for (auto * stmt : constructor->block_->stmts()) {
+      auto * assn = dynamic_cast<AST::Assn*>(stmt);
+      auto * field = assn ? dynamic_cast<AST::ObjectCall*>(assn->lhs_->expr_) : nullptr;
+      if (field == nullptr)
+        continue;
+      auto * obj = dynamic_cast<AST::Ident*>(field->object_);
+      auto * field_name = dynamic_cast<AST::Ident*>(field->next_);
+      if (obj != nullptr && obj->text_ == OBJECT_SELF && field_name->text_ == name)
+        return true;
+    }
+    return false;
+  }
+  bool EscapeAnalysis::embeds(Class * q_class, Class * owner,
+                              const std::map<Escape::FieldKey, Class*> &inlined,
+                              std::set<Class*> &visited) {
+    if (q_class->is_subtype(owner))
+      return true;
+    if (!visited.emplace(q_class).second)
+      return false;
+    for (const auto &field_info : *Class::build_generated_fields(q_class)) {
+      const std::string &name = field_info.second->name_;
+      auto itr = inlined.find(Escape::FieldKey(q_class->field_owner(name), name));
+      if (itr != inlined.end() && embeds(itr->second, owner, inlined, visited))
+        return true;
+    }
+    return false;
+  }
+
+  void EscapeAnalysis::inline_fields(Program * prog) {
+    // Field uses of all code and the classes each constructor assigns to each field
+    std::set<Escape::FieldKey> escaped, method_stores;
+    std::vector<std::pair<Escape::FieldKey, std::string>> calls;
+    std::map<std::pair<Class*, Escape::FieldKey>, std::vector<Class*>> constructor_stores;
+    std::vector<Class*> user_classes;
+    for (auto &class_pair : *Class::Container::singleton())
+      if (class_pair.second->is_user_class())
+        user_classes.emplace_back(class_pair.second);
+
+    std::vector<std::pair<Method*, Class*>> bodies = {{prog->main_, nullptr}};
+    for (auto * q_class : user_classes) {
+      bodies.emplace_back(q_class->constructor_, q_class);
+      for (auto &method_pair : *q_class->methods_)
+        bodies.emplace_back(method_pair.second, nullptr);
+    }
+    for (const auto &body : bodies) {
+      Escape::FieldUses uses = find_field_uses(body.first);
+      escaped.insert(uses.escaped_.begin(), uses.escaped_.end());
+      calls.insert(calls.end(), uses.calls_.begin(), uses.calls_.end());
+      for (const auto &store : uses.stores_) {
+        if (body.second == nullptr)
+          method_stores.emplace(store.first);
+        else
+          constructor_stores[std::make_pair(body.second, store.first)].emplace_back(store.second);
+      }
+    }
+
+    Escape::Settings summaries(this_escapes_);
+    std::map<Escape::FieldKey, Class*> inlined;
+    for (auto * owner : user_classes) {
+      for (auto &field_pair : *owner->fields_) {
+        Escape::FieldKey key(owner, field_pair.first);
+        if (owner->field_owner(key.second) != owner || escaped.count(key) != 0
+            || method_stores.count(key) != 0)
+          continue;
+
+        // Subclasses reassign every inherited field, so all must construct the same class
+        Class * inline_class = nullptr;
+        bool is_inlinable = true;
+        for (auto * q_class : user_classes) {
+          if (!q_class->is_subtype(owner))
+            continue;
+          const auto &stores = constructor_stores[std::make_pair(q_class, key)];
+          is_inlinable = is_inlinable && stores.size() == 1 && stores[0] != nullptr
+                         && (inline_class == nullptr || stores[0] == inline_class)
+                         && has_top_level_store(q_class->constructor_, key.second);
+          if (is_inlinable)
+            inline_class = stores[0];
+        }
+        if (!is_inlinable || summaries.call_escapes(inline_class, METHOD_CONSTRUCTOR))
+          continue;
+        for (const auto &call : calls)
+          if (call.first == key && summaries.call_escapes(inline_class, call.second))
+            is_inlinable = false;
+        if (is_inlinable)
+          inlined.emplace(key, inline_class);
+      }
+    }
+
+    // Objects cannot contain themselves.  Any field remaining has no cycle through it even
+    // with the fields removed before it.
+    for (auto itr = inlined.begin(); itr != inlined.end(); ) {
+      std::set<Class*> visited;
+      if (embeds(itr->second, itr->first.first, inlined, visited))
+        itr = inlined.erase(itr);
+      else
+        ++itr;
+    }
+
+    for (const auto &field : inlined) {
+      field.first.first->fields_->get(field.first.second)->inline_class_ = field.second;
+      field.second->has_stack_constructor_ = true;
+    }
+  }
+
+  void EscapeAnalysis::analyze_method(Method * method) {
+    Escape::Settings settings(this_escapes_);
+    method->block_->find_escapes(settings);
+    settings.finish();
+
+    for (const auto &symbol_info : *method->symbol_table_) {
+      Symbol * sym = symbol_info.second;
+      if (sym->is_field_ || method->params_->get(sym->name_) || sym->name_ == OBJECT_SELF)
+        continue;
+
+      sym->stack_class_ = settings.stack_class(sym->name_);
+      if (sym->stack_class_ != nullptr)
+        sym->stack_class_->has_stack_constructor_ = true;
+    }
+  }
+}
@@ -0,0 +1,202 @@
+//
+// Intraprocedural escape analysis that finds objects which can live on the C stack.
+//
+
+#ifndef TYPE_CHECKER_ESCAPE_ANALYSIS_H
+#define TYPE_CHECKER_ESCAPE_ANALYSIS_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "quack_program.h"
+#include "quack_class.h"
+#include "ASTNode.h"
+
+namespace Escape {
+  /** Class of the receiver and name of a method (METHOD_CONSTRUCTOR for the constructor) */
+  typedef std::pair<Quack::Class*, std::string> MethodKey;
+  /** Class that first declares a field and the field's name */
+  typedef std::pair<Quack::Class*, std::string> FieldKey;
+
+  /** How a method uses the objects referenced by fields */
+  struct FieldUses {
+    /** Fields whose value is used other than as the receiver of a method call */
+    std::set<FieldKey> escaped_;
+    /** Field and method of each call on a field's object */
+    std::vector<std::pair<FieldKey, std::string>> calls_;
+    /** Field and class constructed by each assignment to a field.  nullptr for any other value */
+    std::vector<std::pair<FieldKey, Quack::Class*>> stores_;
+  };
+
+  struct Settings {
+    /**
+     * @param this_escapes Methods whose receiver may escape when it is exactly the given class
+     */
+    explicit Settings(const std::set<MethodKey> &this_escapes) : this_escapes_(this_escapes) {}
+    /**
+     * Records a use of a variable that may copy its reference somewhere else, e.g., as an
+     * argument, a return value, or the right side of an assignment.
+     *
+     * @param name Variable name
+     */
+    void escape(const std::string &name) { escaped_.emplace(name); }
+    /**
+     * Records a method call on a variable.  Whether the receiver escapes is only known once the
+     * variable's class is (see finish).
+     *
+     * @param name Variable name
+     * @param method_name Method called
+     */
+    void call(const std::string &name, const std::string &method_name) {
+      calls_.emplace_back(name, method_name);
+    }
+    /**
+     * Records an assignment to a local variable.
+     *
+     * @param name Variable name
+     * @param q_class Class constructed by the right side.  nullptr for any other expression.
+     */
+    void assign(const std::string &name, Quack::Class * q_class);
+    /**
+     * Sets the exact class of a variable that is never assigned (i.e., this).
+     *
+     * @param name Variable name
+     * @param q_class Class of every object the variable refers to
+     */
+    void set_class(const std::string &name, Quack::Class * q_class) {
+      classes_[name] = q_class;
+    }
+    /**
+     * Marks every variable whose method calls may leak the receiver as escaped.  Must be called
+     * once the whole method has been analyzed.
+     */
+    void finish();
+    /**
+     * Checks whether calling a method may leak its receiver.
+     *
+     * @param q_class Exact class of the receiver
+     * @param method_name Method called
+     * @return True if the receiver may escape
+     */
+    bool call_escapes(Quack::Class * q_class, const std::string &method_name) const;
+    /**
+     * Class of the only object a variable can refer to, provided that object never escapes.
+     *
+     * @param name Variable name
+     * @return Exact class or nullptr if the variable's objects may escape
+     */
+    Quack::Class * stack_class(const std::string &name) const;
+
+    /** Uses of the fields of any object in the method */
+    FieldUses fields_;
+    /** Whether the expression about to be analyzed is a statement whose value is unused */
+    bool discards_value_ = false;
+
+   private:
+    const std::set<MethodKey> &this_escapes_;
+    /** Variables whose objects may escape */
+    std::set<std::string> escaped_;
+    /** Exact class of the variables assigned only by a constructor call */
+    std::map<std::string, Quack::Class*> classes_;
+    /** Number of assignments to each variable */
+    std::map<std::string, unsigned> num_assignments_;
+    /** Receiver variable and method of each call */
+    std::vector<std::pair<std::string, std::string>> calls_;
+  };
+}
+
+namespace Quack {
+  /**
+   * Finds the locals that are assigned exactly once, from a constructor call, and whose object
+   * never leaves the method.  Such an object is only reachable through the local while the
+   * method runs, so code generation places it in a struct on the C stack and initializes it
+   * with a variant of the constructor rather than allocating it.
+   *
+   * An object escapes if its reference is used as a value anywhere (e.g., passed, returned, or
+   * assigned).  Reading and writing its fields does not count, nor does calling a method
+   * whose body never lets this escape.  Since the class of such an object is exact, each call
+   * resolves to one implementation, so the summaries below are per class and method.
+   *
+   * The same summaries show when the object of a field can be embedded in the object holding
+   * it (see inline_fields).
+   */
+  class EscapeAnalysis {
+   public:
+    EscapeAnalysis() = default;
+
+    void run(Program * prog) {
+      summarize_methods();
+      inline_fields(prog);
+
+      for (auto &class_pair : *Class::Container::singleton()) {
+        Class * q_class = class_pair.second;
+        if (!q_class->is_user_class())
+          continue;
+
+        analyze_method(q_class->constructor_);
+        for (auto &method_pair : *q_class->methods_)
+          analyze_method(method_pair.second);
+      }
+      analyze_method(prog->main_);
+    }
+
+   private:
+    /**
+     * Finds every method that may leak its receiver.  All receivers start out as not escaping
+     * and methods are reanalyzed until nothing changes, which handles recursive calls.
+     */
+    void summarize_methods();
+    /**
+     * Finds the fields whose object can be embedded in the struct of the objects holding them.
+     * Every class with such a field assigns it exactly once, at the top level of its
+     * constructor, with a new object of the same class.  Nothing else ever assigns the field,
+     * and its object is only used as the receiver of methods that never let this escape.  The
+     * object then lives exactly as long as the one holding it.
+     *
+     * @param prog Program whose main is also checked for uses of the fields
+     */
+    void inline_fields(Program * prog);
+    /**
+     * Finds how a method uses the objects of fields.
+     *
+     * @param method Method, constructor, or main
+     * @return Field uses of the method
+     */
+    Escape::FieldUses find_field_uses(Method * method) const;
+    /**
+     * Checks whether a constructor assigns a field of this in one of its top level statements.
+     *
+     * @param constructor Constructor to check
+     * @param name Field name
+     * @return True if the field is assigned on every path through the constructor
+     */
+    static bool has_top_level_store(Method * constructor, const std::string &name);
+    /**
+     * Checks whether the objects of a class contain, possibly through several levels of
+     * embedding, an object of a class or one of its subclasses.
+     *
+     * @param q_class Class of the containing objects
+     * @param owner Class whose objects are looked for
+     * @param inlined Class embedded for each inlined field
+     * @param visited Classes already checked
+     * @return True if embedding owner's objects in q_class would make it infinitely large
+     */
+    static bool embeds(Class * q_class, Class * owner,
+                       const std::map<Escape::FieldKey, Class*> &inlined,
+                       std::set<Class*> &visited);
+    /**
+     * Marks the locals of a method whose object can be stack allocated.
+     *
+     * @param method Method, constructor, or main to analyze
+     */
+    void analyze_method(Method * method);
+
+    /** Methods whose receiver may escape when it is exactly the given class */
+    std::set<Escape::MethodKey> this_escapes_;
+  };
+}
+
+#endif //TYPE_CHECKER_ESCAPE_ANALYSIS_H
@@ -0,0 +1,144 @@
+//
+// Typed SSA intermediate representation of a Quack method.
+//
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "ir.h"
+#include "quack_class.h"
+
+namespace IR {
+
+  const char * op_name(Op op) {
+    switch (op) {
+      case Op::ConstInt: return "const_int";
+      case Op::ConstBool: return "const_bool";
+      case Op::ConstStr: return "const_str";
+      case Op::ConstNone: return "const_none";
+      case Op::Undef: return "undef";
+      case Op::Param: return "param";
+      case Op::Add: return "add";
+      case Op::Sub: return "sub";
+      case Op::Mul: return "mul";
+      case Op::Div: return "div";
+      case Op::Lt: return "lt";
+      case Op::Le: return "le";
+      case Op::Gt: return "gt";
+      case Op::Ge: return "ge";
+      case Op::Eq: return "eq";
+      case Op::Neg: return "neg";
+      case Op::Not: return "not";
+      case Op::Box: return "box";
+      case Op::Unbox: return "unbox";
+      case Op::Alloc: return "alloc";
+      case Op::New: return "new";
+      case Op::Call: return "call";
+      case Op::LoadField: return "load";
+      case Op::StoreField: return "store";
+      case Op::Phi: return "phi";
+      case Op::Jump: return "jump";
+      case Op::Branch: return "branch";
+      case Op::Switch: return "switch";
+      case Op::Return: return "return";
+    }
+    return "unknown";
+  }
+
+  /**
+   * Writes a single instruction, e.g. "%3 : Int = add %1, %2".
+   *
+   * @param out Stream to write to
+   * @param instr Instruction to write
+   */
+  static void print_instr(std::ostream &out, const Instr * instr) {
+    out << "\t";
+    if (instr->type_ != nullptr && instr->op_ != Op::StoreField && !instr->is_terminator())
+      out << "%" << instr->id_ << " : " << (instr->is_native_ ? "native " : "")
+          << instr->type_->name_ << " = ";
+    out << op_name(instr->op_);
+
+    if (instr->op_ == Op::ConstInt || instr->op_ == Op::ConstBool)
+      out << " " << instr->imm_;
+    if (!instr->text_.empty())
+      out << " " << (instr->op_ == Op::ConstStr ? "\"" + instr->text_ + "\"" : instr->text_);
+    if (instr->op_ == Op::Call && instr->impl_class_ != nullptr)
+      out << " [" << instr->impl_class_->name_ << "]";
+    if (instr->op_ == Op::New || instr->op_ == Op::Alloc)
+      out << " " << instr->class_->name_;
+
+    bool is_first = true;
+    for (auto * arg : instr->args_) {
+      out << (is_first ? " " : ", ") << "%" << arg->id_;
+      is_first = false;
+    }
+    for (unsigned i = 0; i < instr->targets_.size(); i++) {
+      out << (i == 0 && instr->args_.empty() ? " " : ", ");
+      if (i < instr->ranges_.size())
+        out << instr->ranges_[i].first << "..." << instr->ranges_[i].second << ": ";
+      out << "bb" << instr->targets_[i]->id_;
+    }
+    out << "\n";
+  }
+
+  std::map<const BasicBlock*, BasicBlock*> Function::immediate_dominators() const {
+    std::vector<BasicBlock*> order = reverse_post_order();
+    std::map<const BasicBlock*, unsigned> index;
+    for (unsigned i = 0; i < order.size(); i++)
+      index[order[i]] = i;
+
+    std::map<const BasicBlock*, BasicBlock*> idoms{{entry_, entry_}};
+    auto intersect = [&idoms, &index](BasicBlock * a, BasicBlock * b) {
+      while (a != b) {
+        while (index[a] > index[b])
+          a = idoms[a];
+        while (index[b] > index[a])
+          b = idoms[b];
+      }
+      return a;
+    };
+
+    bool changed;
+    do {
+      changed = false;
+      for (auto * block : order) {
+        if (block == entry_)
+          continue;
+        BasicBlock * idom = nullptr;
+        for (auto * pred : block->preds_) {
+          // Skip predecessors not yet processed
+          auto itr = idoms.find(pred);
+          if (itr == idoms.end() || itr->second == nullptr)
+            continue;
+          idom = idom == nullptr ? pred : intersect(pred, idom);
+        }
+        auto itr = idoms.find(block);
+        if (itr == idoms.end() || itr->second != idom) {
+          idoms[block] = idom;
+          changed = true;
+        }
+      }
+    } while (changed);
+    return idoms;
+  }
+
+  void Function::print(std::ostream &out) const {
+    out << "function " << (this_class_ ? this_class_->name_ + "." : "")
+        << (is_constructor_ ? METHOD_CONSTRUCTOR : method_->name_) << "\n";
+    for (auto * block : blocks_) {
+      out << "bb" << block->id_ << ":";
+      if (!block->preds_.empty()) {
+        out << "\t\t; preds";
+        for (auto * pred : block->preds_)
+          out << " bb" << pred->id_;
+      }
+      out << "\n";
+      for (auto * phi : block->phis_)
+        print_instr(out, phi);
+      for (auto * instr : block->instrs_)
+        print_instr(out, instr);
+    }
+    out << std::endl;
+  }
+}
@@ -0,0 +1,363 @@
+//
+// Typed SSA intermediate representation of a Quack method.
+//
+
+#ifndef TYPE_CHECKER_IR_H
+#define TYPE_CHECKER_IR_H
+
+#include <map>
+#include <set>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <ostream>
+#include <algorithm>
+
+// Forward Declaration
+namespace Quack { class Class; class Method; }
+
+namespace IR {
+  /** Operation performed by an instruction */
+  enum class Op {
+    // Values materialized inline wherever they are used
+    ConstInt,         ///< Native int in imm_
+    ConstBool,        ///< Native bool in imm_
+    ConstStr,         ///< String literal object with text text_
+    ConstNone,        ///< The Nothing object
+    Undef,            ///< Variable read before any assignment on some path
+    Param,            ///< Parameter (or this) named text_
+
+    // Native Int and Boolean operations
+    Add, Sub, Mul, Div,
+    Lt, Le, Gt, Ge, Eq,
+    Neg, Not,
+    Box,              ///< Wraps a native value into an Int or Boolean object
+    Unbox,            ///< Extracts the native value of an Int or Boolean object
+
+    // Objects
+    Alloc,            ///< Allocates this at the start of the constructor of class_
+    New,              ///< Calls the constructor of class_
+    Call,             ///< Calls method_ on args_[0]; direct to impl_class_ if not null
+    LoadField,        ///< Reads field text_ of args_[0] whose static type is class_
+    StoreField,       ///< Writes args_[1] to field text_ of args_[0] whose static type is class_
+    Phi,              ///< One argument per predecessor of the block
+
+    // Terminators
+    Jump,             ///< Unconditionally go to targets_[0]
+    Branch,           ///< Go to targets_[0] if args_[0] else targets_[1]
+    Switch,           ///< Go to targets_[i] if args_[0]'s class ID is in ranges_[i] else last target
+    Return            ///< Return args_[0]
+  };
+
+  struct BasicBlock;
+
+  /**
+   * Single SSA instruction.  Instructions that produce a value are the value itself, so
+   * operands point directly at their defining instruction.
+   */
+  struct Instr {
+    Instr(unsigned id, Op op, Quack::Class * type, bool is_native)
+        : id_(id), op_(op), type_(type), is_native_(is_native) {}
+    /** Unique ID of the instruction within its function */
+    const unsigned id_;
+    /** Operation performed by the instruction */
+    Op op_;
+    /** Static type of the value.  For StoreField, the declared type of the field. */
+    Quack::Class * type_;
+    /** True if the value is a native int or bool rather than an object */
+    bool is_native_;
+    /** Operands */
+    std::vector<Instr*> args_;
+    /** Block that contains the instruction */
+    BasicBlock * block_ = nullptr;
+    /** Int or Boolean constant */
+    long imm_ = 0;
+    /** String literal, parameter, field, or method name */
+    std::string text_;
+    /** Class operated on (see Op) */
+    Quack::Class * class_ = nullptr;
+    /** Method called */
+    Quack::Method * method_ = nullptr;
+    /** Class defining the only reachable implementation of method_.  Null if dispatched. */
+    Quack::Class * impl_class_ = nullptr;
+    /** Successor blocks of a terminator */
+    std::vector<BasicBlock*> targets_;
+    /** Inclusive class ID range of each Switch target other than the default */
+    std::vector<std::pair<unsigned, unsigned>> ranges_;
+    /** Set once the instruction is no longer part of the function */
+    bool is_removed_ = false;
+
+    bool is_terminator() const {
+      return op_ == Op::Jump || op_ == Op::Branch || op_ == Op::Switch || op_ == Op::Return;
+    }
+    /**
+     * Checks whether the instruction is a constant, parameter, or undefined value.  These
+     * have no code of their own and are always available.
+     *
+     * @return True if the instruction is materialized at each use
+     */
+    bool is_inline() const {
+      return op_ == Op::ConstInt || op_ == Op::ConstBool || op_ == Op::ConstStr
+             || op_ == Op::ConstNone || op_ == Op::Undef || op_ == Op::Param;
+    }
+    /**
+     * Checks whether the instruction must be kept even if its value is unused.  Division is
+     * kept since dividing by zero traps.
+     *
+     * @return True if the instruction has an effect other than producing its value
+     */
+    bool has_side_effects() const {
+      return is_terminator() || op_ == Op::Alloc || op_ == Op::New || op_ == Op::Call
+             || op_ == Op::StoreField || op_ == Op::Div;
+    }
+  };
+
+  /** Maximal straight line sequence of instructions ending in a terminator */
+  struct BasicBlock {
+    explicit BasicBlock(unsigned id) : id_(id) {}
+    /** Unique ID of the block within its function */
+    const unsigned id_;
+    /** Phi instructions evaluated on entry to the block */
+    std::vector<Instr*> phis_;
+    /** Non-phi instructions.  Once the block is complete, the last one is the terminator. */
+    std::vector<Instr*> instrs_;
+    /** Predecessor blocks.  The order matches the phi arguments. */
+    std::vector<BasicBlock*> preds_;
+    /**
+     * Accessor for the block's terminator.
+     *
+     * @return Terminator instruction or nullptr if the block is not yet terminated
+     */
+    Instr * terminator() const {
+      if (instrs_.empty() || !instrs_.back()->is_terminator())
+        return nullptr;
+      return instrs_.back();
+    }
+    /**
+     * Accessor for the successor blocks.
+     *
+     * @return Successors in terminator order.  A block may appear more than once.
+     */
+    std::vector<BasicBlock*> succs() const {
+      Instr * term = terminator();
+      return term == nullptr ? std::vector<BasicBlock*>() : term->targets_;
+    }
+    /**
+     * Index of the specified predecessor.  Used to select the corresponding phi argument.
+     *
+     * @param pred Predecessor block
+     * @return Index of pred in preds_
+     */
+    unsigned pred_index(const BasicBlock * pred) const {
+      auto itr = std::find(preds_.begin(), preds_.end(), pred);
+      return static_cast<unsigned>(itr - preds_.begin());
+    }
+  };
+
+  /** Control-flow graph in SSA form for a method, constructor, or main */
+  class Function {
+   public:
+    Function(Quack::Method * method, Quack::Class * this_class, bool is_constructor,
+             Quack::Class * return_type)
+        : method_(method), this_class_(this_class), is_constructor_(is_constructor),
+          return_type_(return_type) {
+      entry_ = new_block();
+    }
+    /**
+     * Creates a new empty block in the function.
+     *
+     * @return New block
+     */
+    BasicBlock * new_block() {
+      blocks_.emplace_back(new BasicBlock(next_block_id_++));
+      owned_blocks_.emplace_back(blocks_.back());
+      return blocks_.back();
+    }
+    /**
+     * Creates a new instruction owned by the function.  The instruction is not yet placed in
+     * any block.
+     *
+     * @param op Operation
+     * @param type Static type of the result
+     * @param is_native True if the result is a native int or bool
+     * @return New instruction
+     */
+    Instr * new_instr(Op op, Quack::Class * type, bool is_native) {
+      owned_instrs_.emplace_back(new Instr(next_instr_id_++, op, type, is_native));
+      return owned_instrs_.back().get();
+    }
+    /**
+     * Replaces every use of one value with another.
+     *
+     * @param from Value being replaced
+     * @param to Replacement value
+     */
+    void replace_all_uses(Instr * from, Instr * to) {
+      for (auto * block : blocks_) {
+        for (auto * phi : block->phis_)
+          std::replace(phi->args_.begin(), phi->args_.end(), from, to);
+        for (auto * instr : block->instrs_)
+          std::replace(instr->args_.begin(), instr->args_.end(), from, to);
+      }
+    }
+    /**
+     * Counts the uses of each value in the function.
+     *
+     * @return Number of operands referencing each instruction
+     */
+    std::map<const Instr*, unsigned> count_uses() const {
+      std::map<const Instr*, unsigned> uses;
+      for (auto * block : blocks_) {
+        for (auto * phi : block->phis_)
+          for (auto * arg : phi->args_)
+            uses[arg]++;
+        for (auto * instr : block->instrs_)
+          for (auto * arg : instr->args_)
+            uses[arg]++;
+      }
+      return uses;
+    }
+    /**
+     * Orders the reachable blocks such that each block appears before its successors except
+     * along loop back edges.
+     *
+     * @return Reachable blocks in reverse postorder starting with the entry
+     */
+    std::vector<BasicBlock*> reverse_post_order() const {
+      std::vector<BasicBlock*> order;
+      std::set<BasicBlock*> visited;
+      // Explicit stack of (block, next successor index) to handle deep nesting
+      std::vector<std::pair<BasicBlock*, unsigned>> stack;
+      stack.emplace_back(entry_, 0);
+      visited.insert(entry_);
+      while (!stack.empty()) {
+        BasicBlock * block = stack.back().first;
+        std::vector<BasicBlock*> succs = block->succs();
+        if (stack.back().second < succs.size()) {
+          BasicBlock * succ = succs[stack.back().second++];
+          if (visited.insert(succ).second)
+            stack.emplace_back(succ, 0);
+          continue;
+        }
+        order.emplace_back(block);
+        stack.pop_back();
+      }
+      std::reverse(order.begin(), order.end());
+      return order;
+    }
+    /**
+     * Computes the dominator tree using the algorithm of Cooper et al., "A Simple, Fast
+     * Dominance Algorithm."
+     *
+     * @return Immediate dominator of each reachable block.  The entry is its own dominator.
+     */
+    std::map<const BasicBlock*, BasicBlock*> immediate_dominators() const;
+    /**
+     * Checks whether every path from the entry to a block passes through another block.
+     *
+     * @param idoms Immediate dominators from immediate_dominators()
+     * @param dominator Block that may dominate
+     * @param block Reachable block
+     * @return True if dominator dominates block.  A block dominates itself.
+     */
+    static bool dominates(const std::map<const BasicBlock*, BasicBlock*> &idoms,
+                          const BasicBlock * dominator, const BasicBlock * block) {
+      while (block != dominator) {
+        const BasicBlock * idom = idoms.at(block);
+        if (idom == block)
+          return false;
+        block = idom;
+      }
+      return true;
+    }
+    /**
+     * Deletes all blocks not reachable from the entry.  Edges from deleted blocks are removed
+     * from the predecessor lists and phis of the remaining blocks.
+     */
+    void remove_unreachable_blocks() {
+      std::vector<BasicBlock*> reachable = reverse_post_order();
+      std::set<BasicBlock*> live(reachable.begin(), reachable.end());
+
+      for (auto * block : reachable) {
+        for (unsigned i = static_cast<unsigned>(block->preds_.size()); i-- > 0; ) {
+          if (live.count(block->preds_[i]) != 0)
+            continue;
+          block->preds_.erase(block->preds_.begin() + i);
+          for (auto * phi : block->phis_)
+            phi->args_.erase(phi->args_.begin() + i);
+        }
+      }
+      for (auto * block : blocks_) {
+        if (live.count(block) != 0)
+          continue;
+        for (auto * phi : block->phis_)
+          phi->is_removed_ = true;
+        for (auto * instr : block->instrs_)
+          instr->is_removed_ = true;
+      }
+      blocks_ = reachable;
+    }
+    /**
+     * Deletes instructions whose values are never used and that have no side effects.
+     */
+    void remove_dead_instrs() {
+      bool changed;
+      do {
+        changed = false;
+        std::map<const Instr*, unsigned> uses = count_uses();
+        auto is_dead = [&uses](Instr * instr) {
+          if (instr->has_side_effects() || instr->op_ == Op::Param || uses[instr] != 0)
+            return false;
+          instr->is_removed_ = true;
+          return true;
+        };
+        for (auto * block : blocks_) {
+          auto &phis = block->phis_;
+          auto &instrs = block->instrs_;
+          unsigned long size = phis.size() + instrs.size();
+          phis.erase(std::remove_if(phis.begin(), phis.end(), is_dead), phis.end());
+          instrs.erase(std::remove_if(instrs.begin(), instrs.end(), is_dead), instrs.end());
+          changed = changed || size != phis.size() + instrs.size();
+        }
+      } while (changed);
+    }
+    /**
+     * Writes a human readable listing of the function.  Used for debugging the compiler.
+     *
+     * @param out Stream to write to
+     */
+    void print(std::ostream &out) const;
+
+    /** Method compiled into the function.  For main, the method wrapping the main block. */
+    Quack::Method * const method_;
+    /** Class of the implicit object.  Null for main. */
+    Quack::Class * const this_class_;
+    /** True if the function is the constructor of this_class_ */
+    const bool is_constructor_;
+    /** Declared return type of the function */
+    Quack::Class * const return_type_;
+    /** Parameter instructions in declaration order.  The implicit object is first if any. */
+    std::vector<Instr*> params_;
+    /** First block executed */
+    BasicBlock * entry_;
+    /** Blocks in the function.  After cleanup, only reachable blocks in reverse postorder. */
+    std::vector<BasicBlock*> blocks_;
+
+   private:
+    std::vector<std::unique_ptr<BasicBlock>> owned_blocks_;
+    std::vector<std::unique_ptr<Instr>> owned_instrs_;
+    unsigned next_block_id_ = 0;
+    unsigned next_instr_id_ = 0;
+  };
+
+  /**
+   * Human readable name of an operation.
+   *
+   * @param op Operation
+   * @return Operation name
+   */
+  const char * op_name(Op op);
+}
+
+#endif //TYPE_CHECKER_IR_H
@@ -0,0 +1,416 @@
+//
+// Generation of x86-64 assembly from the SSA intermediate representation.
+//
+
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ir_asm_emitter.h"
+#include "ir_builder.h"
+#include "ir_optimizer.h"
+#include "asm_generator.h"
+#include "ASTNode.h"
+#include "quack_class.h"
+#include "quack_method.h"
+#include "keywords.h"
+#include "code_gen_utils.h"
+
+namespace IR {
+
+  /** Registers holding the first six integer arguments */
+  static const char * const ARG_REGS[] = {"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9"};
+  static const unsigned NUM_ARG_REGS = 6;
+  /** Size of struct quack_gc_frame */
+  static const int GC_FRAME_SIZE = 24;
+
+  void AsmEmitter::generate_function(CodeGen::Settings settings, const std::string &name,
+                                     Quack::Method * method, Quack::Class * this_class,
+                                     bool is_constructor) {
+    std::unique_ptr<Function> fn(Builder::build(method, this_class, is_constructor));
+    Optimizer::run(fn.get());
+    if (settings.print_ir_)
+      fn->print(std::cout);
+
+    AsmEmitter emitter(settings, fn.get());
+    emitter.emit(name);
+  }
+
+  AsmEmitter::AsmEmitter(CodeGen::Settings &settings, const Function * fn)
+      : settings_(settings), fn_(fn) {
+    for (auto * block : fn_->blocks_)
+      if (!block->preds_.empty())
+        labels_[block] = new_label("block");
+
+    for (auto * param : fn_->params_)
+      add_slot(Var(param, false));
+    for (auto * block : fn_->blocks_) {
+      for (auto * phi : block->phis_) {
+        add_slot(Var(phi, false));
+        add_slot(Var(phi, true));
+      }
+      for (auto * instr : block->instrs_)
+        if (!instr->is_terminator() && instr->op_ != Op::StoreField && !is_inline(instr))
+          add_slot(Var(instr, false));
+    }
+
+    // The root array sits just above the garbage collector frame
+    int slots_size = static_cast<int>(8 * slots_.size());
+    gc_frame_ = -(slots_size + 8 * static_cast<int>(roots_.size()) + GC_FRAME_SIZE);
+    frame_size_ = (-gc_frame_ + 15) / 16 * 16;
+  }
+
+  void AsmEmitter::add_slot(const Var &var) {
+    int offset = -8 * static_cast<int>(slots_.size() + 1);
+    slots_[var] = offset;
+    if (!var.first->is_native_)
+      roots_.emplace_back(offset);
+  }
+
+  bool AsmEmitter::is_inline(const Instr * instr) const {
+    if (instr->is_inline())
+      return true;
+    // Boxed literals refer to static objects
+    return instr->op_ == Op::Box
+           && (instr->args_[0]->op_ == Op::ConstBool || instr->args_[0]->op_ == Op::ConstInt);
+  }
+
+  void AsmEmitter::line(const std::string &text) {
+    settings_.fout_ << "\t" << text << "\n";
+  }
+
+  std::string AsmEmitter::new_label(const std::string &header) {
+    return ".L" + AST::ASTNode::define_new_label(header);
+  }
+
+  void AsmEmitter::emit(const std::string &name) {
+    std::ostream &out = settings_.fout_;
+    out << "\n\t.text\n\t.p2align 4\n\t.globl " << name << "\n\t.type " << name
+        << ", @function\n" << name << ":\n";
+    line("pushq %rbp");
+    line("movq %rsp, %rbp");
+    line("subq $" + std::to_string(frame_size_) + ", %rsp");
+
+    // Slots must hold valid references before the collector can see them
+    for (int offset : roots_)
+      line("movq $0, " + std::to_string(offset) + "(%rbp)");
+    const auto &params = fn_->params_;
+    for (unsigned i = 0; i < params.size(); i++) {
+      if (i < NUM_ARG_REGS) {
+        line(std::string("movq ") + ARG_REGS[i] + ", " + slot(Var(params[i], false)));
+        continue;
+      }
+      line("movq " + std::to_string(16 + 8 * (i - NUM_ARG_REGS)) + "(%rbp), %rax");
+      line("movq %rax, " + slot(Var(params[i], false)));
+    }
+
+    if (!roots_.empty()) {
+      std::string frame = std::to_string(gc_frame_);
+      out << "#ifdef QUACK_GC\n";
+      int root_array = gc_frame_ + GC_FRAME_SIZE;
+      for (int offset : roots_) {
+        line("leaq " + std::to_string(offset) + "(%rbp), %rax");
+        line("movq %rax, " + std::to_string(root_array) + "(%rbp)");
+        root_array += 8;
+      }
+      line("movq quack_gc_top@GOTTPOFF(%rip), %rcx");
+      line("movq %fs:(%rcx), %rax");
+      line("movq %rax, " + frame + "(%rbp)");
+      line("movq $" + std::to_string(roots_.size()) + ", "
+           + std::to_string(gc_frame_ + 8) + "(%rbp)");
+      line("leaq " + std::to_string(gc_frame_ + GC_FRAME_SIZE) + "(%rbp), %rax");
+      line("movq %rax, " + std::to_string(gc_frame_ + 16) + "(%rbp)");
+      line("leaq " + frame + "(%rbp), %rax");
+      line("movq %rax, %fs:(%rcx)");
+      out << "#endif\n";
+    }
+
+    const auto &blocks = fn_->blocks_;
+    for (unsigned i = 0; i < blocks.size(); i++)
+      emit_block(blocks[i], i + 1 < blocks.size() ? blocks[i + 1] : nullptr);
+    out << "\t.size " << name << ", .-" << name << "\n";
+  }
+
+  void AsmEmitter::load(const Instr * instr, const std::string &reg) {
+    switch (instr->op_) {
+      case Op::ConstInt:
+      case Op::ConstBool:
+        line("movq $" + std::to_string(instr->imm_) + ", " + reg);
+        return;
+      case Op::ConstStr:
+        line("leaq " + settings_.literal_pool_->add(instr->text_) + "(%rip), " + reg);
+        return;
+      case Op::ConstNone:
+        line("movq " GENERATED_LIT_NONE "(%rip), " + reg);
+        return;
+      case Op::Undef:
+        line("movq $0, " + reg);
+        return;
+      default:
+        break;
+    }
+
+    // Parameters are stored in their slots by the prologue
+    if (instr->op_ != Op::Param && is_inline(instr)) {
+      const Instr * lit = instr->args_[0];
+      if (lit->op_ == Op::ConstBool) {
+        line(std::string("movq ") + (lit->imm_ ? GENERATED_LIT_TRUE : GENERATED_LIT_FALSE)
+             + "(%rip), " + reg);
+        return;
+      }
+      // Same as QUACK_INT_LIT: the tagged value, or else the static object
+      long tagged = 2 * lit->imm_ + 1;
+      settings_.fout_ << "#ifndef QUACK_NO_TAGGED_INT\n";
+      line("movabsq $" + std::to_string(tagged) + ", " + reg);
+      settings_.fout_ << "#else\n";
+      line("leaq " + settings_.literal_pool_->add((int) lit->imm_) + "(%rip), " + reg);
+      settings_.fout_ << "#endif\n";
+      return;
+    }
+    line("movq " + slot(Var(instr, false)) + ", " + reg);
+  }
+
+  void AsmEmitter::load_clazz(Quack::Class * q_class, const std::string &reg) {
+    if (!q_class->may_hold_tagged_int()) {
+      line("movq (%rdi), " + reg);
+      return;
+    }
+    std::string untagged = new_label("untagged");
+    std::string done = new_label("clazz");
+    line("testb $1, %dil");
+    line("jz " + untagged);
+    line("movq the_class_Int(%rip), " + reg);
+    line("jmp " + done);
+    settings_.fout_ << untagged << ":\n";
+    line("movq (%rdi), " + reg);
+    settings_.fout_ << done << ":\n";
+  }
+
+  void AsmEmitter::emit_call(const std::vector<Instr*> &args, const std::string &callee,
+                             Quack::Class * clazz_class) {
+    // Stack arguments are padded to keep the stack 16 byte aligned at the call
+    unsigned num_stack = args.size() > NUM_ARG_REGS ? args.size() - NUM_ARG_REGS : 0;
+    unsigned stack_size = 8 * (num_stack + num_stack % 2);
+    if (stack_size != 0) {
+      line("subq $" + std::to_string(stack_size) + ", %rsp");
+      for (unsigned i = NUM_ARG_REGS; i < args.size(); i++) {
+        load(args[i], "%rax");
+        line("movq %rax, " + std::to_string(8 * (i - NUM_ARG_REGS)) + "(%rsp)");
+      }
+    }
+    for (unsigned i = 0; i < args.size() && i < NUM_ARG_REGS; i++)
+      load(args[i], ARG_REGS[i]);
+    if (clazz_class != nullptr)
+      load_clazz(clazz_class, "%r10");
+    line("call " + callee);
+    if (stack_size != 0)
+      line("addq $" + std::to_string(stack_size) + ", %rsp");
+  }
+
+  /**
+   * Condition code tested by a native comparison.
+   *
+   * @param op Comparison operation
+   * @return Suffix of the setcc instruction
+   */
+  static const char * condition_code(Op op) {
+    switch (op) {
+      case Op::Lt: return "l";
+      case Op::Le: return "le";
+      case Op::Gt: return "g";
+      case Op::Ge: return "ge";
+      case Op::Eq: return "e";
+      default: throw std::runtime_error("Not a native comparison");
+    }
+  }
+
+  void AsmEmitter::emit_instr(const Instr * instr) {
+    const auto &args = instr->args_;
+    switch (instr->op_) {
+      case Op::Add: case Op::Sub: case Op::Mul:
+        load(args[0], "%rax");
+        load(args[1], "%rcx");
+        line(instr->op_ == Op::Add ? "addl %ecx, %eax"
+             : instr->op_ == Op::Sub ? "subl %ecx, %eax" : "imull %ecx, %eax");
+        line("cltq");
+        break;
+      case Op::Div:
+        load(args[0], "%rax");
+        load(args[1], "%rcx");
+        line("cltd");
+        line("idivl %ecx");
+        line("cltq");
+        break;
+      case Op::Lt: case Op::Le: case Op::Gt: case Op::Ge: case Op::Eq:
+        load(args[0], "%rax");
+        load(args[1], "%rcx");
+        line("cmpl %ecx, %eax");
+        line(std::string("set") + condition_code(instr->op_) + " %al");
+        line("movzbl %al, %eax");
+        break;
+      case Op::Neg:
+        load(args[0], "%rax");
+        line("negl %eax");
+        line("cltq");
+        break;
+      case Op::Not:
+        load(args[0], "%rax");
+        line("xorq $1, %rax");
+        break;
+      case Op::Box:
+        if (instr->type_ == Quack::Class::Container::Int()) {
+          load(args[0], "%rdi");
+          line("call " GENERATE_LIT_INT_FUNC);
+          break;
+        }
+        load(args[0], "%rcx");
+        line("movq " GENERATED_LIT_FALSE "(%rip), %rax");
+        line("testq %rcx, %rcx");
+        line("cmovneq " GENERATED_LIT_TRUE "(%rip), %rax");
+        break;
+      case Op::Unbox: {
+        load(args[0], "%rax");
+        if (instr->type_ == Quack::Class::Container::Bool()) {
+          line("cmpq " GENERATED_LIT_TRUE "(%rip), %rax");
+          line("sete %al");
+          line("movzbl %al, %eax");
+          break;
+        }
+        // Same as QUACK_INT_VALUE
+        std::string boxed = new_label("boxed");
+        std::string done = new_label("unboxed");
+        line("testb $1, %al");
+        line("jz " + boxed);
+        line("sarq $1, %rax");
+        line("jmp " + done);
+        settings_.fout_ << boxed << ":\n";
+        line("movl 8(%rax), %eax");
+        settings_.fout_ << done << ":\n";
+        line("cltq");
+        break;
+      }
+      case Op::Alloc:
+        line("movl $" + std::to_string(CodeGen::AsmGen::object_size(instr->class_)) + ", %edi");
+        line("call " GENERATED_ALLOC_FUNC);
+        line("leaq " + instr->class_->generated_clazz_obj_struct_name() + "(%rip), %rcx");
+        line("movq %rcx, (%rax)");
+        break;
+      case Op::New:
+        emit_call(args, instr->class_->generated_constructor_name(), nullptr);
+        break;
+      case Op::Call:
+        if (instr->impl_class_ != nullptr) {
+          emit_call(args, Quack::Class::generated_method_name(instr->impl_class_, instr->method_),
+                    nullptr);
+          break;
+        }
+        emit_call(args, "*" + std::to_string(CodeGen::AsmGen::method_offset(instr->class_,
+                                                                              instr->text_))
+                        + "(%r10)", instr->class_);
+        break;
+      case Op::LoadField:
+        load(args[0], "%rax");
+        line("movq " + std::to_string(CodeGen::AsmGen::field_offset(instr->class_, instr->text_))
+             + "(%rax), %rax");
+        break;
+      case Op::StoreField:
+        load(args[0], "%rax");
+        load(args[1], "%rcx");
+        line("movq %rcx, "
+             + std::to_string(CodeGen::AsmGen::field_offset(instr->class_, instr->text_))
+             + "(%rax)");
+        return;
+      default:
+        throw std::runtime_error(std::string("No assembly for ") + op_name(instr->op_));
+    }
+    store(instr);
+  }
+
+  void AsmEmitter::emit_block(const BasicBlock * block, const BasicBlock * next) {
+    auto label = labels_.find(block);
+    if (label != labels_.end())
+      settings_.fout_ << label->second << ":\n";
+
+    for (auto * phi : block->phis_) {
+      line("movq " + slot(Var(phi, true)) + ", %rax");
+      store(phi);
+    }
+
+    for (auto * instr : block->instrs_) {
+      if (instr->is_terminator()) {
+        emit_phi_copies(block);
+        emit_terminator(instr, next);
+        continue;
+      }
+      if (!is_inline(instr))
+        emit_instr(instr);
+    }
+  }
+
+  void AsmEmitter::emit_phi_copies(const BasicBlock * block) {
+    std::set<const BasicBlock*> visited;
+    for (auto * succ : block->succs()) {
+      if (!visited.insert(succ).second)
+        continue;
+      unsigned pred_idx = succ->pred_index(block);
+      for (auto * phi : succ->phis_) {
+        load(phi->args_[pred_idx], "%rax");
+        line("movq %rax, " + slot(Var(phi, true)));
+      }
+    }
+  }
+
+  void AsmEmitter::emit_terminator(const Instr * term, const BasicBlock * next) {
+    switch (term->op_) {
+      case Op::Jump:
+        emit_jump(term->targets_[0], next);
+        break;
+      case Op::Branch:
+        load(term->args_[0], "%rax");
+        line("testq %rax, %rax");
+        if (term->targets_[0] == next) {
+          line("jz " + labels_.at(term->targets_[1]));
+          break;
+        }
+        line("jnz " + labels_.at(term->targets_[0]));
+        emit_jump(term->targets_[1], next);
+        break;
+      case Op::Switch:
+        load(term->args_[0], "%rdi");
+        load_clazz(term->class_, "%rcx");
+        line("movl " + std::to_string(CodeGen::AsmGen::CLASS_ID_OFFSET) + "(%rcx), %eax");
+        for (unsigned i = 0; i < term->ranges_.size(); i++) {
+          // Unsigned compare against the width of the range checks both ends at once
+          const auto &range = term->ranges_[i];
+          line("movl %eax, %edx");
+          line("subl $" + std::to_string(range.first) + ", %edx");
+          line("cmpl $" + std::to_string(range.second - range.first) + ", %edx");
+          line("jbe " + labels_.at(term->targets_[i]));
+        }
+        emit_jump(term->targets_.back(), next);
+        break;
+      case Op::Return:
+        load(term->args_[0], "%rax");
+        if (!roots_.empty()) {
+          settings_.fout_ << "#ifdef QUACK_GC\n";
+          line("movq " + std::to_string(gc_frame_) + "(%rbp), %rcx");
+          line("movq quack_gc_top@GOTTPOFF(%rip), %rdx");
+          line("movq %rcx, %fs:(%rdx)");
+          settings_.fout_ << "#endif\n";
+        }
+        line("leave");
+        line("ret");
+        break;
+      default:
+        throw std::runtime_error("Unknown terminator");
+    }
+  }
+
+  void AsmEmitter::emit_jump(const BasicBlock * target, const BasicBlock * next) {
+    if (target != next)
+      line("jmp " + labels_.at(target));
+  }
+}
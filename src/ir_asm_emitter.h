@@ -0,0 +1,164 @@
+//
+// Generation of x86-64 assembly from the SSA intermediate representation.
+//
+
+#ifndef TYPE_CHECKER_IR_ASM_EMITTER_H
+#define TYPE_CHECKER_IR_ASM_EMITTER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ir.h"
+
+// Forward Declaration
+namespace Quack { class Class; class Method; }
+namespace CodeGen { struct Settings; }
+
+namespace IR {
+  /**
+   * Writes a single function as x86-64 System V assembly (AT&T syntax).  Every SSA value
+   * that is not a constant is kept in its own 8 byte slot of the stack frame; each
+   * instruction loads its operands into scratch registers, computes its result, and stores
+   * it back.  Native Int and Boolean values are kept sign extended in their slots and
+   * computed with 32 bit instructions so they wrap exactly like the C int they stand for.
+   * Phis use the same incoming slot scheme as the CEmitter.
+   *
+   * The output is meant to be run through the C preprocessor (i.e., a ".S" file).  Under
+   * QUACK_GC, the function pushes a shadow stack frame holding the address of every object
+   * slot, exactly as the QUACK_GC_FRAME macro does for the generated C.
+   */
+  class AsmEmitter {
+   public:
+    /**
+     * Builds the SSA form of a method, constructor, or main and writes it as a complete
+     * global function.
+     *
+     * @param settings Code generator settings
+     * @param name Symbol of the function
+     * @param method Method whose body is generated
+     * @param this_class Class of the implicit object.  nullptr for main.
+     * @param is_constructor True if method is the constructor of this_class
+     */
+    static void generate_function(CodeGen::Settings settings, const std::string &name,
+                                  Quack::Method * method, Quack::Class * this_class,
+                                  bool is_constructor);
+
+   private:
+    /** Storage for a value (false) or for the incoming value of a phi (true) */
+    typedef std::pair<const Instr*, bool> Var;
+
+    AsmEmitter(CodeGen::Settings &settings, const Function * fn);
+    /**
+     * Writes the prologue, all blocks, and the epilogue of each return.
+     *
+     * @param name Symbol of the function
+     */
+    void emit(const std::string &name);
+    /**
+     * Checks whether an instruction has no code of its own.  Other than parameters, which the
+     * prologue stores, these values are rematerialized at each use and have no slot.
+     *
+     * @param instr Value to check
+     * @return True if the instruction is not written where it appears
+     */
+    bool is_inline(const Instr * instr) const;
+    /**
+     * Assigns a frame slot to a variable.
+     *
+     * @param var Variable needing storage
+     */
+    void add_slot(const Var &var);
+    /**
+     * Memory operand of a variable's slot.
+     *
+     * @param var Variable with a slot
+     * @return Operand relative to the frame pointer
+     */
+    std::string slot(const Var &var) const {
+      return std::to_string(slots_.at(var)) + "(%rbp)";
+    }
+    /**
+     * Writes the code that places a value in a register.
+     *
+     * @param instr Value
+     * @param reg 64 bit register name
+     */
+    void load(const Instr * instr, const std::string &reg);
+    /**
+     * Writes the code that stores the result of an instruction held in %rax.
+     *
+     * @param instr Instruction producing the value
+     */
+    void store(const Instr * instr) {
+      line("movq %rax, " + slot(Var(instr, false)));
+    }
+    /**
+     * Writes the code that loads the clazz of an object held in %rdi.
+     *
+     * @param q_class Static type of the object
+     * @param reg Register to receive the clazz
+     */
+    void load_clazz(Quack::Class * q_class, const std::string &reg);
+    /**
+     * Writes the code to call a function or method.  Arguments beyond the sixth are passed on
+     * the stack.  The receiver is in %rdi when the callee is computed.
+     *
+     * @param args Arguments in order
+     * @param callee Operand of the call instruction (e.g., a symbol or "*32(%r10)")
+     * @param clazz_class If not null, %r10 is first loaded with the clazz of the receiver
+     *                    whose static type is clazz_class
+     */
+    void emit_call(const std::vector<Instr*> &args, const std::string &callee,
+                   Quack::Class * clazz_class);
+    /**
+     * Writes the code for a non-inline instruction that is not a terminator.
+     *
+     * @param instr Instruction to write
+     */
+    void emit_instr(const Instr * instr);
+    /**
+     * Writes the code for a block.
+     *
+     * @param block Block to write
+     * @param next Block written immediately after.  Jumps to it are omitted.
+     */
+    void emit_block(const BasicBlock * block, const BasicBlock * next);
+    /**
+     * Stores the incoming value of every phi in the successors of a block.
+     *
+     * @param block Predecessor block
+     */
+    void emit_phi_copies(const BasicBlock * block);
+    void emit_terminator(const Instr * term, const BasicBlock * next);
+    void emit_jump(const BasicBlock * target, const BasicBlock * next);
+    /**
+     * Writes one instruction (or directive) indented by a tab.
+     *
+     * @param text Instruction text
+     */
+    void line(const std::string &text);
+    /**
+     * Creates a label local to the assembly file.
+     *
+     * @param header Descriptive part of the label
+     * @return Unique label
+     */
+    static std::string new_label(const std::string &header);
+
+    CodeGen::Settings &settings_;
+    const Function * fn_;
+    std::map<const BasicBlock*, std::string> labels_;
+    /** Frame pointer offset of each variable's slot */
+    std::map<Var, int> slots_;
+    /** Offsets of the slots that hold objects */
+    std::vector<int> roots_;
+    /** Offset of the garbage collector frame followed by its root array */
+    int gc_frame_ = 0;
+    /** Number of bytes reserved below the frame pointer */
+    int frame_size_ = 0;
+  };
+}
+
+#endif //TYPE_CHECKER_IR_ASM_EMITTER_H
@@ -0,0 +1,655 @@
+//
+// Construction of the SSA intermediate representation from the type checked AST.
+//
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ir_builder.h"
+#include "ASTNode.h"
+#include "quack_class.h"
+#include "quack_method.h"
+#include "quack_param.h"
+#include "keywords.h"
+
+namespace IR {
+
+  /** Name of the variable holding the result of an inlined method */
+  static const char * const INLINE_RESULT_VAR = "$result";
+
+  Function * Builder::build(Quack::Method * method, Quack::Class * this_class,
+                            bool is_constructor) {
+    return build(method, this_class, is_constructor, true);
+  }
+
+  Function * Builder::build(Quack::Method * method, Quack::Class * this_class,
+                            bool is_constructor, bool inline_calls) {
+    Quack::Class * return_type = Quack::Class::Container::Nothing();
+    if (is_constructor)
+      return_type = this_class;
+    else if (this_class != nullptr)
+      return_type = method->return_type_;
+
+    auto * fn = new Function(method, this_class, is_constructor, return_type);
+    Builder builder(fn, inline_calls);
+    builder.seal(fn->entry_);
+
+    if (this_class != nullptr) {
+      Instr * self;
+      if (is_constructor) {
+        self = builder.emit(Op::Alloc, this_class, false);
+        self->class_ = this_class;
+      } else {
+        self = builder.emit(Op::Param, this_class, false);
+        self->text_ = OBJECT_SELF;
+        fn->params_.emplace_back(self);
+      }
+      builder.write_var(OBJECT_SELF, self);
+    }
+    for (auto * param : *method->params_) {
+      Instr * param_val = builder.emit(Op::Param, param->type_, false);
+      param_val->text_ = param->name_;
+      fn->params_.emplace_back(param_val);
+      builder.write_var(param->name_, param_val);
+    }
+
+    method->block_->build_ir(builder);
+
+    // Falling off the end returns the new object from a constructor and none otherwise
+    if (!builder.is_unreachable())
+      builder.ret(is_constructor ? builder.read_var(OBJECT_SELF) : builder.const_none());
+
+    fn->remove_unreachable_blocks();
+    fn->remove_dead_instrs();
+    return fn;
+  }
+
+  Instr * Builder::emit(Op op, Quack::Class * type, bool is_native, std::vector<Instr*> args) {
+    assert(block_->terminator() == nullptr);
+    Instr * instr = fn_->new_instr(op, type, is_native);
+    instr->args_ = std::move(args);
+    instr->block_ = block_;
+    block_->instrs_.emplace_back(instr);
+    return instr;
+  }
+
+  Instr * Builder::const_int(int value) {
+    Instr * instr = emit(Op::ConstInt, Quack::Class::Container::Int(), true);
+    instr->imm_ = value;
+    return instr;
+  }
+
+  Instr * Builder::const_bool(bool value) {
+    Instr * instr = emit(Op::ConstBool, Quack::Class::Container::Bool(), true);
+    instr->imm_ = value;
+    return instr;
+  }
+
+  Instr * Builder::const_str(const std::string &value) {
+    Instr * instr = emit(Op::ConstStr, Quack::Class::Container::Str(), false);
+    instr->text_ = value;
+    return instr;
+  }
+
+  Instr * Builder::const_none() {
+    return emit(Op::ConstNone, Quack::Class::Container::Nothing(), false);
+  }
+
+  Instr * Builder::as_object(Instr * val) {
+    if (!val->is_native_)
+      return val;
+    return emit(Op::Box, val->type_, false, {val});
+  }
+
+  Instr * Builder::as_native(Instr * val, Quack::Class * type) {
+    if (val->is_native_)
+      return val;
+    return emit(Op::Unbox, type, true, {val});
+  }
+
+  Instr * Builder::call(Instr * receiver, Quack::Class * receiver_type,
+                        const std::string &method_name, const std::vector<Instr*> &args,
+                        Quack::Class * result_type) {
+    std::vector<Instr*> call_args{as_object(receiver)};
+    for (auto * arg : args)
+      call_args.emplace_back(as_object(arg));
+
+    auto impl = receiver_type->unique_implementation(method_name);
+    if (can_inline(impl.first, impl.second))
+      return inline_call(impl.first, impl.second, call_args);
+
+    Instr * instr = emit(Op::Call, result_type, false, call_args);
+    instr->text_ = method_name;
+    instr->class_ = receiver_type;
+    instr->impl_class_ = impl.first;
+    instr->method_ = impl.second != nullptr ? impl.second : receiver_type->get_method(method_name);
+    return instr;
+  }
+
+  bool Builder::can_inline(Quack::Class * impl_class, Quack::Method * method) const {
+    if (!inline_calls_ || impl_class == nullptr || !impl_class->is_user_class()
+        || inline_stack_.size() >= IR_MAX_INLINE_DEPTH || method == fn_->method_)
+      return false;
+    for (const auto &frame : inline_stack_)
+      if (frame.method_ == method)
+        return false;
+
+    // The size is measured without any inlining in the callee
+    static std::map<const Quack::Method*, unsigned> method_sizes;
+    auto itr = method_sizes.find(method);
+    if (itr == method_sizes.end()) {
+      std::unique_ptr<Function> callee(build(method, impl_class, false, false));
+      unsigned size = 0;
+      for (auto * block : callee->blocks_)
+        for (auto * instr : block->instrs_)
+          size += !instr->is_inline() && instr->op_ != Op::Jump;
+      itr = method_sizes.emplace(method, size).first;
+    }
+    return itr->second <= IR_MAX_INLINE_SIZE;
+  }
+
+  Instr * Builder::inline_call(Quack::Class * impl_class, Quack::Method * method,
+                               const std::vector<Instr*> &args) {
+    BasicBlock * exit = new_block();
+    InlineFrame frame{method, "$" + std::to_string(exit->id_) + "$", exit};
+
+    inlined_vars_[frame.prefix_ + OBJECT_SELF] = impl_class;
+    inlined_vars_[frame.prefix_ + INLINE_RESULT_VAR] = method->return_type_;
+    for (const auto &symbol_info : *method->symbol_table_)
+      if (!symbol_info.first.second)
+        inlined_vars_[frame.prefix_ + symbol_info.first.first] = symbol_info.second->get_type();
+
+    inline_stack_.emplace_back(frame);
+    write_var(OBJECT_SELF, args[0]);
+    for (unsigned i = 1; i < args.size(); i++)
+      write_var((*method->params_)[i - 1]->name_, args[i]);
+
+    method->block_->build_ir(*this);
+    if (!is_unreachable())
+      ret(const_none());
+    inline_stack_.pop_back();
+
+    seal(exit);
+    set_block(exit);
+    return read_var(frame.prefix_ + INLINE_RESULT_VAR, exit);
+  }
+
+  void Builder::terminate(Instr * term) {
+    if (is_unreachable()) {
+      term->is_removed_ = true;
+    } else {
+      term->block_ = block_;
+      block_->instrs_.emplace_back(term);
+      for (auto * target : term->targets_) {
+        assert(sealed_.count(target) == 0);
+        if (std::find(target->preds_.begin(), target->preds_.end(), block_) == target->preds_.end())
+          target->preds_.emplace_back(block_);
+      }
+    }
+
+    // Anything built before the next set_block can never execute
+    block_ = new_block();
+    seal(block_);
+  }
+
+  void Builder::jump(BasicBlock * target) {
+    Instr * term = fn_->new_instr(Op::Jump, nullptr, false);
+    term->targets_ = {target};
+    terminate(term);
+  }
+
+  void Builder::branch(Instr * cond, BasicBlock * true_block, BasicBlock * false_block) {
+    Instr * term = fn_->new_instr(Op::Branch, nullptr, false);
+    term->args_ = {cond};
+    term->targets_ = {true_block, false_block};
+    terminate(term);
+  }
+
+  void Builder::switch_class(Instr * obj, Quack::Class * obj_type,
+                             const std::vector<std::pair<unsigned, unsigned>> &ranges,
+                             const std::vector<BasicBlock*> &targets,
+                             BasicBlock * default_target) {
+    Instr * term = fn_->new_instr(Op::Switch, nullptr, false);
+    term->args_ = {obj};
+    term->class_ = obj_type;
+    term->ranges_ = ranges;
+    term->targets_ = targets;
+    term->targets_.emplace_back(default_target);
+    terminate(term);
+  }
+
+  void Builder::ret(Instr * val) {
+    if (!inline_stack_.empty()) {
+      const InlineFrame &frame = inline_stack_.back();
+      assign(frame.prefix_ + INLINE_RESULT_VAR, val);
+      return jump(frame.exit_);
+    }
+
+    Instr * term = fn_->new_instr(Op::Return, fn_->return_type_, false);
+    term->args_ = {as_object(val)};
+    terminate(term);
+  }
+
+  Instr * Builder::phi(Quack::Class * type, bool is_native, const std::vector<Instr*> &args) {
+    Instr * instr = fn_->new_instr(Op::Phi, type, is_native);
+    instr->args_ = args;
+    instr->block_ = block_;
+    block_->phis_.emplace_back(instr);
+    return instr;
+  }
+
+  void Builder::seal(BasicBlock * block) {
+    auto itr = incomplete_phis_.find(block);
+    if (itr != incomplete_phis_.end()) {
+      for (auto &var_phi : itr->second)
+        add_phi_operands(var_phi.first, var_phi.second);
+      incomplete_phis_.erase(itr);
+    }
+    sealed_.insert(block);
+  }
+
+  void Builder::assign(const std::string &name, Instr * val) {
+    Quack::Class * type = var_type(name);
+    write_var(name, block_, is_native_var(name) ? as_native(val, type) : as_object(val));
+  }
+
+  Quack::Class * Builder::var_type(const std::string &name) const {
+    if (name == OBJECT_SELF)
+      return fn_->this_class_;
+    auto itr = inlined_vars_.find(name);
+    if (itr != inlined_vars_.end())
+      return itr->second;
+    return fn_->method_->symbol_table_->get(name, false)->get_type();
+  }
+
+  bool Builder::is_native_var(const std::string &name) const {
+    return name != OBJECT_SELF && var_type(name)->is_unboxable();
+  }
+
+  Instr * Builder::undef(const std::string &name, BasicBlock * block) {
+    Instr * instr = fn_->new_instr(Op::Undef, var_type(name), is_native_var(name));
+    instr->block_ = block;
+    block->instrs_.insert(block->instrs_.begin(), instr);
+    return instr;
+  }
+
+  Instr * Builder::new_phi(const std::string &name, BasicBlock * block) {
+    Instr * instr = fn_->new_instr(Op::Phi, var_type(name), is_native_var(name));
+    instr->block_ = block;
+    block->phis_.emplace_back(instr);
+    return instr;
+  }
+
+  Instr * Builder::read_var(const std::string &name, BasicBlock * block) {
+    auto &defs = current_defs_[name];
+    auto itr = defs.find(block);
+    if (itr != defs.end())
+      return itr->second;
+    return read_var_recursive(name, block);
+  }
+
+  Instr * Builder::read_var_recursive(const std::string &name, BasicBlock * block) {
+    Instr * val;
+    if (sealed_.count(block) == 0) {
+      // Operands are added once all predecessors are known
+      val = new_phi(name, block);
+      incomplete_phis_[block].emplace_back(name, val);
+    } else if (block->preds_.size() == 1) {
+      val = read_var(name, block->preds_[0]);
+    } else if (block->preds_.empty()) {
+      val = undef(name, block);
+    } else {
+      // Break cycles by defining the variable before reading the predecessors
+      val = new_phi(name, block);
+      write_var(name, block, val);
+      val = add_phi_operands(name, val);
+    }
+    write_var(name, block, val);
+    return val;
+  }
+
+  Instr * Builder::add_phi_operands(const std::string &name, Instr * phi) {
+    for (auto * pred : phi->block_->preds_)
+      phi->args_.emplace_back(read_var(name, pred));
+    return try_remove_trivial_phi(phi);
+  }
+
+  Instr * Builder::try_remove_trivial_phi(Instr * phi) {
+    Instr * same = nullptr;
+    for (auto * arg : phi->args_) {
+      if (arg == same || arg == phi)
+        continue;
+      if (same != nullptr)
+        return phi;
+      same = arg;
+    }
+    // Only reachable from the entry through itself
+    if (same == nullptr) {
+      same = fn_->new_instr(Op::Undef, phi->type_, phi->is_native_);
+      same->block_ = phi->block_;
+      phi->block_->instrs_.insert(phi->block_->instrs_.begin(), same);
+    }
+
+    std::vector<Instr*> phi_users;
+    for (auto * block : fn_->blocks_)
+      for (auto * user : block->phis_)
+        if (user != phi && std::find(user->args_.begin(), user->args_.end(), phi) != user->args_.end())
+          phi_users.emplace_back(user);
+
+    fn_->replace_all_uses(phi, same);
+    for (auto &var_defs : current_defs_)
+      for (auto &block_def : var_defs.second)
+        if (block_def.second == phi)
+          block_def.second = same;
+
+    auto &phis = phi->block_->phis_;
+    phis.erase(std::find(phis.begin(), phis.end(), phi));
+    phi->is_removed_ = true;
+    replacements_[phi] = same;
+
+    for (auto * user : phi_users)
+      if (!user->is_removed_)
+        try_remove_trivial_phi(user);
+    // Removing the users may have removed the replacement as well
+    while (same->is_removed_)
+      same = replacements_.at(same);
+    return same;
+  }
+}
+
+namespace AST {
+  /**
+   * Native instruction for an operator whose operands are both exactly Int or Boolean.
+   *
+   * @param opsym Operator symbol
+   * @return Corresponding native operation
+   */
+  static IR::Op native_op(const std::string &opsym) {
+    if (opsym == "+")
+      return IR::Op::Add;
+    if (opsym == "-")
+      return IR::Op::Sub;
+    if (opsym == "*")
+      return IR::Op::Mul;
+    if (opsym == "/")
+      return IR::Op::Div;
+    if (opsym == "<")
+      return IR::Op::Lt;
+    if (opsym == "<=")
+      return IR::Op::Le;
+    if (opsym == ">")
+      return IR::Op::Gt;
+    if (opsym == ">=")
+      return IR::Op::Ge;
+    if (opsym == "==")
+      return IR::Op::Eq;
+    throw UnknownBinOpException(opsym);
+  }
+
+  void Block::build_ir(IR::Builder &builder) const {
+    for (auto * stmt : stmts_) {
+      if (builder.is_unreachable())
+        return;
+      stmt->build_ir(builder);
+    }
+  }
+
+  void ASTNode::build_ir_branch(IR::Builder &builder, IR::BasicBlock * true_block,
+                                IR::BasicBlock * false_block) const {
+    if (auto bool_lit = dynamic_cast<const BoolLit*>(this))
+      return builder.jump(bool_lit->value_ ? true_block : false_block);
+
+    if (auto bool_op = dynamic_cast<const BoolOp*>(this)) {
+      if (bool_op->opsym == UNARY_OP_NOT)
+        return bool_op->left_->build_ir_branch(builder, false_block, true_block);
+
+      IR::BasicBlock * halfway_block = builder.new_block();
+      if (bool_op->opsym == METHOD_AND)
+        bool_op->left_->build_ir_branch(builder, halfway_block, false_block);
+      else if (bool_op->opsym == METHOD_OR)
+        bool_op->left_->build_ir_branch(builder, true_block, halfway_block);
+      else
+        throw std::runtime_error("Unknown Boolean operator " + bool_op->opsym);
+
+      builder.seal(halfway_block);
+      builder.set_block(halfway_block);
+      return bool_op->right_->build_ir_branch(builder, true_block, false_block);
+    }
+
+    IR::Instr * cond = builder.as_native(build_ir(builder), Quack::Class::Container::Bool());
+    builder.branch(cond, true_block, false_block);
+  }
+
+  IR::Instr * If::build_ir(IR::Builder &builder) const {
+    IR::BasicBlock * true_block = builder.new_block();
+    IR::BasicBlock * false_block = builder.new_block();
+    IR::BasicBlock * end_block = builder.new_block();
+
+    cond_->build_ir_branch(builder, true_block, false_block);
+    builder.seal(true_block);
+    builder.seal(false_block);
+
+    builder.set_block(true_block);
+    truepart_->build_ir(builder);
+    builder.jump(end_block);
+
+    builder.set_block(false_block);
+    if (falsepart_)
+      falsepart_->build_ir(builder);
+    builder.jump(end_block);
+
+    builder.seal(end_block);
+    builder.set_block(end_block);
+    return nullptr;
+  }
+
+  IR::Instr * While::build_ir(IR::Builder &builder) const {
+    IR::BasicBlock * cond_block = builder.new_block();
+    IR::BasicBlock * body_block = builder.new_block();
+    IR::BasicBlock * end_block = builder.new_block();
+
+    builder.jump(cond_block);
+    builder.set_block(cond_block);
+    cond_->build_ir_branch(builder, body_block, end_block);
+
+    builder.seal(body_block);
+    builder.set_block(body_block);
+    body_->build_ir(builder);
+    builder.jump(cond_block);
+
+    // The back edge is the last predecessor of the condition
+    builder.seal(cond_block);
+    builder.seal(end_block);
+    builder.set_block(end_block);
+    return nullptr;
+  }
+
+  IR::Instr * Ident::build_ir(IR::Builder &builder) const {
+    return builder.read_var(text_);
+  }
+
+  IR::Instr * IntLit::build_ir(IR::Builder &builder) const {
+    return builder.const_int(value_);
+  }
+
+  IR::Instr * BoolLit::build_ir(IR::Builder &builder) const {
+    return builder.const_bool(value_);
+  }
+
+  IR::Instr * NothingLit::build_ir(IR::Builder &builder) const {
+    return builder.const_none();
+  }
+
+  IR::Instr * StrLit::build_ir(IR::Builder &builder) const {
+    return builder.const_str(value_);
+  }
+
+  IR::Instr * Return::build_ir(IR::Builder &builder) const {
+    builder.ret(right_->build_ir(builder));
+    return nullptr;
+  }
+
+  std::vector<IR::Instr*> RhsArgs::build_ir_args(IR::Builder &builder) const {
+    std::vector<IR::Instr*> vals;
+    vals.reserve(args_.size());
+    for (auto * arg : args_)
+      vals.emplace_back(builder.as_object(arg->build_ir(builder)));
+    return vals;
+  }
+
+  IR::Instr * FunctionCall::build_ir(IR::Builder &builder) const {
+    Quack::Class * q_class = Quack::Class::Container::singleton()->get(ident_);
+    assert(q_class);
+
+    IR::Instr * instr = builder.emit(IR::Op::New, q_class, false, args_->build_ir_args(builder));
+    instr->class_ = q_class;
+    return instr;
+  }
+
+  IR::Instr * ObjectCall::build_ir(IR::Builder &builder) const {
+    IR::Instr * obj = builder.as_object(object_->build_ir(builder));
+    Quack::Class * obj_type = object_->get_node_type();
+
+    if (auto func_call = dynamic_cast<FunctionCall*>(next_)) {
+      std::vector<IR::Instr*> args = func_call->args_->build_ir_args(builder);
+      return builder.call(obj, obj_type, func_call->ident_, args, type_);
+    }
+
+    if (auto ident = dynamic_cast<Ident*>(next_)) {
+      IR::Instr * load = builder.emit(IR::Op::LoadField, type_, is_unboxed_field(), {obj});
+      load->text_ = ident->text_;
+      load->class_ = obj_type;
+      return load;
+    }
+    throw std::runtime_error("Unexpected bottoming out of ObjectCall IR construction");
+  }
+
+  IR::Instr * BinOp::build_ir(IR::Builder &builder) const {
+    if (is_native_op()) {
+      IR::Instr * left = builder.as_native(left_->build_ir(builder), left_->get_node_type());
+      IR::Instr * right = builder.as_native(right_->build_ir(builder), right_->get_node_type());
+      return builder.emit(native_op(opsym), type_, true, {left, right});
+    }
+
+    IR::Instr * left = left_->build_ir(builder);
+    IR::Instr * right = right_->build_ir(builder);
+    return builder.call(left, left_->get_node_type(), op_lookup(opsym), {right}, type_);
+  }
+
+  IR::Instr * BoolOp::build_ir(IR::Builder &builder) const {
+    Quack::Class * bool_class = Quack::Class::Container::Bool();
+    if (opsym == UNARY_OP_NOT) {
+      IR::Instr * operand = builder.as_native(left_->build_ir(builder), bool_class);
+      return builder.emit(IR::Op::Not, bool_class, true, {operand});
+    }
+
+    IR::BasicBlock * true_block = builder.new_block();
+    IR::BasicBlock * false_block = builder.new_block();
+    IR::BasicBlock * end_block = builder.new_block();
+
+    build_ir_branch(builder, true_block, false_block);
+    builder.seal(true_block);
+    builder.seal(false_block);
+
+    builder.set_block(true_block);
+    IR::Instr * true_val = builder.const_bool(true);
+    builder.jump(end_block);
+
+    builder.set_block(false_block);
+    IR::Instr * false_val = builder.const_bool(false);
+    builder.jump(end_block);
+
+    builder.seal(end_block);
+    builder.set_block(end_block);
+    std::vector<IR::Instr*> args;
+    for (auto * pred : end_block->preds_)
+      args.emplace_back(pred == true_block ? true_val : false_val);
+    if (args.size() == 1)
+      return args[0];
+    return builder.phi(bool_class, true, args);
+  }
+
+  IR::Instr * UniOp::build_ir(IR::Builder &builder) const {
+    if (opsym != UNARY_OP_NEG)
+      throw std::runtime_error("Only unary operation supported is \"" UNARY_OP_NEG "\"");
+
+    IR::Instr * right = right_->build_ir(builder);
+    if (right_->is_unboxable()) {
+      right = builder.as_native(right, right_->get_node_type());
+      return builder.emit(IR::Op::Neg, type_, true, {right});
+    }
+
+    // Negation is subtraction from zero
+    Quack::Class * int_class = Quack::Class::Container::Int();
+    return builder.call(builder.const_int(0), int_class, METHOD_SUBTRACT, {right}, type_);
+  }
+
+  IR::Instr * Typing::build_ir(IR::Builder &builder) const {
+    return expr_->build_ir(builder);
+  }
+
+  IR::Instr * Assn::build_ir(IR::Builder &builder) const {
+    IR::Instr * rhs = rhs_->build_ir(builder);
+
+    if (auto ident = dynamic_cast<Ident*>(lhs_->expr_)) {
+      builder.write_var(ident->text_, rhs);
+      return nullptr;
+    }
+
+    // Otherwise the left hand side must be a field, i.e., obj.<FieldName>
+    auto obj_call = dynamic_cast<ObjectCall*>(lhs_->expr_);
+    auto field = obj_call ? dynamic_cast<Ident*>(obj_call->next_) : nullptr;
+    if (field == nullptr)
+      throw std::runtime_error("Invalid left hand side of an assignment");
+
+    IR::Instr * obj = builder.as_object(obj_call->object_->build_ir(builder));
+    Quack::Class * field_type = lhs_->get_node_type();
+    IR::Instr * val = obj_call->is_unboxed_field() ? builder.as_native(rhs, field_type)
+                                                   : builder.as_object(rhs);
+    IR::Instr * store = builder.emit(IR::Op::StoreField, field_type, false, {obj, val});
+    store->text_ = field->text_;
+    store->class_ = obj_call->object_->get_node_type();
+    return nullptr;
+  }
+
+  IR::Instr * Typecase::build_ir(IR::Builder &builder) const {
+    IR::Instr * val = builder.as_object(expr_->build_ir(builder));
+
+    std::vector<IR::BasicBlock*> alt_blocks;
+    for (unsigned i = 0; i < alts_->size(); i++)
+      alt_blocks.emplace_back(builder.new_block());
+    IR::BasicBlock * end_block = builder.new_block();
+
+    // Consecutive class IDs with the same first matching alternative share a range
+    std::vector<unsigned> matches = match_alternatives();
+    std::vector<std::pair<unsigned, unsigned>> ranges;
+    std::vector<IR::BasicBlock*> targets;
+    for (unsigned first = 0; first < matches.size(); ) {
+      unsigned last = first;
+      while (last + 1 < matches.size() && matches[last + 1] == matches[first])
+        last++;
+      if (matches[first] != alts_->size()) {
+        ranges.emplace_back(first, last);
+        targets.emplace_back(alt_blocks[matches[first]]);
+      }
+      first = last + 1;
+    }
+    builder.switch_class(val, expr_->get_node_type(), ranges, targets, end_block);
+
+    for (unsigned i = 0; i < alts_->size(); i++) {
+      builder.seal(alt_blocks[i]);
+      builder.set_block(alt_blocks[i]);
+      if (!builder.is_unreachable()) {
+        builder.write_var((*alts_)[i]->type_names_[0], val);
+        (*alts_)[i]->block_->build_ir(builder);
+      }
+      builder.jump(end_block);
+    }
+
+    builder.seal(end_block);
+    builder.set_block(end_block);
+    return nullptr;
+  }
+}
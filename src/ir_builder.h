@@ -0,0 +1,280 @@
+//
+// Construction of the SSA intermediate representation from the type checked AST.
+//
+
+#ifndef TYPE_CHECKER_IR_BUILDER_H
+#define TYPE_CHECKER_IR_BUILDER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ir.h"
+
+/** Largest callee, in instructions, that is inlined at a statically known call site */
+#define IR_MAX_INLINE_SIZE 16
+/** Deepest nesting of inlined calls within a single function */
+#define IR_MAX_INLINE_DEPTH 3
+
+// Forward Declaration
+namespace Quack { class Class; class Method; }
+
+namespace IR {
+  /**
+   * Builds the SSA form of a single method while its AST is walked.  Local variables are
+   * renamed on the fly using the algorithm of Braun et al., "Simple and Efficient Construction
+   * of Static Single Assignment Form."  A block must be sealed once all of its predecessors are
+   * known; until then, reads create placeholder phis that are completed when it is sealed.
+   *
+   * Locals whose type is exactly Int or Boolean are held as native values; all other locals
+   * are objects.  Values are converted between the two representations as needed.
+   */
+  class Builder {
+   public:
+    /**
+     * Builds the SSA function for a method, constructor, or main.
+     *
+     * @param method Method to build
+     * @param this_class Class of the implicit object.  nullptr for main.
+     * @param is_constructor True if method is the constructor of this_class
+     * @return New function owned by the caller
+     */
+    static Function * build(Quack::Method * method, Quack::Class * this_class,
+                            bool is_constructor);
+    /**
+     * Appends a new instruction to the current block.
+     *
+     * @param op Operation
+     * @param type Static type of the result
+     * @param is_native True if the result is a native int or bool
+     * @param args Operands
+     * @return New instruction
+     */
+    Instr * emit(Op op, Quack::Class * type, bool is_native, std::vector<Instr*> args = {});
+
+    Instr * const_int(int value);
+    Instr * const_bool(bool value);
+    Instr * const_str(const std::string &value);
+    Instr * const_none();
+    /**
+     * Converts a value to an object, boxing it if it is native.
+     *
+     * @param val Value to convert
+     * @return Object value
+     */
+    Instr * as_object(Instr * val);
+    /**
+     * Converts a value to a native int or bool, unboxing it if it is an object.
+     *
+     * @param val Value to convert
+     * @param type Either Int or Boolean
+     * @return Native value
+     */
+    Instr * as_native(Instr * val, Quack::Class * type);
+    /**
+     * Calls a method on an object.  The call is direct when class hierarchy analysis shows
+     * only one implementation is reachable.  Small user methods called directly are inlined.
+     *
+     * @param receiver Object whose method is called
+     * @param receiver_type Static type of the receiver
+     * @param method_name Name of the method
+     * @param args Arguments other than the receiver
+     * @param result_type Static type of the result
+     * @return Call instruction or the value returned by the inlined method
+     */
+    Instr * call(Instr * receiver, Quack::Class * receiver_type, const std::string &method_name,
+                 const std::vector<Instr*> &args, Quack::Class * result_type);
+    /**
+     * Creates a new block in the function.  The block is not made current.
+     *
+     * @return New block
+     */
+    BasicBlock * new_block() { return fn_->new_block(); }
+    /** Makes the specified block current.  Subsequent instructions are appended to it. */
+    void set_block(BasicBlock * block) { block_ = block; }
+    /**
+     * Marks that all predecessors of the block are known.
+     *
+     * @param block Block to seal
+     */
+    void seal(BasicBlock * block);
+    /**
+     * Checks whether the current block can never execute (e.g., follows a return).  Code is
+     * not built for unreachable blocks.
+     *
+     * @return True if the current block is unreachable
+     */
+    bool is_unreachable() const {
+      return block_ != fn_->entry_ && block_->preds_.empty() && sealed_.count(block_) != 0;
+    }
+    void jump(BasicBlock * target);
+    void branch(Instr * cond, BasicBlock * true_block, BasicBlock * false_block);
+    /**
+     * Ends the block with a multiway branch on an object's class ID.
+     *
+     * @param obj Object whose class is tested
+     * @param obj_type Static type of obj
+     * @param ranges Inclusive class ID range for each target
+     * @param targets Target of each range
+     * @param default_target Target if no range matches
+     */
+    void switch_class(Instr * obj, Quack::Class * obj_type,
+                      const std::vector<std::pair<unsigned, unsigned>> &ranges,
+                      const std::vector<BasicBlock*> &targets, BasicBlock * default_target);
+    /**
+     * Returns a value from the function.  The value is cast to the function's return type.
+     * Inside an inlined method, the value is instead assigned to the method's result and
+     * control jumps to the end of the inlined body.
+     *
+     * @param val Value to return
+     */
+    void ret(Instr * val);
+    /**
+     * Creates a phi in the current block from one value per predecessor.
+     *
+     * @param type Static type of the result
+     * @param is_native True if the result is native
+     * @param args Value for each predecessor in order
+     * @return Phi instruction
+     */
+    Instr * phi(Quack::Class * type, bool is_native, const std::vector<Instr*> &args);
+    /**
+     * Accessor for the current value of a local variable or parameter.
+     *
+     * @param name Variable name
+     * @return Value of the variable in the variable's representation
+     */
+    Instr * read_var(const std::string &name) { return read_var(scoped(name), block_); }
+    /**
+     * Assigns a local variable or parameter.  The value is converted to the variable's
+     * representation.
+     *
+     * @param name Variable name
+     * @param val New value of the variable
+     */
+    void write_var(const std::string &name, Instr * val) { assign(scoped(name), val); }
+    /** Function being built */
+    Function * function() { return fn_; }
+
+   private:
+    /** Method whose body is being inlined into the function */
+    struct InlineFrame {
+      Quack::Method * method_;
+      /** Prepended to the callee's variable names so they never clash with the caller's */
+      std::string prefix_;
+      /** Block where each return of the callee jumps */
+      BasicBlock * exit_;
+    };
+
+    Builder(Function * fn, bool inline_calls)
+        : fn_(fn), block_(fn->entry_), inline_calls_(inline_calls) {}
+
+    static Function * build(Quack::Method * method, Quack::Class * this_class,
+                            bool is_constructor, bool inline_calls);
+    /**
+     * Checks whether a call's only implementation is small enough to inline.  Recursive
+     * calls are never inlined.
+     *
+     * @param impl_class Class that implements the method
+     * @param method Method implementation
+     * @return True if the method should be inlined
+     */
+    bool can_inline(Quack::Class * impl_class, Quack::Method * method) const;
+    /**
+     * Builds the body of a method at the call site.  The receiver and arguments are
+     * assigned to the callee's renamed implicit object and parameters.
+     *
+     * @param impl_class Class that implements the method
+     * @param method Method to inline
+     * @param args Receiver followed by the arguments
+     * @return Value returned by the method
+     */
+    Instr * inline_call(Quack::Class * impl_class, Quack::Method * method,
+                        const std::vector<Instr*> &args);
+    /**
+     * Name of a variable of the method currently being built.
+     *
+     * @param name Variable name in the source
+     * @return Name unique within the function
+     */
+    std::string scoped(const std::string &name) const {
+      return inline_stack_.empty() ? name : inline_stack_.back().prefix_ + name;
+    }
+    /**
+     * Assigns a variable after converting the value to the variable's representation.
+     *
+     * @param name Scoped variable name
+     * @param val New value of the variable
+     */
+    void assign(const std::string &name, Instr * val);
+    /**
+     * Adds a terminator to the current block and records the block as a predecessor of each
+     * target.  Unreachable blocks are left without a terminator and are discarded later.
+     *
+     * @param term Terminator instruction
+     */
+    void terminate(Instr * term);
+    /**
+     * Type of a variable.  The implicit object is not in the symbol table.
+     *
+     * @param name Scoped variable name
+     * @return Type of the variable
+     */
+    Quack::Class * var_type(const std::string &name) const;
+    /**
+     * Checks whether a variable is held as a native value.
+     *
+     * @param name Variable name
+     * @return True if the variable is exactly Int or Boolean
+     */
+    bool is_native_var(const std::string &name) const;
+    /**
+     * Creates an undefined value of a variable's type at the start of the block.
+     *
+     * @param name Variable name
+     * @param block Block to contain the value
+     * @return Undefined value
+     */
+    Instr * undef(const std::string &name, BasicBlock * block);
+    /**
+     * Creates an empty phi for a variable at the start of the block.
+     *
+     * @param name Variable name
+     * @param block Block to contain the phi
+     * @return New phi
+     */
+    Instr * new_phi(const std::string &name, BasicBlock * block);
+    void write_var(const std::string &name, BasicBlock * block, Instr * val) {
+      current_defs_[name][block] = val;
+    }
+    Instr * read_var(const std::string &name, BasicBlock * block);
+    Instr * read_var_recursive(const std::string &name, BasicBlock * block);
+    Instr * add_phi_operands(const std::string &name, Instr * phi);
+    /**
+     * Replaces a phi whose arguments are all the same value (or the phi itself) by that value.
+     * Phis that used the replaced phi may then become trivial themselves.
+     *
+     * @param phi Phi to check
+     * @return Value that now represents the phi
+     */
+    Instr * try_remove_trivial_phi(Instr * phi);
+
+    Function * fn_;
+    BasicBlock * block_;
+    /** Definition of each variable at the end of each block that assigns or reads it */
+    std::map<std::string, std::map<BasicBlock*, Instr*>> current_defs_;
+    std::map<BasicBlock*, std::vector<std::pair<std::string, Instr*>>> incomplete_phis_;
+    std::set<BasicBlock*> sealed_;
+    /** Value that replaced each removed trivial phi */
+    std::map<Instr*, Instr*> replacements_;
+    /** False while measuring the size of a possible callee */
+    bool inline_calls_;
+    std::vector<InlineFrame> inline_stack_;
+    /** Type of each variable of an inlined method by scoped name */
+    std::map<std::string, Quack::Class*> inlined_vars_;
+  };
+}
+
+#endif //TYPE_CHECKER_IR_BUILDER_H
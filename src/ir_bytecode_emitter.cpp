@@ -0,0 +1,315 @@
+//
+// Generation of interpreter bytecode from the SSA intermediate representation.
+//
+
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ir_bytecode_emitter.h"
+#include "ir_builder.h"
+#include "ir_optimizer.h"
+#include "quack_class.h"
+#include "quack_method.h"
+
+namespace IR {
+
+  int32_t BytecodeEmitter::Constants::add(int value) {
+    return add(QUACK_VM_CONST_INT, value, "");
+  }
+
+  int32_t BytecodeEmitter::Constants::add(const std::string &text) {
+    return add(QUACK_VM_CONST_STR, 0, text);
+  }
+
+  int32_t BytecodeEmitter::Constants::add(quack_vm_constant_kind kind) {
+    return add(kind, 0, "");
+  }
+
+  int32_t BytecodeEmitter::Constants::add(quack_vm_constant_kind kind, int value,
+                                          const std::string &text) {
+    auto key = std::make_pair(static_cast<int>(kind), std::make_pair(value, text));
+    auto itr = indices_.find(key);
+    if (itr != indices_.end())
+      return itr->second;
+
+    quack_vm_constant constant = {kind, value, nullptr, 0};
+    if (kind == QUACK_VM_CONST_STR) {
+      // The lexer only passes through the escapes below
+      std::string unescaped;
+      for (unsigned i = 0; i < text.size(); i++) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+          unescaped += text[i];
+          continue;
+        }
+        switch (text[++i]) {
+          case '0': unescaped += '\0'; break;
+          case 'b': unescaped += '\b'; break;
+          case 't': unescaped += '\t'; break;
+          case 'n': unescaped += '\n'; break;
+          case 'r': unescaped += '\r'; break;
+          case 'f': unescaped += '\f'; break;
+          default: unescaped += text[i];
+        }
+      }
+      texts_.emplace_back(unescaped);
+      constant.text = texts_.back().c_str();
+      constant.length = texts_.back().size();
+    }
+
+    auto index = static_cast<int32_t>(table_.size());
+    table_.emplace_back(constant);
+    indices_.emplace(key, index);
+    return index;
+  }
+
+  BytecodeEmitter::Code BytecodeEmitter::generate_function(Constants &constants, bool print_ir,
+                                                           Quack::Method * method,
+                                                           Quack::Class * this_class,
+                                                           bool is_constructor) {
+    std::unique_ptr<Function> fn(Builder::build(method, this_class, is_constructor));
+    Optimizer::run(fn.get());
+    if (print_ir)
+      fn->print(std::cout);
+
+    BytecodeEmitter emitter(constants, fn.get());
+    emitter.emit();
+    return emitter.code_;
+  }
+
+  BytecodeEmitter::BytecodeEmitter(Constants &constants, const Function * fn)
+      : constants_(constants), fn_(fn) {
+    for (auto * param : fn_->params_)
+      reg(param);
+    code_.num_params_ = static_cast<unsigned>(fn_->params_.size());
+  }
+
+  int32_t BytecodeEmitter::reg(const Var &var) {
+    auto itr = regs_.find(var);
+    if (itr != regs_.end())
+      return itr->second;
+    auto index = static_cast<int32_t>(regs_.size());
+    regs_.emplace(var, index);
+    code_.num_regs_ = static_cast<unsigned>(regs_.size());
+    return index;
+  }
+
+  bool BytecodeEmitter::is_constant(const Instr * instr) {
+    if (instr->op_ == Op::Box)
+      return instr->args_[0]->op_ == Op::ConstInt || instr->args_[0]->op_ == Op::ConstBool;
+    return instr->is_inline() && instr->op_ != Op::Param;
+  }
+
+  void BytecodeEmitter::emit() {
+    auto &words = code_.words_;
+    for (auto * block : fn_->blocks_)
+      for (auto * instr : block->instrs_)
+        if (is_constant(instr))
+          emit_constant(instr);
+
+    const auto &blocks = fn_->blocks_;
+    for (unsigned i = 0; i < blocks.size(); i++)
+      emit_block(blocks[i], i + 1 < blocks.size() ? blocks[i + 1] : nullptr);
+
+    for (const auto &fixup : fixups_)
+      words[fixup.first] = positions_.at(fixup.second);
+  }
+
+  void BytecodeEmitter::emit_constant(const Instr * instr) {
+    auto &words = code_.words_;
+    switch (instr->op_) {
+      case Op::ConstInt: case Op::ConstBool:
+        words.insert(words.end(), {QUACK_VM_INT, reg(instr), static_cast<int32_t>(instr->imm_)});
+        return;
+      case Op::Undef:
+        words.insert(words.end(), {QUACK_VM_INT, reg(instr), 0});
+        return;
+      default:
+        break;
+    }
+
+    int32_t constant;
+    if (instr->op_ == Op::ConstStr) {
+      constant = constants_.add(instr->text_);
+    } else if (instr->op_ == Op::ConstNone) {
+      constant = constants_.add(QUACK_VM_CONST_NONE);
+    } else {
+      const Instr * lit = instr->args_[0];
+      if (lit->op_ == Op::ConstInt)
+        constant = constants_.add(static_cast<int>(lit->imm_));
+      else
+        constant = constants_.add(lit->imm_ ? QUACK_VM_CONST_TRUE : QUACK_VM_CONST_FALSE);
+    }
+    words.insert(words.end(), {QUACK_VM_CONST, reg(instr), constant});
+  }
+
+  void BytecodeEmitter::emit_call(std::vector<int32_t> operands, const std::vector<Instr*> &args) {
+    operands.emplace_back(static_cast<int32_t>(args.size()));
+    for (auto * arg : args)
+      operands.emplace_back(reg(arg));
+    code_.words_.insert(code_.words_.end(), operands.begin(), operands.end());
+    code_.max_args_ = std::max(code_.max_args_, static_cast<unsigned>(args.size()));
+  }
+
+  /**
+   * Slot of a method in the method tables of a class and its subclasses.
+   *
+   * @param q_class Class of the method table
+   * @param method_name Method name
+   * @return Slot operand
+   */
+  static int32_t slot(Quack::Class * q_class, const std::string &method_name) {
+    return static_cast<int32_t>(q_class->generated_method_index(method_name));
+  }
+
+  /**
+   * Field operand of a field load or store.
+   *
+   * @param instr LoadField or StoreField
+   * @return Index of the field in the object
+   */
+  static int32_t field(const Instr * instr) {
+    return static_cast<int32_t>(instr->class_->generated_field_index(instr->text_));
+  }
+
+  /**
+   * Opcode of a native operation.
+   *
+   * @param op Native operation
+   * @return Interpreter opcode
+   */
+  static quack_vm_opcode native_opcode(Op op) {
+    switch (op) {
+      case Op::Add: return QUACK_VM_ADD;
+      case Op::Sub: return QUACK_VM_SUB;
+      case Op::Mul: return QUACK_VM_MUL;
+      case Op::Div: return QUACK_VM_DIV;
+      case Op::Lt: return QUACK_VM_LT;
+      case Op::Le: return QUACK_VM_LE;
+      case Op::Gt: return QUACK_VM_GT;
+      case Op::Ge: return QUACK_VM_GE;
+      case Op::Eq: return QUACK_VM_EQ;
+      case Op::Neg: return QUACK_VM_NEG;
+      case Op::Not: return QUACK_VM_NOT;
+      default: throw std::runtime_error("Not a native operation");
+    }
+  }
+
+  void BytecodeEmitter::emit_instr(const Instr * instr) {
+    auto &words = code_.words_;
+    const auto &args = instr->args_;
+    bool is_int = instr->type_ == Quack::Class::Container::Int();
+    switch (instr->op_) {
+      case Op::Add: case Op::Sub: case Op::Mul: case Op::Div:
+      case Op::Lt: case Op::Le: case Op::Gt: case Op::Ge: case Op::Eq:
+        words.insert(words.end(), {native_opcode(instr->op_), reg(instr), reg(args[0]),
+                                   reg(args[1])});
+        break;
+      case Op::Neg: case Op::Not:
+        words.insert(words.end(), {native_opcode(instr->op_), reg(instr), reg(args[0])});
+        break;
+      case Op::Box:
+        words.insert(words.end(), {is_int ? QUACK_VM_BOX_INT : QUACK_VM_BOX_BOOL, reg(instr),
+                                   reg(args[0])});
+        break;
+      case Op::Unbox:
+        words.insert(words.end(), {is_int ? QUACK_VM_UNBOX_INT : QUACK_VM_UNBOX_BOOL, reg(instr),
+                                   reg(args[0])});
+        break;
+      case Op::Alloc:
+        words.insert(words.end(), {QUACK_VM_ALLOC, reg(instr),
+                                   static_cast<int32_t>(instr->class_->class_id_)});
+        break;
+      case Op::New:
+        emit_call({QUACK_VM_NEW, reg(instr), static_cast<int32_t>(instr->class_->class_id_)},
+                  args);
+        break;
+      case Op::Call:
+        if (instr->impl_class_ != nullptr) {
+          emit_call({QUACK_VM_CALL, reg(instr),
+                     static_cast<int32_t>(instr->impl_class_->class_id_),
+                     slot(instr->impl_class_, instr->text_)}, args);
+          break;
+        }
+        emit_call({QUACK_VM_SEND, reg(instr), slot(instr->class_, instr->text_)}, args);
+        break;
+      case Op::LoadField:
+        words.insert(words.end(), {QUACK_VM_LOAD, reg(instr), reg(args[0]), field(instr)});
+        break;
+      case Op::StoreField:
+        words.insert(words.end(), {QUACK_VM_STORE, reg(args[0]), field(instr), reg(args[1])});
+        break;
+      default:
+        throw std::runtime_error(std::string("No bytecode for ") + op_name(instr->op_));
+    }
+  }
+
+  void BytecodeEmitter::emit_block(const BasicBlock * block, const BasicBlock * next) {
+    auto &words = code_.words_;
+    positions_[block] = static_cast<int32_t>(words.size());
+    for (auto * phi : block->phis_)
+      words.insert(words.end(), {QUACK_VM_MOVE, reg(phi), reg(Var(phi, true))});
+
+    for (auto * instr : block->instrs_) {
+      if (instr->is_terminator()) {
+        emit_phi_copies(block);
+        emit_terminator(instr, next);
+        continue;
+      }
+      if (!instr->is_inline() && !is_constant(instr))
+        emit_instr(instr);
+    }
+  }
+
+  void BytecodeEmitter::emit_phi_copies(const BasicBlock * block) {
+    std::set<const BasicBlock*> visited;
+    for (auto * succ : block->succs()) {
+      if (!visited.insert(succ).second)
+        continue;
+      unsigned pred_idx = succ->pred_index(block);
+      for (auto * phi : succ->phis_)
+        code_.words_.insert(code_.words_.end(), {QUACK_VM_MOVE, reg(Var(phi, true)),
+                                                 reg(phi->args_[pred_idx])});
+    }
+  }
+
+  void BytecodeEmitter::emit_terminator(const Instr * term, const BasicBlock * next) {
+    auto &words = code_.words_;
+    switch (term->op_) {
+      case Op::Jump:
+        if (term->targets_[0] == next)
+          break;
+        words.emplace_back(QUACK_VM_JUMP);
+        emit_target(term->targets_[0]);
+        break;
+      case Op::Branch:
+        words.insert(words.end(), {QUACK_VM_BRANCH, reg(term->args_[0])});
+        emit_target(term->targets_[0]);
+        emit_target(term->targets_[1]);
+        break;
+      case Op::Switch:
+        words.insert(words.end(), {QUACK_VM_SWITCH, reg(term->args_[0]),
+                                   static_cast<int32_t>(term->ranges_.size())});
+        for (unsigned i = 0; i < term->ranges_.size(); i++) {
+          words.insert(words.end(), {static_cast<int32_t>(term->ranges_[i].first),
+                                     static_cast<int32_t>(term->ranges_[i].second)});
+          emit_target(term->targets_[i]);
+        }
+        emit_target(term->targets_.back());
+        break;
+      case Op::Return:
+        words.insert(words.end(), {QUACK_VM_RETURN, reg(term->args_[0])});
+        break;
+      default:
+        throw std::runtime_error("Unknown terminator");
+    }
+  }
+
+  void BytecodeEmitter::emit_target(const BasicBlock * target) {
+    fixups_.emplace_back(code_.words_.size(), target);
+    code_.words_.emplace_back(0);
+  }
+}
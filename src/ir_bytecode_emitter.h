@@ -0,0 +1,162 @@
+//
+// Generation of interpreter bytecode from the SSA intermediate representation.
+//
+
+#ifndef TYPE_CHECKER_IR_BYTECODE_EMITTER_H
+#define TYPE_CHECKER_IR_BYTECODE_EMITTER_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ir.h"
+#include "quack_vm.h"
+
+// Forward Declaration
+namespace Quack { class Class; class Method; }
+
+namespace IR {
+  /**
+   * Translates a single function into bytecode for the interpreter in quack_vm.c.  The
+   * bytecode is register based, so each SSA value simply becomes a register: parameters take
+   * the first registers and every other value that is computed gets the next free one.
+   * Constants are loaded into their own registers once at the start of the function.  Phis
+   * use the same incoming register scheme as the CEmitter.
+   */
+  class BytecodeEmitter {
+   public:
+    /** Constant objects shared by all functions in a program */
+    class Constants {
+     public:
+      /**
+       * Index of a boxed Int constant.  It is added if new.
+       *
+       * @param value Value of the Int
+       * @return Constant index
+       */
+      int32_t add(int value);
+      /**
+       * Index of a String constant.  It is added if new.
+       *
+       * @param text Literal text exactly as it appears in the source (i.e., escapes intact)
+       * @return Constant index
+       */
+      int32_t add(const std::string &text);
+      /**
+       * Index of a constant with no value (i.e., none, true, or false).  It is added if new.
+       *
+       * @param kind Kind of the constant
+       * @return Constant index
+       */
+      int32_t add(quack_vm_constant_kind kind);
+      /** Table of all constants added so far */
+      const std::vector<quack_vm_constant> &table() const { return table_; }
+
+     private:
+      int32_t add(quack_vm_constant_kind kind, int value, const std::string &text);
+
+      std::map<std::pair<int, std::pair<int, std::string>>, int32_t> indices_;
+      std::vector<quack_vm_constant> table_;
+      /** Unescaped text of the String constants.  A deque keeps the text from moving. */
+      std::deque<std::string> texts_;
+    };
+
+    /** Bytecode of a function along with the sizes the interpreter needs */
+    struct Code {
+      std::vector<int32_t> words_;
+      unsigned num_params_ = 0;
+      unsigned num_regs_ = 0;
+      unsigned max_args_ = 0;
+    };
+
+    /**
+     * Builds the SSA form of a method, constructor, or main and translates it to bytecode.
+     *
+     * @param constants Constants of the program
+     * @param print_ir If true, the SSA form is printed
+     * @param method Method whose body is generated
+     * @param this_class Class of the implicit object.  nullptr for main.
+     * @param is_constructor True if method is the constructor of this_class
+     * @return Bytecode of the function
+     */
+    static Code generate_function(Constants &constants, bool print_ir, Quack::Method * method,
+                                  Quack::Class * this_class, bool is_constructor);
+
+   private:
+    /** Storage for a value (false) or for the incoming value of a phi (true) */
+    typedef std::pair<const Instr*, bool> Var;
+
+    BytecodeEmitter(Constants &constants, const Function * fn);
+    /** Writes the constant loads and all blocks, then resolves the jump targets */
+    void emit();
+    /**
+     * Register of a variable.  A register is assigned on first use.
+     *
+     * @param var Variable
+     * @return Register index
+     */
+    int32_t reg(const Var &var);
+    /**
+     * Register holding a value.
+     *
+     * @param instr Value
+     * @return Register index
+     */
+    int32_t reg(const Instr * instr) { return reg(Var(instr, false)); }
+    /**
+     * Checks whether a value is a constant loaded at the start of the function.
+     *
+     * @param instr Value to check
+     * @return True if the value is a constant, undefined, or a boxed constant
+     */
+    static bool is_constant(const Instr * instr);
+    /**
+     * Writes the load of a constant into its register.
+     *
+     * @param instr Constant value
+     */
+    void emit_constant(const Instr * instr);
+    /**
+     * Writes a call.  The argument count and registers follow the operands.
+     *
+     * @param operands Opcode followed by the destination and any other operands
+     * @param args Arguments, receiver first
+     */
+    void emit_call(std::vector<int32_t> operands, const std::vector<Instr*> &args);
+    void emit_instr(const Instr * instr);
+    /**
+     * Writes the code for a block.
+     *
+     * @param block Block to write
+     * @param next Block written immediately after.  Jumps to it are omitted.
+     */
+    void emit_block(const BasicBlock * block, const BasicBlock * next);
+    /**
+     * Copies the incoming value of every phi in the successors of a block.
+     *
+     * @param block Predecessor block
+     */
+    void emit_phi_copies(const BasicBlock * block);
+    void emit_terminator(const Instr * term, const BasicBlock * next);
+    /**
+     * Writes a jump target to be filled in once the target block's position is known.
+     *
+     * @param target Block jumped to
+     */
+    void emit_target(const BasicBlock * target);
+
+    Constants &constants_;
+    const Function * fn_;
+    Code code_;
+    /** Register of each variable */
+    std::map<Var, int32_t> regs_;
+    /** Position of each block's first instruction */
+    std::map<const BasicBlock*, int32_t> positions_;
+    /** Words holding jump targets and the blocks they refer to */
+    std::vector<std::pair<size_t, const BasicBlock*>> fixups_;
+  };
+}
+
+#endif //TYPE_CHECKER_IR_BYTECODE_EMITTER_H
@@ -0,0 +1,456 @@
+//
+// Generation of C code from the SSA intermediate representation.
+//
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ir_c_emitter.h"
+#include "ir_builder.h"
+#include "ir_optimizer.h"
+#include "ASTNode.h"
+#include "quack_class.h"
+#include "quack_method.h"
+#include "quack_param.h"
+#include "keywords.h"
+#include "code_gen_utils.h"
+
+namespace IR {
+
+  void CEmitter::generate_body(CodeGen::Settings settings, Quack::Method * method,
+                               Quack::Class * this_class, bool is_constructor) {
+    std::unique_ptr<Function> fn(Builder::build(method, this_class, is_constructor));
+    Optimizer::run(fn.get());
+    if (settings.print_ir_)
+      fn->print(std::cout);
+
+    CEmitter emitter(settings, fn.get());
+    emitter.emit();
+  }
+
+  CEmitter::CEmitter(CodeGen::Settings &settings, const Function * fn)
+      : settings_(settings), fn_(fn), uses_(fn->count_uses()) {
+    for (auto * block : fn_->blocks_)
+      if (!block->preds_.empty())
+        labels_[block] = AST::ASTNode::define_new_label("block");
+    assign_slots();
+  }
+
+  std::vector<CEmitter::Step> CEmitter::block_steps(const BasicBlock * block) const {
+    std::vector<Step> steps;
+    auto add_uses = [this](Step &step, const Instr * instr) {
+      for (auto * arg : instr->args_)
+        if (has_slot(arg))
+          step.uses_.emplace_back(arg, false);
+    };
+
+    for (auto * phi : block->phis_) {
+      Step step;
+      step.uses_.emplace_back(phi, true);
+      step.defs_.emplace_back(phi, false);
+      steps.emplace_back(step);
+    }
+    for (auto * instr : block->instrs_) {
+      if (is_inline(instr))
+        continue;
+      Step step;
+      if (instr->is_terminator()) {
+        // Successor phis are assigned just before the terminator
+        std::set<const BasicBlock*> visited;
+        for (auto * succ : block->succs()) {
+          if (!visited.insert(succ).second)
+            continue;
+          unsigned pred_idx = succ->pred_index(block);
+          for (auto * phi : succ->phis_) {
+            Step copy;
+            if (has_slot(phi->args_[pred_idx]))
+              copy.uses_.emplace_back(phi->args_[pred_idx], false);
+            copy.defs_.emplace_back(phi, true);
+            steps.emplace_back(copy);
+          }
+        }
+      } else if (has_slot(instr)) {
+        step.defs_.emplace_back(instr, false);
+      }
+      add_uses(step, instr);
+      steps.emplace_back(step);
+    }
+    return steps;
+  }
+
+  void CEmitter::assign_slots() {
+    std::map<const BasicBlock*, std::vector<Step>> steps;
+    for (auto * block : fn_->blocks_)
+      steps[block] = block_steps(block);
+
+    // Backward liveness over the blocks until no live-in set changes
+    std::map<const BasicBlock*, std::set<Var>> live_in;
+    auto live_out = [&live_in](const BasicBlock * block) {
+      std::set<Var> live;
+      for (auto * succ : block->succs())
+        live.insert(live_in[succ].begin(), live_in[succ].end());
+      return live;
+    };
+    bool changed;
+    do {
+      changed = false;
+      for (auto itr = fn_->blocks_.rbegin(); itr != fn_->blocks_.rend(); ++itr) {
+        std::set<Var> live = live_out(*itr);
+        const auto &block_steps = steps[*itr];
+        for (auto step = block_steps.rbegin(); step != block_steps.rend(); ++step) {
+          for (const auto &def : step->defs_)
+            live.erase(def);
+          live.insert(step->uses_.begin(), step->uses_.end());
+        }
+        if (live != live_in[*itr]) {
+          live_in[*itr] = live;
+          changed = true;
+        }
+      }
+    } while (changed);
+
+    // A variable interferes with every variable live just after it is written
+    std::map<Var, std::set<Var>> interferes;
+    std::vector<Var> defs;
+    for (auto * block : fn_->blocks_) {
+      std::set<Var> live = live_out(block);
+      const auto &block_steps = steps[block];
+      for (auto step = block_steps.rbegin(); step != block_steps.rend(); ++step) {
+        for (const auto &def : step->defs_) {
+          for (const auto &other : live) {
+            if (other == def)
+              continue;
+            interferes[def].insert(other);
+            interferes[other].insert(def);
+          }
+          live.erase(def);
+        }
+        live.insert(step->uses_.begin(), step->uses_.end());
+      }
+      for (const auto &step : block_steps)
+        defs.insert(defs.end(), step.defs_.begin(), step.defs_.end());
+    }
+
+    for (const auto &var : defs) {
+      const Instr * instr = var.first;
+      std::pair<std::string, bool> slot_type(instr->type_->generated_object_type_name(), true);
+      if (instr->is_native_)
+        slot_type = {instr->type_->generated_unboxed_type_name(), false};
+
+      std::set<unsigned> taken;
+      for (const auto &other : interferes[var]) {
+        auto itr = slots_.find(other);
+        if (itr != slots_.end())
+          taken.insert(itr->second);
+      }
+      unsigned slot = 0;
+      while (slot < slot_types_.size() && (slot_types_[slot] != slot_type || taken.count(slot)))
+        slot++;
+      if (slot == slot_types_.size())
+        slot_types_.emplace_back(slot_type);
+      slots_[var] = slot;
+    }
+  }
+
+  void CEmitter::emit() {
+    std::string indent_str = AST::ASTNode::indent_str(1);
+
+    // Parameters are already declared by the prototype
+    std::vector<std::string> roots;
+    for (auto * param : fn_->params_)
+      roots.emplace_back(value(param));
+
+    // The constructor's object keeps the name the prototype's callers expect
+    for (auto * block : fn_->blocks_) {
+      for (auto * instr : block->instrs_) {
+        if (instr->op_ != Op::Alloc)
+          continue;
+        settings_.fout_ << indent_str << instr->type_->generated_object_type_name() << " "
+                        << value(instr) << " = NULL;\n";
+        roots.emplace_back(value(instr));
+      }
+    }
+    for (unsigned slot = 0; slot < slot_types_.size(); slot++) {
+      const auto &slot_type = slot_types_[slot];
+      settings_.fout_ << indent_str << slot_type.first << " " << slot_name(slot) << " = "
+                      << (slot_type.second ? "NULL" : "0") << ";\n";
+      if (slot_type.second)
+        roots.emplace_back(slot_name(slot));
+    }
+
+    if (!roots.empty()) {
+      settings_.fout_ << indent_str << GENERATED_GC_FRAME << "(" << roots.size() << ");\n";
+      for (unsigned i = 0; i < roots.size(); i++)
+        settings_.fout_ << indent_str << GENERATED_GC_ROOT << "(" << i << ", " << roots[i]
+                        << ");\n";
+    }
+
+    settings_.fout_ << indent_str << "/* Method statements */\n";
+    const auto &blocks = fn_->blocks_;
+    for (unsigned i = 0; i < blocks.size(); i++)
+      emit_block(blocks[i], i + 1 < blocks.size() ? blocks[i + 1] : nullptr);
+  }
+
+  bool CEmitter::is_inline(const Instr * instr) const {
+    if (instr->is_inline())
+      return true;
+    // Boxed literals refer to static objects
+    if (instr->op_ == Op::Box) {
+      Op arg_op = instr->args_[0]->op_;
+      return arg_op == Op::ConstBool
+             || (arg_op == Op::ConstInt && settings_.literal_pool_ != nullptr);
+    }
+    return false;
+  }
+
+  bool CEmitter::needs_var(const Instr * instr) const {
+    if (instr->is_terminator() || instr->op_ == Op::StoreField || is_inline(instr))
+      return false;
+    // Results of calls made only for their effect are discarded
+    if (instr->op_ == Op::Call || instr->op_ == Op::New) {
+      auto itr = uses_.find(instr);
+      return itr != uses_.end() && itr->second != 0;
+    }
+    return true;
+  }
+
+  std::string CEmitter::value(const Instr * instr) const {
+    switch (instr->op_) {
+      case Op::ConstInt:
+        // Parenthesized so negation never forms a decrement
+        if (instr->imm_ < 0)
+          return "(" + std::to_string(instr->imm_) + ")";
+        return std::to_string(instr->imm_);
+      case Op::ConstBool:
+        return instr->imm_ ? "true" : "false";
+      case Op::ConstStr:
+        if (settings_.literal_pool_ == nullptr)
+          return GENERATE_LIT_STRING_FUNC "(\"" + instr->text_ + "\")";
+        return "((" + instr->type_->generated_object_type_name() + ") &"
+               + settings_.literal_pool_->add(instr->text_) + ")";
+      case Op::ConstNone:
+        return GENERATED_LIT_NONE;
+      case Op::Undef:
+        return instr->is_native_ ? "0" : "NULL";
+      case Op::Param:
+        return instr->text_;
+      case Op::Alloc:
+        return OBJECT_SELF;
+      default:
+        break;
+    }
+
+    if (is_inline(instr)) {
+      const Instr * lit = instr->args_[0];
+      if (lit->op_ == Op::ConstBool)
+        return lit->imm_ ? GENERATED_LIT_TRUE : GENERATED_LIT_FALSE;
+      return GENERATED_POOLED_INT_LIT "(" + settings_.literal_pool_->add((int) lit->imm_) + ", "
+             + std::to_string(lit->imm_) + ")";
+    }
+
+    return slot_name(slots_.at(Var(instr, false)));
+  }
+
+  std::string CEmitter::slot_name(unsigned slot) {
+    std::ostringstream ss;
+    ss << TEMP_VAR_HEADER << std::setfill('0') << std::setw(PADDING_WIDTH) << slot;
+    return ss.str();
+  }
+
+  std::string CEmitter::use(const Instr * instr, Quack::Class * as_type) const {
+    std::string expr = value(instr);
+    if (instr->is_native_ || as_type == nullptr || as_type == instr->type_)
+      return expr;
+    return "(" + as_type->generated_object_type_name() + ")" + expr;
+  }
+
+  /**
+   * C operator for a native binary operation.
+   *
+   * @param op Native operation
+   * @return Operator symbol
+   */
+  static const char * c_operator(Op op) {
+    switch (op) {
+      case Op::Add: return "+";
+      case Op::Sub: return "-";
+      case Op::Mul: return "*";
+      case Op::Div: return "/";
+      case Op::Lt: return "<";
+      case Op::Le: return "<=";
+      case Op::Gt: return ">";
+      case Op::Ge: return ">=";
+      case Op::Eq: return "==";
+      default: throw std::runtime_error("Not a native binary operation");
+    }
+  }
+
+  std::string CEmitter::expression(const Instr * instr) const {
+    const auto &args = instr->args_;
+    std::ostringstream ss;
+    switch (instr->op_) {
+      case Op::Add: case Op::Sub: case Op::Mul: case Op::Div:
+      case Op::Lt: case Op::Le: case Op::Gt: case Op::Ge: case Op::Eq:
+        // C lets the compiler assume a divisor is never zero (nor -1 with INT_MIN)
+        if (instr->op_ == Op::Div && (args[1]->op_ != Op::ConstInt || args[1]->imm_ == 0
+                                      || args[1]->imm_ == -1)) {
+          ss << GENERATED_INT_DIVIDE_FUNC "(" << value(args[0]) << ", " << value(args[1]) << ")";
+          break;
+        }
+        ss << value(args[0]) << " " << c_operator(instr->op_) << " " << value(args[1]);
+        break;
+      case Op::Neg:
+        ss << "-" << value(args[0]);
+        break;
+      case Op::Not:
+        ss << "!" << value(args[0]);
+        break;
+      case Op::Box:
+        ss << AST::ASTNode::box_value(instr->type_, value(args[0]));
+        break;
+      case Op::Unbox:
+        ss << AST::ASTNode::unbox_value(instr->type_, use(args[0], instr->type_));
+        break;
+      case Op::New: {
+        Quack::Param::Container * params = instr->class_->get_constructor()->params_;
+        ss << instr->class_->generated_constructor_name() << "(";
+        for (unsigned i = 0; i < args.size(); i++)
+          ss << (i == 0 ? "" : ", ") << use(args[i], (*params)[i]->type_);
+        ss << ")";
+        break;
+      }
+      case Op::Call: {
+        Quack::Method * method = instr->method_;
+        std::string receiver;
+        if (instr->impl_class_ != nullptr) {
+          receiver = use(args[0], method->obj_class_);
+          ss << Quack::Class::generated_method_name(instr->impl_class_, method);
+        } else {
+          // The slot read through the receiver's C type takes the class declaring its method
+          receiver = use(args[0], args[0]->type_->get_method(instr->text_)->obj_class_);
+          ss << AST::ASTNode::clazz_of(instr->class_, value(args[0])) << "->" << instr->text_;
+        }
+        ss << "(" << receiver;
+        for (unsigned i = 1; i < args.size(); i++)
+          ss << ", " << use(args[i], (*method->params_)[i - 1]->type_);
+        ss << ")";
+        break;
+      }
+      case Op::LoadField:
+        ss << "(" << use(args[0], instr->class_) << ")->" << instr->text_;
+        break;
+      default:
+        throw std::runtime_error(std::string("No C expression for ") + op_name(instr->op_));
+    }
+    return ss.str();
+  }
+
+  void CEmitter::emit_block(const BasicBlock * block, const BasicBlock * next) {
+    std::string indent_str = AST::ASTNode::indent_str(1);
+    auto label = labels_.find(block);
+    if (label != labels_.end())
+      AST::ASTNode::generate_label(settings_, 1, label->second, true);
+
+    for (auto * phi : block->phis_)
+      if (value(phi) != incoming_name(phi))
+        settings_.fout_ << indent_str << value(phi) << " = " << incoming_name(phi) << ";\n";
+
+    for (auto * instr : block->instrs_) {
+      if (instr->is_terminator()) {
+        emit_phi_copies(block);
+        emit_terminator(instr, next);
+        continue;
+      }
+      if (is_inline(instr))
+        continue;
+
+      switch (instr->op_) {
+        case Op::Alloc:
+          // Allocate the memory for the object itself then set its methods
+          settings_.fout_ << indent_str << OBJECT_SELF << " = ("
+                          << instr->class_->generated_object_type_name() << ")"
+                          << GENERATED_ALLOC_FUNC << "(sizeof(struct "
+                          << instr->class_->generated_malloc_obj_name() << "));\n"
+                          << indent_str << OBJECT_SELF << "->" << GENERATED_CLASS_FIELD << " = "
+                          << instr->class_->generated_clazz_obj_name() << ";\n";
+          break;
+        case Op::StoreField:
+          settings_.fout_ << indent_str << "(" << use(instr->args_[0], instr->class_) << ")->"
+                          << instr->text_ << " = " << use(instr->args_[1], instr->type_) << ";\n";
+          break;
+        default:
+          settings_.fout_ << indent_str;
+          if (needs_var(instr)) {
+            settings_.fout_ << value(instr) << " = ";
+            if (!instr->is_native_)
+              settings_.fout_ << "(" << instr->type_->generated_object_type_name() << ")";
+          }
+          settings_.fout_ << expression(instr) << ";\n";
+      }
+    }
+  }
+
+  void CEmitter::emit_phi_copies(const BasicBlock * block) {
+    std::string indent_str = AST::ASTNode::indent_str(1);
+    std::set<const BasicBlock*> visited;
+    for (auto * succ : block->succs()) {
+      if (!visited.insert(succ).second)
+        continue;
+      unsigned pred_idx = succ->pred_index(block);
+      for (auto * phi : succ->phis_) {
+        std::string arg = use(phi->args_[pred_idx], phi->type_);
+        if (arg != incoming_name(phi))
+          settings_.fout_ << indent_str << incoming_name(phi) << " = " << arg << ";\n";
+      }
+    }
+  }
+
+  void CEmitter::emit_terminator(const Instr * term, const BasicBlock * next) {
+    std::string indent_str = AST::ASTNode::indent_str(1);
+    switch (term->op_) {
+      case Op::Jump:
+        emit_goto(term->targets_[0], next);
+        break;
+      case Op::Branch:
+        if (term->targets_[0] == next) {
+          settings_.fout_ << indent_str << "if (!" << value(term->args_[0]) << ") { goto "
+                          << labels_.at(term->targets_[1]) << "; }\n";
+          break;
+        }
+        settings_.fout_ << indent_str << "if (" << value(term->args_[0]) << ") { goto "
+                        << labels_.at(term->targets_[0]) << "; }\n";
+        emit_goto(term->targets_[1], next);
+        break;
+      case Op::Switch:
+        settings_.fout_ << indent_str << "switch ("
+                        << AST::ASTNode::clazz_of(term->class_, value(term->args_[0])) << "->"
+                        << GENERATED_CLASS_ID_FIELD << ") {\n";
+        for (unsigned i = 0; i < term->ranges_.size(); i++) {
+          const auto &range = term->ranges_[i];
+          settings_.fout_ << indent_str << "\tcase " << range.first;
+          if (range.second != range.first)
+            settings_.fout_ << " ... " << range.second;
+          settings_.fout_ << ": goto " << labels_.at(term->targets_[i]) << ";\n";
+        }
+        settings_.fout_ << indent_str << "\tdefault: goto " << labels_.at(term->targets_.back())
+                        << ";\n" << indent_str << "}\n";
+        break;
+      case Op::Return:
+        settings_.fout_ << indent_str << "return " << use(term->args_[0], term->type_) << ";\n";
+        break;
+      default:
+        throw std::runtime_error("Unknown terminator");
+    }
+  }
+
+  void CEmitter::emit_goto(const BasicBlock * target, const BasicBlock * next) {
+    if (target != next)
+      AST::ASTNode::generate_goto(settings_, 1, labels_.at(target), true);
+  }
+}
@@ -0,0 +1,162 @@
+//
+// Generation of C code from the SSA intermediate representation.
+//
+
+#ifndef TYPE_CHECKER_IR_C_EMITTER_H
+#define TYPE_CHECKER_IR_C_EMITTER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ir.h"
+
+// Forward Declaration
+namespace Quack { class Class; class Method; }
+namespace CodeGen { struct Settings; }
+
+namespace IR {
+  /**
+   * Writes the body of a single function as C.  Each SSA value that needs storage becomes a
+   * C local and each block becomes a label.  Phis are taken out of SSA form by giving each
+   * phi a second "incoming" local that every predecessor assigns before it jumps; the phi
+   * itself is assigned from it at the start of its block.  This avoids the lost copy and
+   * swap problems without splitting critical edges.
+   *
+   * Values do not each get their own local.  A liveness analysis finds which values (and
+   * incoming phi values) are live at the same time, and values that never are share a local
+   * of the same C type.  This keeps the number of locals close to the number of values live
+   * at once rather than the number of subexpressions.
+   *
+   * As with the AST code generator, every object local is declared at the top of the
+   * function and registered as a garbage collector root.
+   */
+  class CEmitter {
+   public:
+    /**
+     * Builds the SSA form of a method, constructor, or main and writes its C body (i.e.,
+     * everything between the braces of the function).
+     *
+     * @param settings Code generator settings
+     * @param method Method whose body is generated
+     * @param this_class Class of the implicit object.  nullptr for main.
+     * @param is_constructor True if method is the constructor of this_class
+     */
+    static void generate_body(CodeGen::Settings settings, Quack::Method * method,
+                              Quack::Class * this_class, bool is_constructor);
+
+   private:
+    /** Storage for a value (false) or for the incoming value of a phi (true) */
+    typedef std::pair<const Instr*, bool> Var;
+    /** Variable read and variables written by one step of a block, in execution order */
+    struct Step {
+      std::vector<Var> uses_;
+      std::vector<Var> defs_;
+    };
+
+    CEmitter(CodeGen::Settings &settings, const Function * fn);
+    /** Writes the declarations, garbage collector frame, and all blocks */
+    void emit();
+    /**
+     * Checks whether a value is stored in one of the shared locals.
+     *
+     * @param instr Value to check
+     * @return True if the value needs a local other than the implicit object
+     */
+    bool has_slot(const Instr * instr) const {
+      return needs_var(instr) && instr->op_ != Op::Alloc;
+    }
+    /**
+     * Lists the reads and writes of locals in a block in the order the C code performs them:
+     * phis, instructions, the incoming values of successor phis, and the terminator.
+     *
+     * @param block Block to list
+     * @return Steps of the block
+     */
+    std::vector<Step> block_steps(const BasicBlock * block) const;
+    /**
+     * Assigns each variable to a local.  Variables are colored greedily in order of
+     * definition so that no two variables that interfere share a local.
+     */
+    void assign_slots();
+    /**
+     * Name of a shared local.
+     *
+     * @param slot Index of the local
+     * @return Local name
+     */
+    static std::string slot_name(unsigned slot);
+    /**
+     * Checks whether the value is written out in full at each use rather than stored.
+     *
+     * @param instr Value to check
+     * @return True if the value has no C local
+     */
+    bool is_inline(const Instr * instr) const;
+    /**
+     * Checks whether a C local is declared for the value.
+     *
+     * @param instr Value to check
+     * @return True if the value needs a local
+     */
+    bool needs_var(const Instr * instr) const;
+    /**
+     * C expression for a value.
+     *
+     * @param instr Value
+     * @return Name of the value's local or the inline expression
+     */
+    std::string value(const Instr * instr) const;
+    /**
+     * C expression for a value used where an object of the specified type is expected.
+     *
+     * @param instr Value
+     * @param as_type Expected object type.  Ignored for native values.
+     * @return Possibly cast expression
+     */
+    std::string use(const Instr * instr, Quack::Class * as_type) const;
+    /**
+     * C expression computing a non-inline instruction.
+     *
+     * @param instr Instruction that produces a value
+     * @return C expression
+     */
+    std::string expression(const Instr * instr) const;
+    /**
+     * Writes the code for a block.
+     *
+     * @param block Block to write
+     * @param next Block written immediately after.  Jumps to it are omitted.
+     */
+    void emit_block(const BasicBlock * block, const BasicBlock * next);
+    /**
+     * Assigns the incoming local of every phi in the successors of a block.
+     *
+     * @param block Predecessor block
+     */
+    void emit_phi_copies(const BasicBlock * block);
+    void emit_terminator(const Instr * term, const BasicBlock * next);
+    void emit_goto(const BasicBlock * target, const BasicBlock * next);
+    /**
+     * Name of the local that predecessors assign a phi's incoming value to.
+     *
+     * @param phi Phi instruction
+     * @return Local name
+     */
+    std::string incoming_name(const Instr * phi) const {
+      return slot_name(slots_.at(Var(phi, true)));
+    }
+
+    CodeGen::Settings &settings_;
+    const Function * fn_;
+    std::map<const Instr*, unsigned> uses_;
+    std::map<const BasicBlock*, std::string> labels_;
+    /** Local assigned to each variable */
+    std::map<Var, unsigned> slots_;
+    /** C type of each local and whether it holds an object */
+    std::vector<std::pair<std::string, bool>> slot_types_;
+  };
+}
+
+#endif //TYPE_CHECKER_IR_C_EMITTER_H
@@ -0,0 +1,104 @@
+//
+// Interprocedural summary of the fields each method may store to.
+//
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ir_effects.h"
+#include "ir_builder.h"
+#include "quack_class.h"
+#include "quack_method.h"
+#include "keywords.h"
+
+namespace IR {
+
+  std::map<const Quack::Method*, Effects::Summary> Effects::summaries_;
+
+  std::set<std::string> Effects::stored_fields(const Instr * instr) {
+    if (instr->op_ == Op::StoreField)
+      return {instr->text_};
+
+    bool is_constructor;
+    std::set<std::string> fields;
+    for (const auto &target : targets(instr, is_constructor)) {
+      if (!target.first->is_user_class())
+        continue;
+      summarize(target, is_constructor);
+      const auto &callee_fields = summaries_[target.second].fields_;
+      fields.insert(callee_fields.begin(), callee_fields.end());
+    }
+    return fields;
+  }
+
+  std::vector<Effects::Target> Effects::targets(const Instr * instr, bool &is_constructor) {
+    is_constructor = instr->op_ == Op::New;
+    if (is_constructor)
+      return {Target(instr->class_, instr->class_->get_constructor())};
+    if (instr->op_ != Op::Call)
+      return {};
+
+    std::vector<Target> impls;
+    if (instr->impl_class_ != nullptr)
+      impls.emplace_back(instr->impl_class_, instr->method_);
+    else
+      impls = instr->class_->implementations(instr->text_);
+
+    // The builtin PRINT writes the result of the receiver's STR
+    if (instr->text_ == METHOD_PRINT) {
+      std::vector<Target> str_impls = instr->class_->implementations(METHOD_STR);
+      impls.insert(impls.end(), str_impls.begin(), str_impls.end());
+    }
+    return impls;
+  }
+
+  void Effects::summarize(const Target &target, bool is_constructor) {
+    if (summaries_.count(target.second) != 0)
+      return;
+
+    std::vector<std::pair<Target, bool>> pending{{target, is_constructor}};
+    while (!pending.empty()) {
+      Target method = pending.back().first;
+      bool method_is_constructor = pending.back().second;
+      pending.pop_back();
+      if (summaries_.count(method.second) != 0)
+        continue;
+
+      Summary &summary = summaries_[method.second];
+      std::unique_ptr<Function> fn(Builder::build(method.second, method.first,
+                                                  method_is_constructor));
+      for (auto * block : fn->blocks_) {
+        for (auto * instr : block->instrs_) {
+          if (instr->op_ == Op::StoreField)
+            summary.fields_.insert(instr->text_);
+
+          bool callee_is_constructor;
+          for (const auto &callee : targets(instr, callee_is_constructor)) {
+            if (!callee.first->is_user_class())
+              continue;
+            summary.callees_.emplace_back(callee.second);
+            pending.emplace_back(callee, callee_is_constructor);
+          }
+        }
+      }
+    }
+
+    // Propagate the stores of each callee to its callers
+    bool changed;
+    do {
+      changed = false;
+      for (auto &summary_info : summaries_) {
+        Summary &summary = summary_info.second;
+        for (auto * callee : summary.callees_) {
+          unsigned long size = summary.fields_.size();
+          const auto &callee_fields = summaries_[callee].fields_;
+          summary.fields_.insert(callee_fields.begin(), callee_fields.end());
+          changed = changed || size != summary.fields_.size();
+        }
+      }
+    } while (changed);
+  }
+}
@@ -0,0 +1,68 @@
+//
+// Interprocedural summary of the fields each method may store to.
+//
+
+#ifndef TYPE_CHECKER_IR_EFFECTS_H
+#define TYPE_CHECKER_IR_EFFECTS_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ir.h"
+
+// Forward Declaration
+namespace Quack { class Class; class Method; }
+
+namespace IR {
+  /**
+   * Derives from the method bodies which fields a call may change.  Each method reachable from
+   * a call is built into SSA form once and summarized by the names of the fields it stores to
+   * along with the methods it calls.  The stores of the callees are then propagated to their
+   * callers until nothing changes, so recursive methods are handled.  A dynamically dispatched
+   * call may reach any implementation of the method in a subclass of the receiver's type.
+   */
+  class Effects {
+   public:
+    /**
+     * Finds the fields that executing an instruction may change.
+     *
+     * @param instr Any instruction
+     * @return Names of fields possibly stored to by instr or anything it calls
+     */
+    static std::set<std::string> stored_fields(const Instr * instr);
+
+   private:
+    /** Method implementation along with the class that defines it */
+    typedef std::pair<Quack::Class*, Quack::Method*> Target;
+
+    struct Summary {
+      /** Fields stored to by the method or its callees */
+      std::set<std::string> fields_;
+      /** Methods and constructors the method calls */
+      std::vector<Quack::Method*> callees_;
+    };
+    /**
+     * Finds the method implementations an instruction may call.
+     *
+     * @param instr Any instruction
+     * @param is_constructor Set to true if the targets are constructors
+     * @return Called implementations.  Builtin methods are included.
+     */
+    static std::vector<Target> targets(const Instr * instr, bool &is_constructor);
+    /**
+     * Summarizes a method and everything it may call that is not yet summarized.
+     *
+     * @param target Method to summarize
+     * @param is_constructor True if the method is the constructor of the target class
+     */
+    static void summarize(const Target &target, bool is_constructor);
+
+    /** Summary of each user method and constructor seen so far */
+    static std::map<const Quack::Method*, Summary> summaries_;
+  };
+}
+
+#endif //TYPE_CHECKER_IR_EFFECTS_H
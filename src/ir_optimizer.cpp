@@ -0,0 +1,328 @@
+//
+// Optimization passes over the SSA intermediate representation.
+//
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ir_optimizer.h"
+#include "ir_effects.h"
+#include "quack_class.h"
+#include "quack_method.h"
+#include "quack_param.h"
+#include "keywords.h"
+
+namespace IR {
+
+  /**
+   * Checks whether an instruction is a call to a builtin method that only computes its
+   * result.  Every builtin method other than PRINT is pure.
+   *
+   * @param instr Instruction to check
+   * @return True if the call can be removed or reused
+   */
+  static bool is_pure_call(const Instr * instr) {
+    return instr->op_ == Op::Call && instr->impl_class_ != nullptr
+           && !instr->impl_class_->is_user_class() && instr->method_->name_ != METHOD_PRINT;
+  }
+  /**
+   * Checks whether an instruction always produces the same value from the same operands.
+   *
+   * @param instr Instruction to check
+   * @return True if the instruction can be replaced by an earlier equivalent one
+   */
+  static bool is_pure(const Instr * instr) {
+    switch (instr->op_) {
+      case Op::ConstInt: case Op::ConstBool: case Op::ConstStr: case Op::ConstNone:
+      case Op::Add: case Op::Sub: case Op::Mul: case Op::Div:
+      case Op::Lt: case Op::Le: case Op::Gt: case Op::Ge: case Op::Eq:
+      case Op::Neg: case Op::Not: case Op::Box: case Op::Unbox:
+      case Op::LoadField:
+        return true;
+      case Op::Call:
+        return is_pure_call(instr);
+      default:
+        return false;
+    }
+  }
+  /** Identifies the value computed by a pure instruction or held by a field */
+  typedef std::tuple<Op, Quack::Class*, bool, long, std::string, Quack::Class*,
+                     Quack::Method*, Quack::Class*, std::vector<Instr*>> ValueKey;
+
+  /**
+   * Builds the key of the value an available instruction provides.  A field is identified by
+   * its name and object alone since the static types used to access it may differ.
+   *
+   * @param instr Pure instruction or field store
+   * @return Key equal for any two instructions that provide the same value
+   */
+  static ValueKey value_key(const Instr * instr) {
+    if (instr->op_ == Op::LoadField || instr->op_ == Op::StoreField)
+      return ValueKey(Op::LoadField, nullptr, false, 0, instr->text_, nullptr, nullptr, nullptr,
+                      {instr->args_[0]});
+    return ValueKey(instr->op_, instr->type_, instr->is_native_, instr->imm_, instr->text_,
+                    instr->class_, instr->method_, instr->impl_class_, instr->args_);
+  }
+  /**
+   * Value an available instruction provides.
+   *
+   * @param instr Pure instruction or field store
+   * @return The stored value for a store, otherwise the instruction itself
+   */
+  static Instr * available_value(Instr * instr) {
+    return instr->op_ == Op::StoreField ? instr->args_[1] : instr;
+  }
+  /**
+   * Updates the set of available instructions to account for an instruction executing.
+   *
+   * @param instr Instruction executed
+   * @param available Instructions whose values are available before and after instr
+   */
+  static void transfer(Instr * instr, std::set<Instr*> &available) {
+    std::set<std::string> stored = Effects::stored_fields(instr);
+    for (auto itr = available.begin(); !stored.empty() && itr != available.end(); ) {
+      Op op = (*itr)->op_;
+      bool is_field = op == Op::LoadField || op == Op::StoreField;
+      if (is_field && stored.count((*itr)->text_) != 0)
+        itr = available.erase(itr);
+      else
+        ++itr;
+    }
+    if (is_pure(instr) || instr->op_ == Op::StoreField)
+      available.insert(instr);
+  }
+
+  /**
+   * Checks whether a pure instruction may be executed even where it was not originally
+   * reached.
+   *
+   * @param instr Pure instruction
+   * @return True if the instruction cannot trap and its operands have the types it expects
+   *         wherever they are defined
+   */
+  static bool can_speculate(const Instr * instr) {
+    switch (instr->op_) {
+      case Op::Div:
+        return false;
+      case Op::Unbox:
+        return instr->args_[0]->type_->is_subtype(instr->type_);
+      case Op::LoadField:
+        return instr->args_[0]->type_->has_field(instr->text_);
+      case Op::Call: {
+        if (instr->method_->name_ == METHOD_DIVIDE
+            || !instr->args_[0]->type_->is_subtype(instr->impl_class_))
+          return false;
+        for (unsigned i = 1; i < instr->args_.size(); i++)
+          if (!instr->args_[i]->type_->is_subtype((*instr->method_->params_)[i - 1]->type_))
+            return false;
+        return true;
+      }
+      default:
+        return true;
+    }
+  }
+  /**
+   * Finds the blocks of the natural loop with the specified header.
+   *
+   * @param header Possible loop header
+   * @param idoms Immediate dominators of the function's blocks
+   * @return Blocks that can reach a back edge to header without passing through it.  Empty if
+   *         header has no back edges.
+   */
+  static std::set<BasicBlock*> loop_body(BasicBlock * header,
+                                         const std::map<const BasicBlock*, BasicBlock*> &idoms) {
+    std::vector<BasicBlock*> pending;
+    for (auto * pred : header->preds_)
+      if (Function::dominates(idoms, header, pred))
+        pending.emplace_back(pred);
+    if (pending.empty())
+      return {};
+
+    std::set<BasicBlock*> body{header};
+    while (!pending.empty()) {
+      BasicBlock * block = pending.back();
+      pending.pop_back();
+      if (body.insert(block).second)
+        pending.insert(pending.end(), block->preds_.begin(), block->preds_.end());
+    }
+    return body;
+  }
+  /**
+   * Finds or creates the block that runs once before a loop.
+   *
+   * @param fn Function containing the loop
+   * @param header Loop header
+   * @param body Blocks in the loop
+   * @return Block whose only successor is header and which is the only predecessor of header
+   *         outside the loop.  nullptr if the loop is entered from several blocks.
+   */
+  static BasicBlock * make_preheader(Function * fn, BasicBlock * header,
+                                     const std::set<BasicBlock*> &body) {
+    std::vector<BasicBlock*> entries;
+    for (auto * pred : header->preds_)
+      if (body.count(pred) == 0)
+        entries.emplace_back(pred);
+    if (entries.size() != 1)
+      return nullptr;
+
+    BasicBlock * entry = entries[0];
+    Instr * term = entry->terminator();
+    if (term->op_ == Op::Jump)
+      return entry;
+    if (std::count(term->targets_.begin(), term->targets_.end(), header) != 1)
+      return nullptr;
+
+    // Split the edge into the loop.  Header phis keep their argument order.
+    BasicBlock * preheader = fn->new_block();
+    Instr * jump = fn->new_instr(Op::Jump, nullptr, false);
+    jump->block_ = preheader;
+    jump->targets_ = {header};
+    preheader->instrs_.emplace_back(jump);
+    preheader->preds_.emplace_back(entry);
+    std::replace(term->targets_.begin(), term->targets_.end(), header, preheader);
+    header->preds_[header->pred_index(entry)] = preheader;
+    return preheader;
+  }
+
+  void Optimizer::run(Function * fn) {
+    eliminate_common_subexpressions(fn);
+    hoist_loop_invariants(fn);
+    fn->remove_dead_instrs();
+  }
+
+  void Optimizer::eliminate_common_subexpressions(Function * fn) {
+    std::vector<BasicBlock*> order = fn->reverse_post_order();
+
+    // Instructions available at the end of each block.  A block missing from the map has not
+    // been visited yet and is treated as making every instruction available.
+    std::map<BasicBlock*, std::set<Instr*>> avail_out;
+    auto avail_in = [&avail_out, fn](BasicBlock * block) {
+      std::set<Instr*> available;
+      if (block == fn->entry_)
+        return available;
+      bool first = true;
+      for (auto * pred : block->preds_) {
+        auto itr = avail_out.find(pred);
+        if (itr == avail_out.end())
+          continue;
+        if (first) {
+          available = itr->second;
+          first = false;
+          continue;
+        }
+        std::set<Instr*> both;
+        for (auto * instr : available)
+          if (itr->second.count(instr) != 0)
+            both.insert(instr);
+        available.swap(both);
+      }
+      return available;
+    };
+
+    bool changed;
+    do {
+      changed = false;
+      for (auto * block : order) {
+        std::set<Instr*> available = avail_in(block);
+        for (auto * instr : block->instrs_)
+          transfer(instr, available);
+        auto itr = avail_out.find(block);
+        if (itr == avail_out.end() || itr->second != available) {
+          avail_out[block] = available;
+          changed = true;
+        }
+      }
+    } while (changed);
+
+    // Any instruction available on every path to a block is defined on every path, so it
+    // dominates the block and can replace an equivalent instruction there
+    for (auto * block : order) {
+      std::set<Instr*> available = avail_in(block);
+      std::map<ValueKey, Instr*> values;
+      for (auto * instr : available)
+        if (!instr->is_removed_)
+          values[value_key(instr)] = available_value(instr);
+
+      std::vector<Instr*> instrs;
+      for (auto * instr : block->instrs_) {
+        // Unboxing a value just boxed gives back the native value
+        Instr * boxed = instr->op_ == Op::Unbox ? instr->args_[0] : nullptr;
+        if (boxed != nullptr && boxed->op_ == Op::Box && boxed->type_ == instr->type_) {
+          fn->replace_all_uses(instr, boxed->args_[0]);
+          instr->is_removed_ = true;
+          continue;
+        }
+        if (is_pure(instr)) {
+          auto itr = values.find(value_key(instr));
+          if (itr != values.end()) {
+            fn->replace_all_uses(instr, itr->second);
+            instr->is_removed_ = true;
+            continue;
+          }
+        }
+        instrs.emplace_back(instr);
+
+        transfer(instr, available);
+        if (!Effects::stored_fields(instr).empty()) {
+          // Loads may have been invalidated so rebuild the values from what remains
+          values.clear();
+          for (auto * avail : available)
+            if (!avail->is_removed_)
+              values[value_key(avail)] = available_value(avail);
+        } else if (is_pure(instr)) {
+          values[value_key(instr)] = instr;
+        }
+      }
+      block->instrs_ = instrs;
+    }
+  }
+
+  void Optimizer::hoist_loop_invariants(Function * fn) {
+    // Inner loop headers come later in reverse postorder
+    std::vector<BasicBlock*> headers = fn->reverse_post_order();
+    std::reverse(headers.begin(), headers.end());
+    for (auto * header : headers) {
+      std::set<BasicBlock*> body = loop_body(header, fn->immediate_dominators());
+      if (body.empty())
+        continue;
+      BasicBlock * preheader = make_preheader(fn, header, body);
+      if (preheader == nullptr)
+        continue;
+
+      std::set<std::string> stored;
+      for (auto * block : body) {
+        for (auto * instr : block->instrs_) {
+          std::set<std::string> fields = Effects::stored_fields(instr);
+          stored.insert(fields.begin(), fields.end());
+        }
+      }
+
+      // Operands are defined before their uses in reverse postorder, so an instruction whose
+      // operands were all hoisted is seen after them
+      for (auto * block : fn->reverse_post_order()) {
+        if (body.count(block) == 0)
+          continue;
+
+        std::vector<Instr*> instrs;
+        for (auto * instr : block->instrs_) {
+          bool is_invariant = is_pure(instr) && can_speculate(instr)
+                              && (instr->op_ != Op::LoadField || stored.count(instr->text_) == 0);
+          for (auto * arg : instr->args_)
+            is_invariant = is_invariant && body.count(arg->block_) == 0;
+          if (!is_invariant) {
+            instrs.emplace_back(instr);
+            continue;
+          }
+          instr->block_ = preheader;
+          preheader->instrs_.insert(preheader->instrs_.end() - 1, instr);
+        }
+        block->instrs_ = instrs;
+      }
+    }
+    fn->remove_unreachable_blocks();
+  }
+}
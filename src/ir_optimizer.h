@@ -0,0 +1,48 @@
+//
+// Optimization passes over the SSA intermediate representation.
+//
+
+#ifndef TYPE_CHECKER_IR_OPTIMIZER_H
+#define TYPE_CHECKER_IR_OPTIMIZER_H
+
+#include "ir.h"
+
+namespace IR {
+  /**
+   * Rewrites a function built by the Builder into an equivalent but cheaper one.  Each pass
+   * leaves the function in valid SSA form so passes can run in any order.
+   */
+  class Optimizer {
+   public:
+    /**
+     * Runs every pass over the function.
+     *
+     * @param fn Function to optimize
+     */
+    static void run(Function * fn);
+    /**
+     * Replaces each pure instruction that recomputes a value already available on every
+     * path to it with that value.  Pure instructions are the native operations, boxing,
+     * constants, calls to builtin methods other than PRINT, and field loads.  A field load is
+     * only available until a store to a field of the same name or a call that may store to
+     * it; a store makes the stored value available to later loads of the same field.  Unboxing
+     * a value that was just boxed is also replaced by the native value.
+     *
+     * @param fn Function to optimize
+     */
+    static void eliminate_common_subexpressions(Function * fn);
+    /**
+     * Moves pure instructions whose operands do not change within a loop into a preheader
+     * block that runs once before the loop.  Loops are found from the back edges of the
+     * dominator tree and processed innermost first, so an invariant can move out of several
+     * nested loops.  A field load only moves if nothing in the loop may store to the field.
+     * Since the loop body may never run, instructions that can trap (i.e., division) or that
+     * rely on a type test within the loop stay in place.
+     *
+     * @param fn Function to optimize
+     */
+    static void hoist_loop_invariants(Function * fn);
+  };
+}
+
+#endif //TYPE_CHECKER_IR_OPTIMIZER_H
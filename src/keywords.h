@@ -55,20 +55,42 @@
 
 //#define STRUCT_TYPE_SUFFIX "_struct"
 #define GENERATED_CLASS_FIELD "clazz"
+#define GENERATED_CLASS_OF_FUNC "QUACK_CLAZZ"
+#define GENERATED_INT_VALUE_FUNC "QUACK_INT_VALUE"
+#define GENERATED_INT_DIVIDE_FUNC "quack_int_divide"
 #define TEMP_VAR_HEADER "__temp_var_"
+#define LIT_POOL_INT_HEADER "__lit_int_"
+#define LIT_POOL_STR_HEADER "__lit_str_"
+#define STACK_OBJ_HEADER "__stack_"
+#define EMBEDDED_HEADER_FIELD "__header_"
+#define GENERATED_EMBEDDED_HEADER "QUACK_EMBEDDED_HEADER"
 
 #define GENERATE_LIT_INT_FUNC "int_literal"
 #define GENERATE_LIT_STRING_FUNC "str_literal"
 #define GENERATE_LIT_BOOL_FUNC "bool_literal"
+#define GENERATED_POOLED_INT_LIT "QUACK_INT_LIT"
+#define GENERATED_ALLOC_FUNC "quack_alloc"
+#define GENERATED_GC_FRAME "QUACK_GC_FRAME"
+#define GENERATED_GC_ROOT "QUACK_GC_ROOT"
 
 #define GENERATED_LIT_TRUE "lit_true"
 #define GENERATED_LIT_FALSE "lit_false"
 
 #define GENERATED_LIT_NONE "none"
 
+#define GENERATED_UNBOXED_INT "int"
+#define GENERATED_UNBOXED_BOOL "bool"
+
 #define GENERATED_NO_JUMP ""
 
-#define GENERATED_IS_SUBTYPE_FUNC "is_subtype"
 #define GENERATED_SUPER_FIELD "super_"
+#define GENERATED_REF_OFFSETS_FIELD "ref_offsets_"
+#define GENERATED_CLASS_ID_FIELD "class_id_"
+#define GENERATED_SUBTREE_END_FIELD "subtree_end_"
+#define GENERATED_CLASS_IN_RANGE "QUACK_CLASS_IN_RANGE"
+
+#define GENERATED_PROFILE_COUNTS "quack_profile_counts"
+#define GENERATED_PROFILE_WRITE_FUNC "quack_profile_write"
+#define PROFILE_FILE_HEADER "quack-profile 1"
 
 #endif //PROJECT02_KEYWORDS_H
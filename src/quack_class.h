@@ -8,6 +8,7 @@
 #include <map>
 #include <cstring>
 #include <vector>
+#include <sstream>
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
@@ -17,18 +18,28 @@
 #include "quack_method.h"
 #include "quack_field.h"
 #include "keywords.h"
+#include "ir_c_emitter.h"
 
 // Forward declaration
-namespace CodeGen{ class Gen; }
+namespace CodeGen{ class Gen; class AsmGen; class BytecodeGen; }
 
 namespace Quack {
 
   // Forward declaration
   class TypeChecker;
+  class ConstantFolder;
+  class EscapeAnalysis;
+  class Reachability;
 
   class Class {
     friend class TypeChecker;
+    friend class ConstantFolder;
+    friend class EscapeAnalysis;
+    friend class Reachability;
     friend class CodeGen::Gen;
+    friend class CodeGen::AsmGen;
+    friend class CodeGen::BytecodeGen;
+    friend class IR::CEmitter;
    public:
 
     class Container : public MapContainer<Class> {
@@ -161,6 +172,40 @@ namespace Quack {
         return true;
       return false;
     }
+    /**
+     * Checks whether a field is stored as a native int or bool in generated objects rather than
+     * as a reference.  This depends only on the field's type in the class that first declares
+     * it, so the field has the same layout in the objects of all subclasses.
+     *
+     * @param name Field name
+     * @return True if the field is unboxed
+     */
+    bool is_unboxed_field(const std::string &name) {
+      Field * field = field_owner(name)->fields_->get(name);
+      return field != OBJECT_NOT_FOUND && field->type_ != nullptr && field->type_->is_unboxable();
+    }
+    /**
+     * Class of the object embedded in place of a field, if object inlining found one.  Like
+     * unboxing, this is decided once for the class that first declares the field.
+     *
+     * @param name Field name
+     * @return Embedded class or nullptr if the field is a reference
+     */
+    Class * inline_field_class(const std::string &name) {
+      Field * field = field_owner(name)->fields_->get(name);
+      return field != OBJECT_NOT_FOUND ? field->inline_class_ : nullptr;
+    }
+    /**
+     * Finds the class that first declares a field, i.e., the root-most class that has it.
+     *
+     * @param name Field name
+     * @return Declaring class.  This class if no super class has the field.
+     */
+    Class * field_owner(const std::string &name) {
+      if (super_ && super_->has_field(name))
+        return super_->field_owner(name);
+      return this;
+    }
     /**
      * Checks if this class (or any of its super classes) has the specified method.
      *
@@ -334,6 +379,85 @@ namespace Quack {
       }
       return false;
     }
+    /**
+     * Class hierarchy analysis.  Considering every class in the program, finds the implementation
+     * of a method reached by any receiver whose static type is this class.
+     *
+     * @param method_name Name of the method being called
+     * @return Class that defines the implementation and the implementation itself if all
+     *         subclasses share a single implementation.  Otherwise, {nullptr, nullptr}.
+     */
+    std::pair<Class*, Method*> unique_implementation(const std::string &method_name) {
+      std::pair<Class*, Method*> impl(nullptr, nullptr);
+      for (const auto &class_pair : *Container::singleton()) {
+        Class * q_class = class_pair.second;
+        if (!q_class->is_subtype(this))
+          continue;
+
+        for (const auto &method_info : *build_generated_methods(q_class)) {
+          if (method_info.second->name_ != method_name)
+            continue;
+          if (impl.second != nullptr && impl.second != method_info.second)
+            return {nullptr, nullptr};
+          impl = method_info;
+          break;
+        }
+      }
+      return impl;
+    }
+    /**
+     * Class hierarchy analysis.  Considering every class in the program, finds every
+     * implementation of a method that a receiver whose static type is this class may reach.
+     *
+     * @param method_name Name of the method being called
+     * @return Each distinct implementation and the class that defines it
+     */
+    std::vector<std::pair<Class*, Method*>> implementations(const std::string &method_name) {
+      std::vector<std::pair<Class*, Method*>> impls;
+      for (const auto &class_pair : *Container::singleton()) {
+        Class * q_class = class_pair.second;
+        if (!q_class->is_subtype(this))
+          continue;
+
+        for (const auto &method_info : *build_generated_methods(q_class)) {
+          if (method_info.second->name_ != method_name)
+            continue;
+          auto same = [&method_info](const std::pair<Class*, Method*> &impl) {
+            return impl.second == method_info.second;
+          };
+          if (std::none_of(impls.begin(), impls.end(), same))
+            impls.emplace_back(method_info);
+          break;
+        }
+      }
+      return impls;
+    }
+    /** Preorder number of the class in the class hierarchy */
+    unsigned class_id_ = 0;
+    /** Largest preorder number of any class that is a subclass of this class */
+    unsigned subtree_end_ = 0;
+    /**
+     * Numbers all classes in preorder starting from Obj.  A class's subclasses (including
+     * itself) are then exactly those classes whose IDs are in [class_id_, subtree_end_].
+     * Subclasses are visited in name order so the numbering is deterministic.
+     */
+    static void number_classes() {
+      unsigned next_id = 0;
+      number_subtree(Container::Obj(), next_id);
+    }
+    /**
+     * Helper function that numbers a class and then all of its subclasses.
+     *
+     * @param q_class Root of the subtree to number
+     * @param next_id Next unused class ID
+     */
+    static void number_subtree(Class * q_class, unsigned &next_id) {
+      q_class->class_id_ = next_id++;
+      for (const auto &class_pair : *Container::singleton())
+        if (class_pair.second->super_ == q_class)
+          number_subtree(class_pair.second, next_id);
+      q_class->subtree_end_ = next_id - 1;
+    }
     /**
      * Performs an initial type check and configuration for the class's super class as well
      * as for the method parameters, return types, and constructor parameters.
@@ -373,6 +497,26 @@ namespace Quack {
     static std::string generated_method_name(Class* q_class, Method * method) {
       return q_class->name_ + "_method_" + method->name_;
     }
+    /**
+     * Position of a method in the generated method table.  A method has the same position in
+     * the tables of all subclasses.
+     *
+     * @param method_name Name of the method
+     * @return Index of the method in the table
+     */
+    unsigned generated_method_index(const std::string &method_name) {
+      return generated_index(*build_generated_methods(this), method_name);
+    }
+    /**
+     * Position of a field in the generated object struct, not counting the clazz.  A field has
+     * the same position in the objects of all subclasses.
+     *
+     * @param field_name Name of the field
+     * @return Index of the field in the struct
+     */
+    unsigned generated_field_index(const std::string &field_name) {
+      return generated_index(*build_generated_fields(this), field_name);
+    }
 //    /**
 //     * Accessor for all the methods in the class.
 //     * @return Methods in the class.
@@ -410,6 +554,13 @@ namespace Quack {
      * @return True if the class is abase class.
      */
     virtual bool is_user_class() const { return true; }
+    /**
+     * Checks whether code reachable from main may use the class.  Unreachable classes are not
+     * generated.
+     *
+     * @return True unless dead code analysis found the class unused
+     */
+    bool is_reachable() const { return is_reachable_; }
     /**
      * Accessor for the class constructor.
      *
@@ -423,6 +574,39 @@ namespace Quack {
     const std::string generated_object_type_name() const {
       return "obj_" + name_;
     }
+    /**
+     * Checks whether objects of this class can be stored as a native C value (i.e., int or bool)
+     * in the generated code.  This requires the class be Int or Boolean and that no class
+     * extends it; otherwise the static type would not prove the exact type of the object.
+     *
+     * @return True if objects of this class can be unboxed.
+     */
+    bool is_unboxable() {
+      if (this != Container::Int() && this != Container::Bool())
+        return false;
+      for (const auto &class_pair : *Container::singleton())
+        if (class_pair.second->super_ == this)
+          return false;
+      return true;
+    }
+    /**
+     * Checks whether a reference of this type may hold a runtime tagged Int.  Such references
+     * cannot have their clazz field read directly.
+     *
+     * @return True if Int is a subtype of this class
+     */
+    bool may_hold_tagged_int() {
+      return Container::Int()->is_subtype(this);
+    }
+    /**
+     * Native C type used for unboxed objects of this type.  Only valid for unboxable classes.
+     *
+     * @return Native C type name
+     */
+    const std::string generated_unboxed_type_name() {
+      assert(is_unboxable());
+      return (this == Container::Int()) ? GENERATED_UNBOXED_INT : GENERATED_UNBOXED_BOOL;
+    }
     /**
      * Type used to for the clazz field of objects of this type.
      *
@@ -447,6 +631,15 @@ namespace Quack {
     const std::string generated_constructor_name() const {
       return "new_" + name_;
     }
+    /**
+     * Gets the name of the constructor variant that initializes an object already allocated by
+     * the caller (e.g., on the C stack) instead of allocating one.
+     *
+     * @return In place constructor function name
+     */
+    const std::string generated_init_name() const {
+      return "init_" + name_;
+    }
     /**
      * Gets the name of the struct object used to store the clazz information include super class.
      * This function is used in typecase statements and in the generated class definitions.
@@ -497,6 +690,9 @@ namespace Quack {
       std::string indent = AST::ASTNode::indent_str(1);
       settings.fout_ << "\n" << indent << Container::Obj()->generated_clazz_type_name() << " "
                      << GENERATED_SUPER_FIELD << ";";
+      settings.fout_ << "\n" << indent << "const size_t * " << GENERATED_REF_OFFSETS_FIELD << ";";
+      settings.fout_ << "\n" << indent << "unsigned " << GENERATED_CLASS_ID_FIELD << ";"
+                     << "\n" << indent << "unsigned " << GENERATED_SUBTREE_END_FIELD << ";";
 
       settings.fout_ << "\n" << indent << generated_object_type_name()
                      << " (*" << METHOD_CONSTRUCTOR << ")(";
@@ -533,9 +729,19 @@ namespace Quack {
 
       build_generated_fields(this);
       for (auto field_info : *gen_fields_) {
-        settings.fout_ << "\n" << AST::ASTNode::indent_str(1)
-                       << field_info.second->type_->generated_object_type_name() << " "
-                       << field_info.second->name_ << ";";
+        const std::string &name = field_info.second->name_;
+        Class * field_type = field_info.second->type_;
+        settings.fout_ << "\n" << AST::ASTNode::indent_str(1);
+        // An embedded object is preceded by a header so the collector knows not to mark it
+        if (Class * inline_class = inline_field_class(name)) {
+          settings.fout_ << "size_t " << EMBEDDED_HEADER_FIELD << name << ";\n"
+                         << AST::ASTNode::indent_str(1) << "struct "
+                         << inline_class->generated_malloc_obj_name() << " " << name << ";";
+          continue;
+        }
+        settings.fout_ << (is_unboxed_field(name) ? field_type->generated_unboxed_type_name()
+                                                  : field_type->generated_object_type_name())
+                       << " " << name << ";";
       }
       settings.fout_ << "\n} * " << generated_object_type_name() << ";\n";
     }
@@ -557,23 +763,29 @@ namespace Quack {
      *
      * @param settings Code generator constructor
      * @param method Method whose prototype will be generated.
+     * @param in_place True for the constructor variant that takes the object to initialize
      */
     void generate_method_prototype(CodeGen::Settings settings, Method* method,
-                                   bool is_constructor=false) {
+                                   bool is_constructor=false, bool in_place=false) {
+      if (settings.amalgamate_)
+        settings.fout_ << "static ";
       settings.fout_ << method->return_type_->generated_object_type_name() << " ";
 
-      if (is_constructor)
+      if (in_place)
+        settings.fout_ << generated_init_name();
+      else if (is_constructor)
         settings.fout_ << generated_constructor_name();
       else
         settings.fout_ << generated_method_name(this, method);
 
       settings.fout_ << "(";
 
-      if (!is_constructor) {
+      bool has_this = !is_constructor || in_place;
+      if (has_this) {
         settings.fout_ << generated_object_type_name() << " " << OBJECT_SELF;
       }
 
-      method->params_->generate_code(settings, true, !is_constructor);
+      method->params_->generate_code(settings, true, has_this);
       settings.fout_ << ")";
     }
     /**
@@ -584,14 +796,74 @@ namespace Quack {
     void generate_all_prototypes(CodeGen::Settings settings) {
       settings.fout_ << "\n";
 
-      generate_method_prototype(settings, constructor_, true);
-      settings.fout_ << ";\n";
+      if (constructor_->is_reachable_) {
+        generate_method_prototype(settings, constructor_, true);
+        settings.fout_ << ";\n";
+      }
+      if (has_in_place_constructor(settings)) {
+        generate_method_prototype(settings, constructor_, true, true);
+        settings.fout_ << ";\n";
+      }
 
       for (const auto &method : *methods_) {
+        if (!method.second->is_reachable_)
+          continue;
         generate_method_prototype(settings, method.second);
         settings.fout_ << ";\n";
       }
     }
+    /**
+     * Checks whether the constructor variant that initializes an existing object is generated.
+     *
+     * @param settings Code generator settings
+     * @return True if some object of the class is on the stack or embedded in another object
+     */
+    bool has_in_place_constructor(const CodeGen::Settings &settings) const {
+      return has_stack_constructor_ && !settings.use_ir_ && constructor_->is_reachable_;
+    }
+    /**
+     * Name of the array listing the offsets of the reference fields in an object of this class.
+     *
+     * @return Name of the reference offsets array
+     */
+    const std::string generated_ref_offsets_name() const {
+      return "obj_" + name_ + "_ref_offsets";
+    }
+    /**
+     * Lists the reference fields of objects of this class as C member designators.  The
+     * reference fields of embedded objects are listed in place of the embedded object.
+     *
+     * @param prefix Designator of the object containing the fields (e.g., "outer.")
+     * @param ref_fields Where the designators are appended
+     */
+    void generated_ref_fields(const std::string &prefix, std::vector<std::string> &ref_fields) {
+      for (auto field_info : *build_generated_fields(this)) {
+        const std::string &name = field_info.second->name_;
+        Class * inline_class = inline_field_class(name);
+        if (inline_class != nullptr)
+          inline_class->generated_ref_fields(prefix + name + ".", ref_fields);
+        else if (!is_unboxed_field(name))
+          ref_fields.emplace_back(prefix + name);
+      }
+    }
+    /**
+     * Generates the zero terminated array of reference field offsets the garbage collector uses
+     * to trace objects of this class.  The clazz field and unboxed fields are never included.
+     *
+     * @param settings Code generator settings
+     */
+    void generate_ref_offsets(CodeGen::Settings settings) {
+      settings.fout_ << "\nstatic const size_t " << generated_ref_offsets_name() << "[] = {";
+
+      std::string indent_str = AST::ASTNode::indent_str(1);
+      std::vector<std::string> ref_fields;
+      generated_ref_fields("", ref_fields);
+      for (const auto &ref_field : ref_fields) {
+        settings.fout_ << "\n" << indent_str << "offsetof(struct " << generated_malloc_obj_name()
+                       << ", " << ref_field << "),";
+      }
+      settings.fout_ << "\n" << indent_str << "0\n};\n";
+    }
     /**
      * The "Clazz" object contains a lookup of all the methods in the class itself. This is
      * attached as a field in the constructor.
@@ -601,6 +873,8 @@ namespace Quack {
     void generate_clazz_object(CodeGen::Settings settings) {
       std::string class_obj_struct = generated_clazz_obj_struct_name();
 
+      generate_ref_offsets(settings);
+
       settings.fout_ << "\nstruct " << generated_struct_clazz_name() << " "
                      << class_obj_struct << " = {";
 
@@ -611,13 +885,19 @@ namespace Quack {
       settings.fout_ << "\n" << indent_str
                      << "(" << Quack::Class::Container::Obj()->generated_clazz_type_name() << ")"
                      << "&" << super_obj_struct;
+      settings.fout_ << ",\n" << indent_str << generated_ref_offsets_name();
+      settings.fout_ << ",\n" << indent_str << class_id_ << ", " << subtree_end_;
 
-      settings.fout_ << ",\n" << indent_str << generated_constructor_name();
+      // Methods that can never be called are not generated
+      settings.fout_ << ",\n" << indent_str
+                     << (constructor_->is_reachable_ ? generated_constructor_name() : "NULL");
 
       build_generated_methods(this);
       for (auto method_info : *gen_methods_) {
         settings.fout_ << ",\n" << indent_str
-                       << generated_method_name(method_info.first, method_info.second);
+                       << (method_info.second->is_reachable_
+                           ? generated_method_name(method_info.first, method_info.second)
+                           : "NULL");
       }
 
       settings.fout_ << "\n};\n\n"
@@ -625,14 +905,17 @@ namespace Quack {
                      << " = &" << class_obj_struct << ";";
     }
     /**
-     * Generates code defining all non-fields and non-implicit parameters in a method.
+     * Generates code defining all non-fields and non-implicit parameters in a method.  Symbols
+     * whose type is exactly Int or Boolean are declared as native C locals.  A local whose
+     * object is stack allocated also gets a zeroed struct for the object, and the struct's
+     * fields become roots since the collector only traces objects on the heap.
      *
      * @param settings Code generator settings
      * @param indent_lvl Indentation level.
      * @param st Symbol table containing the symbols in a method
      */
     static void generate_symbol_table(CodeGen::Settings settings, unsigned indent_lvl,
-                                      Method * method) {
+                                      Method * method, std::vector<std::string> &roots) {
       std::string indent_str = AST::ASTNode::indent_str(indent_lvl);
 
       for (const auto &symbol_info : *method->symbol_table_) {
@@ -640,40 +923,142 @@ namespace Quack {
         if (sym->is_field_ || method->params_->get(sym->name_) || sym->name_ == OBJECT_SELF)
           continue;
 
-        settings.fout_ << indent_str << sym->get_type()->generated_object_type_name()
-                       << " " << sym->name_ << ";\n";
+        // Locals proven to be exactly Int or Boolean are stored natively
+        Class * sym_type = sym->get_type();
+        sym->is_unboxed_ = sym_type->is_unboxable();
+        if (sym->is_unboxed_) {
+          settings.fout_ << indent_str << sym_type->generated_unboxed_type_name() << " "
+                         << sym->name_ << ";\n";
+          continue;
+        }
+        settings.fout_ << indent_str << sym_type->generated_object_type_name() << " "
+                       << sym->name_ << " = NULL;\n";
+        roots.emplace_back(sym->name_);
+
+        Class * stack_class = sym->stack_class();
+        if (stack_class == nullptr)
+          continue;
+        std::string stack_obj = STACK_OBJ_HEADER + sym->name_;
+        settings.fout_ << indent_str << "struct " << stack_class->generated_malloc_obj_name()
+                       << " " << stack_obj << " = { NULL };\n";
+        stack_class->generated_ref_fields(stack_obj + ".", roots);
       }
     }
     /**
-     * Generates code for the class constructor.
+     * Generates the local declarations and statements of a method, constructor, or main.  The
+     * statements are buffered so that object temporaries can be declared at the top of the
+     * function.  All object locals, parameters, and temporaries are then registered as
+     * garbage collector roots before any statement runs.
+     *
+     * @param settings Code generator settings
+     * @param method Method whose body is generated
+     * @param this_class Class of the implicit object.  nullptr for main.
+     * @param is_constructor True if method is the constructor of this_class
+     * @param in_place True if the constructor initializes an object passed as this rather
+     *                 than allocating one
+     */
+    static void generate_method_body(CodeGen::Settings settings, Method * method,
+                                     Class * this_class, bool is_constructor,
+                                     bool in_place = false) {
+      if (settings.use_ir_)
+        return IR::CEmitter::generate_body(settings, method, this_class, is_constructor);
+
+      std::string indent_str = AST::ASTNode::indent_str(1);
+
+      std::ostringstream body;
+      CodeGen::HoistedTemps hoisted_temps;
+      CodeGen::Settings body_settings(body, settings);
+      body_settings.hoisted_temps_ = &hoisted_temps;
+
+      // Only methods have a receiver that a tail call can replace
+      std::string entry_label;
+      if (this_class != nullptr && !is_constructor) {
+        body_settings.method_ = method;
+        body_settings.entry_label_ = &entry_label;
+      }
+
+      // Symbols must be typed (e.g., unboxed) before the statements are generated
+      std::vector<std::string> roots;
+      if (this_class != nullptr)
+        roots.emplace_back(OBJECT_SELF);
+      for (unsigned i = 0; i < method->params_->count(); i++)
+        roots.emplace_back((*method->params_)[i]->name_);
+
+      if (is_constructor && !in_place)
+        settings.fout_ << indent_str << this_class->generated_object_type_name() << " "
+                       << OBJECT_SELF << " = NULL;\n";
+      generate_symbol_table(settings, 1, method, roots);
+
+      body_settings.fout_ << indent_str << "/* Method statements */\n";
+      method->block_->generate_code(body_settings, 0);
+
+      for (const auto &temp : hoisted_temps) {
+        settings.fout_ << indent_str << temp.first << " " << temp.second << " = NULL;\n";
+        roots.emplace_back(temp.second);
+      }
+
+      if (!roots.empty()) {
+        settings.fout_ << indent_str << GENERATED_GC_FRAME << "(" << roots.size() << ");\n";
+        for (unsigned i = 0; i < roots.size(); i++)
+          settings.fout_ << indent_str << GENERATED_GC_ROOT << "(" << i << ", " << roots[i]
+                         << ");\n";
+      }
+
+      if (in_place) {
+        // Clear the object like the allocator does in case its memory is reused
+        settings.fout_ << indent_str << "*" << OBJECT_SELF << " = (struct "
+                       << this_class->generated_malloc_obj_name() << ") { NULL };\n";
+      } else if (is_constructor) {
+        // Allocate the memory for the object itself
+        settings.fout_ << indent_str << OBJECT_SELF
+                       << " = (" << this_class->generated_object_type_name() << ")"
+                       << GENERATED_ALLOC_FUNC << "(sizeof(struct "
+                       << this_class->generated_malloc_obj_name() << "));\n";
+      }
+      if (is_constructor) {
+
+        // Define the object that will store the class methods
+        settings.fout_ << indent_str << OBJECT_SELF << "->" << GENERATED_CLASS_FIELD
+                       << " = " << this_class->generated_clazz_obj_name() << ";\n";
+      }
+
+      // Self tail calls jump back here after reassigning this and the parameters
+      if (!entry_label.empty())
+        AST::ASTNode::generate_label(settings, 1, entry_label, true);
+
+      settings.fout_ << body.str();
+    }
+    /**
+     * Generates code for the class constructor.  If any object of the class is stack
+     * allocated, the in place variant of the constructor is also generated.
      *
      * @param settings Code generator settings
      */
     void generate_constructor(CodeGen::Settings settings) {
+      if (!constructor_->is_reachable_)
+        return;
       settings.return_type_ = this;
       settings.st_ = constructor_->symbol_table_;
 
       settings.fout_ << "\n";
       generate_method_prototype(settings, constructor_, true);
-      settings.fout_ << " {";
-
-      // Allocate the memory for the object itself
-      std::string indent_str = AST::ASTNode::indent_str(1);
-      settings.fout_ << "\n" << indent_str << generated_object_type_name() << " " << OBJECT_SELF
-                     << " = (" << generated_object_type_name() << ")malloc(sizeof(struct "
-                     << generated_malloc_obj_name() << "));\n";
-
-      // Define the object that will store the class methods
-      settings.fout_ << indent_str << OBJECT_SELF << "->" << GENERATED_CLASS_FIELD
-                     << " = " << generated_clazz_obj_name() << ";";
+      settings.fout_ << " {\n";
 
-      generate_symbol_table(settings, 1, constructor_);
-      settings.fout_ << "\n" << AST::ASTNode::indent_str(1) << "/* Method statements */\n";
-      constructor_->block_->generate_code(settings, 0);
+      generate_method_body(settings, constructor_, this, true);
 
+      std::string indent_str = AST::ASTNode::indent_str(1);
       settings.fout_ << "\n" << indent_str << "return " << OBJECT_SELF << ";";
       settings.fout_ << "\n}\n";
 
+      if (has_in_place_constructor(settings)) {
+        settings.fout_ << "\n";
+        generate_method_prototype(settings, constructor_, true, true);
+        settings.fout_ << " {\n";
+        generate_method_body(settings, constructor_, this, true, true);
+        settings.fout_ << "\n" << indent_str << "return " << OBJECT_SELF << ";";
+        settings.fout_ << "\n}\n";
+      }
+
       settings.return_type_ = nullptr;
       settings.st_ = nullptr;
     }
@@ -685,6 +1070,8 @@ namespace Quack {
     void generate_methods(CodeGen::Settings settings) {
       for (const auto &method_info : *methods_) {
         Method * method = method_info.second;
+        if (!method->is_reachable_)
+          continue;
 
         settings.return_type_ = method->return_type_;
         settings.st_ = method->symbol_table_;
@@ -694,9 +1081,7 @@ namespace Quack {
         generate_method_prototype(settings, method);
         settings.fout_ << " {\n";
 
-        generate_symbol_table(settings, 1, method);
-
-        method->block_->generate_code(settings, 0);
+        generate_method_body(settings, method, this, false);
 
         settings.fout_ << "}\n";
       }
@@ -750,6 +1135,10 @@ namespace Quack {
     Class *super_;
     /** Statements in the constructor */
     Method* constructor_;
+    /** Set when some local's object is stack allocated so the in place constructor is needed */
+    bool has_stack_constructor_ = false;
+    /** False if no code reachable from main uses the class (see Quack::Reachability) */
+    bool is_reachable_ = true;
     /**
      * Build the generated methods list that will be used in the code generation step.  The order
      * of methods must match the order of ALL inherited classes to allow for pointer casting.
@@ -823,6 +1212,21 @@ namespace Quack {
       std::sort(gen_vec->begin() + start_size, gen_vec->end(), template_pair_less_than<_T>);
       return gen_vec;
     }
+    /**
+     * Finds the position of a field or method in a generated list.
+     *
+     * @tparam _T Type of the class object
+     * @param gen_vec Generated fields or methods
+     * @param name Name of the field or method
+     * @return Index of the object with the name
+     */
+    template <typename _T>
+    unsigned generated_index(const GenObjContainer<_T> &gen_vec, const std::string &name) {
+      for (unsigned i = 0; i < gen_vec.size(); i++)
+        if (gen_vec[i].second->name_ == name)
+          return i;
+      throw std::runtime_error("Class " + name_ + " has no member " + name);
+    }
     /**
      * Sort function used to compare two pair obbjects
      *
@@ -900,7 +1304,10 @@ namespace Quack {
   struct NothingClass : public Class {
     explicit NothingClass()
         : Class(strdup(CLASS_NOTHING), strdup(CLASS_OBJ), new Param::Container(),
-                new AST::Block(), new Method::Container()) { }
+                new AST::Block(), new Method::Container()) {
+      // Matches the runtime, which overrides only STR
+      add_unary_op_method(METHOD_STR, CLASS_STR);
+    }
     /**
     * Primitives are all base (i.e., not user) classes in Quack so this function always returns
     * true.
@@ -960,10 +1367,9 @@ namespace Quack {
 
   struct BooleanClass : public PrimitiveClass {
     BooleanClass() : PrimitiveClass(strdup(CLASS_BOOL)) {
+      // EQUALS is inherited from Obj in the runtime since there are only two Boolean objects
       add_unary_op_method(METHOD_STR, CLASS_STR);
 
-      add_binop_method(METHOD_EQUALITY, CLASS_BOOL, CLASS_OBJ);
-
 //      add_binop_method(METHOD_OR, CLASS_BOOL, CLASS_BOOL);
 //      add_binop_method(METHOD_AND, CLASS_BOOL, CLASS_BOOL);
     }
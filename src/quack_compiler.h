@@ -4,12 +4,18 @@
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <getopt.h>
 
 #include "lex.yy.h"
 #include "quack_program.h"
 #include "quack_class.h"
 #include "code_generator.h"
+#include "asm_generator.h"
+#include "bytecode_generator.h"
 #include "type_checker.h"
+#include "constant_folder.h"
+#include "escape_analysis.h"
+#include "reachability.h"
 #include "keywords.h"
 #include "compiler_utils.h"
 #include "messages.h"
@@ -40,11 +46,30 @@ namespace Quack {
         exit(EXIT_FAILURE);
       }
 
+      static const struct option long_options[] = {
+          {"run", no_argument, nullptr, 'r'},
+          {"amalgamate", no_argument, nullptr, 'a'},
+          {"profile-generate", no_argument, nullptr, 'g'},
+          {"profile-use", no_argument, nullptr, 'u'},
+          {nullptr, 0, nullptr, 0}
+      };
       int c;
-      while ((c = getopt(argc, argv, "t")) != -1) {
+      while ((c = getopt_long(argc, argv, "tOS", long_options, nullptr)) != -1) {
         if (c == 't') {
           std::cerr << "Warning: Running in debugging mode" << std::endl;
           debug_ = true;
+        } else if (c == 'O') {
+          use_ir_ = true;
+        } else if (c == 'S') {
+          use_asm_ = true;
+        } else if (c == 'r') {
+          run_program_ = true;
+        } else if (c == 'a') {
+          amalgamate_ = true;
+        } else if (c == 'g') {
+          profile_mode_ = CodeGen::ProfileMode::Generate;
+        } else if (c == 'u') {
+          profile_mode_ = CodeGen::ProfileMode::Use;
         }
       }
       // Verify that there is at least one file to parse
@@ -77,6 +102,11 @@ namespace Quack {
 
         report::reset_error_count();
 
+        // Keep the compiler's progress messages out of the program's output
+        std::streambuf * cout_buf = std::cout.rdbuf();
+        if (run_program_)
+          std::cout.rdbuf(std::cerr.rdbuf());
+
         Quack::Program *prog = nullptr;
         try {
           prog = parse(f_in, file_path);
@@ -94,7 +124,25 @@ namespace Quack {
         auto type_checker = Quack::TypeChecker();
         type_checker.run(prog);
 
-        CodeGen::Gen gen(prog, file_path);
+        Quack::ConstantFolder().run(prog);
+
+        if (run_program_) {
+          CodeGen::BytecodeGen gen(prog, debug_);
+          std::cout.rdbuf(cout_buf);
+          gen.run();
+          continue;
+        }
+        if (use_asm_) {
+          CodeGen::AsmGen gen(prog, file_path, debug_);
+          gen.run();
+          continue;
+        }
+        Quack::Reachability().run(prog);
+        // Only the C generated from the AST places objects on the stack
+        if (!use_ir_)
+          Quack::EscapeAnalysis().run(prog);
+        CodeGen::Gen gen(prog, file_path, use_ir_, use_ir_ && debug_, amalgamate_,
+                         profile_mode_);
         gen.run();
       }
     }
@@ -133,6 +181,26 @@ namespace Quack {
      * Select to run the compiler in debug mode.
      */
     bool debug_ = false;
+    /**
+     * Generate code through the SSA intermediate representation.
+     */
+    bool use_ir_ = false;
+    /**
+     * Generate x86-64 assembly instead of C.  Implies use of the SSA intermediate representation.
+     */
+    bool use_asm_ = false;
+    /**
+     * Run the program in the bytecode interpreter instead of generating code.
+     */
+    bool run_program_ = false;
+    /**
+     * Include the runtime in the generated C file so it compiles as one translation unit.
+     */
+    bool amalgamate_ = false;
+    /**
+     * Instrument the generated C to write a receiver class profile, or optimize with one.
+     */
+    CodeGen::ProfileMode profile_mode_ = CodeGen::ProfileMode::None;
     /**
      * Input file to be compiled.
      */
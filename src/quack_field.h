@@ -59,6 +59,8 @@ namespace Quack {
     std::string name_;
     /** Type of the field object **/
     Class* type_ = nullptr;
+    /** Class of the object embedded in the struct in place of a reference.  nullptr if none **/
+    Class* inline_class_ = nullptr;
   };
 }
 
@@ -17,18 +17,26 @@
 #include "initialized_list.h"
 
 namespace CodeGen { class Gen; }
+namespace IR { class Builder; }
 
 namespace Quack {
   // Forward declarations
   class TypeChecker;
+  class ConstantFolder;
+  class EscapeAnalysis;
+  class Reachability;
   class Class;
   class Program;
 
   class Method {
     friend class TypeChecker;
+    friend class ConstantFolder;
+    friend class EscapeAnalysis;
+    friend class Reachability;
     friend class Quack::Class;
     friend class Quack::Program;
     friend class CodeGen::Gen;
+    friend class IR::Builder;
    public:
     class Container : public MapContainer<Method> {
      public:
@@ -79,6 +87,8 @@ namespace Quack {
     const std::string return_type_name_;
     /** Class of the object associated with the method */
     Class * obj_class_ = nullptr;
+    /** False if no code reachable from main can call the method (see Quack::Reachability) */
+    bool is_reachable_ = true;
    private:
     /** Statements (if any) to perform in method */
     AST::Block* block_ = nullptr;
@@ -14,15 +14,23 @@
 #include "quack_method.h"
 #include "keywords.h"
 
-namespace CodeGen { class Gen; }
+namespace CodeGen { class Gen; class AsmGen; class BytecodeGen; }
 
 namespace Quack {
   // Forward Declarations
   class TypeChecker;
+  class ConstantFolder;
+  class EscapeAnalysis;
+  class Reachability;
 
   class Program {
     friend class TypeChecker;
+    friend class ConstantFolder;
+    friend class EscapeAnalysis;
+    friend class Reachability;
     friend class CodeGen::Gen;
+    friend class CodeGen::AsmGen;
+    friend class CodeGen::BytecodeGen;
 
    public:
     explicit Program(Class::Container *classes, AST::Block *block) : classes_(classes) {
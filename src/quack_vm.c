@@ -0,0 +1,381 @@
+/*
+ * Register based bytecode interpreter for Quack programs.
+ *
+ * Dispatch is threaded: each handler jumps directly to the
+ * handler of the next instruction through a table of label
+ * addresses (a GNU C extension supported by gcc and clang).
+ *
+ * Every call of a bytecode function is a call of
+ * quack_vm_execute with its own register frame on the C
+ * stack.  User classes get real clazz structs so objects
+ * created here work with the builtin methods.  The only
+ * builtin that calls back into user code is PRINT, through
+ * the STR slot of the clazz, so that slot points to a
+ * trampoline back into the interpreter.
+ *
+ * The interpreter does not register its frames with the
+ * garbage collector, so builtins.c must not be compiled with
+ * QUACK_GC when linked with it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "builtins.h"
+#include "quack_vm.h"
+
+#ifdef QUACK_GC
+#error "The bytecode interpreter does not support QUACK_GC"
+#endif
+
+/* Registers hold either a native value or an object reference */
+typedef intptr_t quack_vm_value;
+
+/* Implementation of a method or constructor */
+typedef struct quack_vm_target {
+  const quack_vm_function *function;  /* Bytecode implementation, or else */
+  void *native;                       /* the builtin implementation */
+} quack_vm_target;
+
+typedef struct quack_vm_runtime_class {
+  class_Obj clazz;
+  quack_vm_target constructor;
+  quack_vm_target *methods;
+} quack_vm_runtime_class;
+
+/* The method table of a clazz starts after the super_,
+ * ref_offsets_, class ID, and constructor words.
+ */
+#define QUACK_VM_CONSTRUCTOR_WORD 3
+#define QUACK_VM_METHODS_WORD 4
+
+static const quack_vm_program *quack_vm_prog = NULL;
+static quack_vm_runtime_class *quack_vm_classes = NULL;
+static quack_vm_value *quack_vm_constants = NULL;
+static unsigned quack_vm_str_slot = 0;
+
+static quack_vm_value quack_vm_execute(const quack_vm_function *fn,
+                                       const quack_vm_value *args);
+
+static void quack_vm_fail(const char *msg, const char *name) {
+  fprintf(stderr, "Quack VM: %s %s\n", msg, name);
+  exit(EXIT_FAILURE);
+}
+
+static class_Obj quack_vm_builtin_clazz(const char *name) {
+  if (strcmp(name, "Obj") == 0)
+    return the_class_Obj;
+  if (strcmp(name, "Int") == 0)
+    return (class_Obj) the_class_Int;
+  if (strcmp(name, "String") == 0)
+    return (class_Obj) the_class_String;
+  if (strcmp(name, "Boolean") == 0)
+    return (class_Obj) the_class_Boolean;
+  if (strcmp(name, "Nothing") == 0)
+    return (class_Obj) the_class_Nothing;
+  quack_vm_fail("unknown builtin class", name);
+  return NULL;
+}
+
+static void * quack_vm_clazz_word(class_Obj clazz, unsigned word) {
+  return ((void **) clazz)[word];
+}
+
+/* Called by the builtin PRINT for objects whose STR is bytecode */
+static obj_String quack_vm_str(obj_Obj this) {
+  quack_vm_value arg = (quack_vm_value) this;
+  unsigned class_id = QUACK_CLAZZ(this)->class_id_;
+  const quack_vm_target *target = &quack_vm_classes[class_id].methods[quack_vm_str_slot];
+  return (obj_String) quack_vm_execute(target->function, &arg);
+}
+
+/* Builds the clazz of a user class.  Its super class is already built
+ * since class IDs number super classes first.
+ */
+static class_Obj quack_vm_new_clazz(const quack_vm_class *q_class) {
+  void **words = calloc(QUACK_VM_METHODS_WORD + q_class->num_methods, sizeof(void *));
+  size_t *ref_offsets = calloc(q_class->num_fields + 1, sizeof(size_t));
+  if (words == NULL || ref_offsets == NULL)
+    quack_vm_fail("out of memory building class", q_class->name);
+
+  for (unsigned i = 0; i < q_class->num_fields; i++)
+    ref_offsets[i] = sizeof(void *) * (i + 1);
+
+  class_Obj clazz = (class_Obj) words;
+  clazz->super_ = quack_vm_classes[q_class->super].clazz;
+  clazz->ref_offsets_ = ref_offsets;
+  return clazz;
+}
+
+static void quack_vm_load(const quack_vm_program *program) {
+  quack_vm_prog = program;
+  quack_vm_classes = calloc(program->num_classes, sizeof(quack_vm_runtime_class));
+  quack_vm_constants = calloc(program->num_constants + 1, sizeof(quack_vm_value));
+  if (quack_vm_classes == NULL || quack_vm_constants == NULL)
+    quack_vm_fail("out of memory loading", "program");
+
+  for (unsigned id = 0; id < program->num_classes; id++) {
+    const quack_vm_class *q_class = &program->classes[id];
+    quack_vm_runtime_class *rt_class = &quack_vm_classes[id];
+    class_Obj clazz = q_class->is_builtin ? quack_vm_builtin_clazz(q_class->name)
+                                          : quack_vm_new_clazz(q_class);
+    clazz->class_id_ = id;
+    clazz->subtree_end_ = q_class->subtree_end;
+    rt_class->clazz = clazz;
+
+    if (q_class->constructor >= 0)
+      rt_class->constructor.function = &program->functions[q_class->constructor];
+    else
+      rt_class->constructor.native = quack_vm_clazz_word(clazz, QUACK_VM_CONSTRUCTOR_WORD);
+
+    rt_class->methods = calloc(q_class->num_methods + 1, sizeof(quack_vm_target));
+    if (rt_class->methods == NULL)
+      quack_vm_fail("out of memory building class", q_class->name);
+    for (unsigned slot = 0; slot < q_class->num_methods; slot++) {
+      const quack_vm_method *method = &q_class->methods[slot];
+      quack_vm_target *target = &rt_class->methods[slot];
+      void **word = (void **) clazz + QUACK_VM_METHODS_WORD + slot;
+      if (strcmp(method->name, "STR") == 0)
+        quack_vm_str_slot = slot;
+
+      if (method->function < 0) {
+        target->native = quack_vm_clazz_word(quack_vm_classes[method->builtin_class].clazz,
+                                             QUACK_VM_METHODS_WORD + slot);
+        if (!q_class->is_builtin)
+          *word = target->native;
+        continue;
+      }
+      if (q_class->is_builtin)
+        quack_vm_fail("builtin class with bytecode method", method->name);
+      target->function = &program->functions[method->function];
+      if (strcmp(method->name, "STR") == 0)
+        *word = (void *) quack_vm_str;
+    }
+  }
+
+  for (unsigned i = 0; i < program->num_constants; i++) {
+    const quack_vm_constant *constant = &program->constants[i];
+    switch (constant->kind) {
+      case QUACK_VM_CONST_INT:
+        quack_vm_constants[i] = (quack_vm_value) int_literal(constant->value);
+        break;
+      case QUACK_VM_CONST_STR: {
+        obj_String str = quack_alloc(sizeof(struct obj_String_struct));
+        str->clazz = the_class_String;
+        str->text = (char *) constant->text;
+        str->length = constant->length;
+        str->left = NULL;
+        str->right = NULL;
+        quack_vm_constants[i] = (quack_vm_value) str;
+        break;
+      }
+      case QUACK_VM_CONST_NONE:
+        quack_vm_constants[i] = (quack_vm_value) none;
+        break;
+      case QUACK_VM_CONST_TRUE:
+        quack_vm_constants[i] = (quack_vm_value) lit_true;
+        break;
+      case QUACK_VM_CONST_FALSE:
+        quack_vm_constants[i] = (quack_vm_value) lit_false;
+        break;
+    }
+  }
+}
+
+/* Builtin methods take at most one argument besides the receiver */
+static quack_vm_value quack_vm_call_native(void *fn, unsigned num_args,
+                                           const quack_vm_value *args) {
+  switch (num_args) {
+    case 0:
+      return (quack_vm_value) ((void * (*)(void)) fn)();
+    case 1:
+      return (quack_vm_value) ((void * (*)(void *)) fn)((void *) args[0]);
+    case 2:
+      return (quack_vm_value) ((void * (*)(void *, void *)) fn)((void *) args[0],
+                                                                (void *) args[1]);
+    default:
+      quack_vm_fail("too many arguments to a builtin", "method");
+      return 0;
+  }
+}
+
+static quack_vm_value quack_vm_invoke(const quack_vm_target *target, unsigned num_args,
+                                      quack_vm_value *args) {
+  if (target->function != NULL)
+    return quack_vm_execute(target->function, args);
+  return quack_vm_call_native(target->native, num_args, args);
+}
+
+/* Copies the argument registers listed in the code into args */
+static void quack_vm_gather(quack_vm_value *args, const quack_vm_value *regs,
+                            const int32_t *arg_regs, unsigned num_args) {
+  for (unsigned i = 0; i < num_args; i++)
+    args[i] = regs[arg_regs[i]];
+}
+
+static quack_vm_value quack_vm_execute(const quack_vm_function *fn,
+                                       const quack_vm_value *args) {
+  static const void * const dispatch[QUACK_VM_NUM_OPCODES] = {
+    [QUACK_VM_CONST] = &&op_const,
+    [QUACK_VM_INT] = &&op_int,
+    [QUACK_VM_MOVE] = &&op_move,
+    [QUACK_VM_ADD] = &&op_add,
+    [QUACK_VM_SUB] = &&op_sub,
+    [QUACK_VM_MUL] = &&op_mul,
+    [QUACK_VM_DIV] = &&op_div,
+    [QUACK_VM_LT] = &&op_lt,
+    [QUACK_VM_LE] = &&op_le,
+    [QUACK_VM_GT] = &&op_gt,
+    [QUACK_VM_GE] = &&op_ge,
+    [QUACK_VM_EQ] = &&op_eq,
+    [QUACK_VM_NEG] = &&op_neg,
+    [QUACK_VM_NOT] = &&op_not,
+    [QUACK_VM_BOX_INT] = &&op_box_int,
+    [QUACK_VM_BOX_BOOL] = &&op_box_bool,
+    [QUACK_VM_UNBOX_INT] = &&op_unbox_int,
+    [QUACK_VM_UNBOX_BOOL] = &&op_unbox_bool,
+    [QUACK_VM_ALLOC] = &&op_alloc,
+    [QUACK_VM_NEW] = &&op_new,
+    [QUACK_VM_CALL] = &&op_call,
+    [QUACK_VM_SEND] = &&op_send,
+    [QUACK_VM_LOAD] = &&op_load,
+    [QUACK_VM_STORE] = &&op_store,
+    [QUACK_VM_JUMP] = &&op_jump,
+    [QUACK_VM_BRANCH] = &&op_branch,
+    [QUACK_VM_SWITCH] = &&op_switch,
+    [QUACK_VM_RETURN] = &&op_return
+  };
+
+  /* Outgoing call arguments are gathered after the registers */
+  quack_vm_value regs[fn->num_regs + fn->max_args + 1];
+  quack_vm_value *call_args = regs + fn->num_regs;
+  const int32_t *pc = fn->code;
+  if (fn->num_params != 0)
+    memcpy(regs, args, fn->num_params * sizeof(quack_vm_value));
+
+/* Native Int arithmetic wraps like the C int it stands for */
+#define R(i) regs[pc[i]]
+#define INT(i) ((int) regs[pc[i]])
+#define WRAP(expr) ((quack_vm_value) (int) (expr))
+#define NEXT(size) pc += (size); goto *dispatch[*pc]
+
+  goto *dispatch[*pc];
+
+op_const:
+  R(1) = quack_vm_constants[pc[2]];
+  NEXT(3);
+op_int:
+  R(1) = pc[2];
+  NEXT(3);
+op_move:
+  R(1) = R(2);
+  NEXT(3);
+op_add:
+  R(1) = WRAP((unsigned) INT(2) + (unsigned) INT(3));
+  NEXT(4);
+op_sub:
+  R(1) = WRAP((unsigned) INT(2) - (unsigned) INT(3));
+  NEXT(4);
+op_mul:
+  R(1) = WRAP((unsigned) INT(2) * (unsigned) INT(3));
+  NEXT(4);
+op_div:
+  R(1) = INT(2) / INT(3);
+  NEXT(4);
+op_lt:
+  R(1) = INT(2) < INT(3);
+  NEXT(4);
+op_le:
+  R(1) = INT(2) <= INT(3);
+  NEXT(4);
+op_gt:
+  R(1) = INT(2) > INT(3);
+  NEXT(4);
+op_ge:
+  R(1) = INT(2) >= INT(3);
+  NEXT(4);
+op_eq:
+  R(1) = INT(2) == INT(3);
+  NEXT(4);
+op_neg:
+  R(1) = WRAP(0u - (unsigned) INT(2));
+  NEXT(3);
+op_not:
+  R(1) = !R(2);
+  NEXT(3);
+op_box_int:
+  R(1) = (quack_vm_value) int_literal(INT(2));
+  NEXT(3);
+op_box_bool:
+  R(1) = (quack_vm_value) (R(2) ? lit_true : lit_false);
+  NEXT(3);
+op_unbox_int:
+  R(1) = QUACK_INT_VALUE((obj_Int) R(2));
+  NEXT(3);
+op_unbox_bool:
+  R(1) = (obj_Boolean) R(2) == lit_true;
+  NEXT(3);
+op_alloc: {
+  obj_Obj obj = quack_alloc(sizeof(void *) * (1 + quack_vm_prog->classes[pc[2]].num_fields));
+  obj->clazz = quack_vm_classes[pc[2]].clazz;
+  R(1) = (quack_vm_value) obj;
+  NEXT(3);
+}
+op_new: {
+  unsigned num_args = (unsigned) pc[3];
+  quack_vm_gather(call_args, regs, pc + 4, num_args);
+  R(1) = quack_vm_invoke(&quack_vm_classes[pc[2]].constructor, num_args, call_args);
+  NEXT(4 + num_args);
+}
+op_call: {
+  unsigned num_args = (unsigned) pc[4];
+  quack_vm_gather(call_args, regs, pc + 5, num_args);
+  R(1) = quack_vm_invoke(&quack_vm_classes[pc[2]].methods[pc[3]], num_args, call_args);
+  NEXT(5 + num_args);
+}
+op_send: {
+  unsigned num_args = (unsigned) pc[3];
+  quack_vm_gather(call_args, regs, pc + 4, num_args);
+  unsigned class_id = QUACK_CLAZZ((obj_Obj) call_args[0])->class_id_;
+  R(1) = quack_vm_invoke(&quack_vm_classes[class_id].methods[pc[2]], num_args, call_args);
+  NEXT(4 + num_args);
+}
+op_load:
+  R(1) = ((quack_vm_value *) R(2))[1 + pc[3]];
+  NEXT(4);
+op_store:
+  ((quack_vm_value *) R(1))[1 + pc[2]] = R(3);
+  NEXT(4);
+op_jump:
+  pc = fn->code + pc[1];
+  goto *dispatch[*pc];
+op_branch:
+  pc = fn->code + (R(1) ? pc[2] : pc[3]);
+  goto *dispatch[*pc];
+op_switch: {
+  unsigned class_id = QUACK_CLAZZ((obj_Obj) R(1))->class_id_;
+  unsigned num_ranges = (unsigned) pc[2];
+  const int32_t *ranges = pc + 3;
+  int32_t target = ranges[3 * num_ranges];
+  for (unsigned i = 0; i < num_ranges; i++, ranges += 3) {
+    if (class_id - (unsigned) ranges[0] <= (unsigned) (ranges[1] - ranges[0])) {
+      target = ranges[2];
+      break;
+    }
+  }
+  pc = fn->code + target;
+  goto *dispatch[*pc];
+}
+op_return:
+  return R(1);
+
+#undef R
+#undef INT
+#undef WRAP
+#undef NEXT
+}
+
+void quack_vm_run(const quack_vm_program *program) {
+  quack_vm_load(program);
+  quack_vm_execute(&program->functions[program->main_function], NULL);
+}
@@ -0,0 +1,130 @@
+/*
+ * Register based bytecode interpreter for Quack programs.
+ *
+ * The compiler translates each method into bytecode and hands
+ * the whole program to quack_vm_run, which executes it in the
+ * compiler's own process.  Objects are the same as those of
+ * the generated C: they are allocated and laid out as in
+ * builtins.h and the builtin classes are the ones defined in
+ * builtins.c.  Nothing here depends on the C++ compiler so the
+ * interpreter is plain C.
+ */
+#ifndef Quack_vm_h
+#define Quack_vm_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ================
+ * Instructions
+ *
+ * Each instruction is an opcode followed by its operands, all
+ * stored as int32_t words.  "r" operands are register indices
+ * in the current frame.  Jump targets are word indices within
+ * the function's code.  Calls list their argument registers
+ * after the count, receiver first.
+ * ================
+ */
+typedef enum {
+  QUACK_VM_CONST,       /* r_dst, constant                      */
+  QUACK_VM_INT,         /* r_dst, native value                  */
+  QUACK_VM_MOVE,        /* r_dst, r_src                         */
+  QUACK_VM_ADD,         /* r_dst, r_a, r_b   (native int)       */
+  QUACK_VM_SUB,
+  QUACK_VM_MUL,
+  QUACK_VM_DIV,
+  QUACK_VM_LT,          /* r_dst, r_a, r_b   (native bool)      */
+  QUACK_VM_LE,
+  QUACK_VM_GT,
+  QUACK_VM_GE,
+  QUACK_VM_EQ,
+  QUACK_VM_NEG,         /* r_dst, r_a                           */
+  QUACK_VM_NOT,
+  QUACK_VM_BOX_INT,     /* r_dst, r_a                           */
+  QUACK_VM_BOX_BOOL,
+  QUACK_VM_UNBOX_INT,
+  QUACK_VM_UNBOX_BOOL,
+  QUACK_VM_ALLOC,       /* r_dst, class                         */
+  QUACK_VM_NEW,         /* r_dst, class, n, r_arg...            */
+  QUACK_VM_CALL,        /* r_dst, class, slot, n, r_arg...      */
+  QUACK_VM_SEND,        /* r_dst, slot, n, r_arg...             */
+  QUACK_VM_LOAD,        /* r_dst, r_obj, field                  */
+  QUACK_VM_STORE,       /* r_obj, field, r_src                  */
+  QUACK_VM_JUMP,        /* target                               */
+  QUACK_VM_BRANCH,      /* r_cond, target_true, target_false    */
+  QUACK_VM_SWITCH,      /* r_obj, n, (first, last, target)..., target_default */
+  QUACK_VM_RETURN,      /* r_src                                */
+  QUACK_VM_NUM_OPCODES
+} quack_vm_opcode;
+
+/* ================
+ * Program
+ *
+ * Classes are indexed by class ID.  CALL uses the method table
+ * of the named class while SEND uses that of the receiver's
+ * class.  A slot is the position of the method in the table,
+ * which is the same in a class and all of its subclasses.
+ * ================
+ */
+typedef struct quack_vm_function {
+  const char *name;
+  unsigned num_params;          /* Including the receiver, if any */
+  unsigned num_regs;            /* Parameters are the first registers */
+  unsigned max_args;            /* Most arguments passed by any call */
+  const int32_t *code;
+} quack_vm_function;
+
+typedef struct quack_vm_method {
+  const char *name;
+  int function;                 /* Index of the function or -1 if builtin */
+  unsigned builtin_class;       /* If builtin, class ID of the builtin class defining it */
+} quack_vm_method;
+
+typedef struct quack_vm_class {
+  const char *name;
+  int is_builtin;               /* Builtin classes are those of builtins.c */
+  int super;                    /* Class ID of the super class or -1 for Obj */
+  unsigned subtree_end;         /* Largest class ID of a subclass */
+  unsigned num_fields;
+  int constructor;              /* Index of the function or -1 if builtin */
+  unsigned num_methods;
+  const quack_vm_method *methods;
+} quack_vm_class;
+
+typedef enum {
+  QUACK_VM_CONST_INT,           /* Boxed Int with value */
+  QUACK_VM_CONST_STR,           /* String with text and length */
+  QUACK_VM_CONST_NONE,
+  QUACK_VM_CONST_TRUE,
+  QUACK_VM_CONST_FALSE
+} quack_vm_constant_kind;
+
+typedef struct quack_vm_constant {
+  quack_vm_constant_kind kind;
+  int value;
+  const char *text;             /* Escapes already replaced */
+  size_t length;
+} quack_vm_constant;
+
+typedef struct quack_vm_program {
+  unsigned num_classes;
+  const quack_vm_class *classes;
+  unsigned num_functions;
+  const quack_vm_function *functions;
+  unsigned num_constants;
+  const quack_vm_constant *constants;
+  unsigned main_function;
+} quack_vm_program;
+
+/* Runs main_function of the program.  May only be called once. */
+void quack_vm_run(const quack_vm_program *program);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+//
+// Whole-program reachability of classes and methods, used to leave dead code out of the C.
+//
+
+#include <string>
+
+#include "reachability.h"
+#include "ASTNode.h"
+#include "quack_class.h"
+#include "keywords.h"
+
+namespace AST {
+  void ASTNode::find_reachable(Reach::Settings &settings) const {
+    settings.use(type_);
+  }
+
+  void Block::find_reachable(Reach::Settings &settings) const {
+    for (auto * stmt : stmts_)
+      stmt->find_reachable(settings);
+  }
+
+  void If::find_reachable(Reach::Settings &settings) const {
+    cond_->find_reachable(settings);
+    truepart_->find_reachable(settings);
+    if (falsepart_)
+      falsepart_->find_reachable(settings);
+  }
+
+  void Return::find_reachable(Reach::Settings &settings) const {
+    right_->find_reachable(settings);
+  }
+
+  void While::find_reachable(Reach::Settings &settings) const {
+    cond_->find_reachable(settings);
+    body_->find_reachable(settings);
+  }
+
+  void RhsArgs::find_reachable(Reach::Settings &settings) const {
+    for (auto * arg : args_)
+      arg->find_reachable(settings);
+  }
+
+  void FunctionCall::find_reachable(Reach::Settings &settings) const {
+    settings.use(type_);
+    settings.construct(Quack::Class::Container::singleton()->get(ident_));
+    args_->find_reachable(settings);
+  }
+
+  void ObjectCall::find_reachable(Reach::Settings &settings) const {
+    settings.use(type_);
+    object_->find_reachable(settings);
+    if (auto * func = dynamic_cast<FunctionCall*>(next_)) {
+      settings.call(object_->get_node_type(), func->ident_);
+      func->args_->find_reachable(settings);
+    } else {
+      next_->find_reachable(settings);
+    }
+  }
+
+  void BinOp::find_reachable(Reach::Settings &settings) const {
+    settings.use(type_);
+    left_->find_reachable(settings);
+    right_->find_reachable(settings);
+    settings.call(left_->get_node_type(), op_lookup(opsym));
+  }
+
+  void BoolOp::find_reachable(Reach::Settings &settings) const {
+    settings.use(type_);
+    left_->find_reachable(settings);
+    if (right_)
+      right_->find_reachable(settings);
+  }
+
+  void UniOp::find_reachable(Reach::Settings &settings) const {
+    settings.use(type_);
+    right_->find_reachable(settings);
+  }
+
+  void Assn::find_reachable(Reach::Settings &settings) const {
+    settings.use(lhs_->get_node_type());
+    lhs_->expr_->find_reachable(settings);
+    rhs_->find_reachable(settings);
+  }
+
+  void Typecase::find_reachable(Reach::Settings &settings) const {
+    expr_->find_reachable(settings);
+    for (auto * alt : *alts_) {
+      settings.use(Quack::Class::Container::singleton()->get(alt->type_names_[1]));
+      alt->block_->find_reachable(settings);
+    }
+  }
+}
+
+namespace Quack {
+
+  void Reachability::run(Program * prog) {
+    for (auto &class_pair : *Class::Container::singleton()) {
+      Class * q_class = class_pair.second;
+      if (!q_class->is_user_class())
+        continue;
+
+      q_class->is_reachable_ = false;
+      q_class->constructor_->is_reachable_ = false;
+      for (auto &method_pair : *q_class->methods_)
+        method_pair.second->is_reachable_ = false;
+    }
+
+    pending_.emplace_back(prog->main_);
+    while (!pending_.empty()) {
+      Method * method = pending_.back();
+      pending_.pop_back();
+      visit(method);
+    }
+  }
+
+  void Reachability::visit(Method * method) {
+    Reach::Settings settings;
+    method->block_->find_reachable(settings);
+    // Symbols include the parameters and the locals the body never mentions by type
+    settings.use(method->return_type_);
+    settings.use(method->obj_class_);
+    for (const auto &symbol_info : *method->symbol_table_)
+      settings.use(symbol_info.second->get_type());
+
+    for (auto * q_class : settings.used_)
+      use(q_class);
+    for (auto * q_class : settings.constructed_) {
+      use(q_class);
+      Method * constructor = q_class->constructor_;
+      if (q_class->is_user_class() && !constructor->is_reachable_) {
+        constructor->is_reachable_ = true;
+        pending_.emplace_back(constructor);
+      }
+    }
+    for (const auto &call_info : settings.calls_)
+      call(call_info.first, call_info.second);
+  }
+
+  void Reachability::use(Class * q_class) {
+    for (; q_class != nullptr && q_class->is_user_class() && !q_class->is_reachable_;
+         q_class = q_class->super_) {
+      q_class->is_reachable_ = true;
+      for (const auto &field_info : *Class::build_generated_fields(q_class)) {
+        use(field_info.second->type_);
+        use(q_class->inline_field_class(field_info.second->name_));
+      }
+    }
+  }
+
+  void Reachability::call(Class * receiver_type, const std::string &method_name) {
+    if (receiver_type == nullptr || !calls_.emplace(receiver_type, method_name).second)
+      return;
+
+    for (auto &class_pair : *Class::Container::singleton()) {
+      Class * q_class = class_pair.second;
+      if (!q_class->is_subtype(receiver_type))
+        continue;
+      Method * method = q_class->get_method(method_name);
+      if (method == nullptr || !method->obj_class_->is_user_class() || method->is_reachable_)
+        continue;
+      method->is_reachable_ = true;
+      pending_.emplace_back(method);
+    }
+
+    // The runtime's PRINT calls STR
+    if (method_name == METHOD_PRINT)
+      call(receiver_type, METHOD_STR);
+  }
+}
@@ -0,0 +1,99 @@
+//
+// Whole-program reachability of classes and methods, used to leave dead code out of the C.
+//
+
+#ifndef TYPE_CHECKER_REACHABILITY_H
+#define TYPE_CHECKER_REACHABILITY_H
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "quack_program.h"
+#include "quack_class.h"
+#include "ASTNode.h"
+
+namespace Reach {
+  struct Settings {
+    /**
+     * Records a class the generated code may name, e.g., as the type of an expression.
+     *
+     * @param q_class Class used.  Ignored if nullptr.
+     */
+    void use(Quack::Class * q_class) {
+      if (q_class != nullptr)
+        used_.emplace_back(q_class);
+    }
+    /**
+     * Records a call of a method on an object of a static type.
+     *
+     * @param receiver_type Static type of the receiver
+     * @param method_name Method called
+     */
+    void call(Quack::Class * receiver_type, const std::string &method_name) {
+      calls_.emplace_back(receiver_type, method_name);
+    }
+    /**
+     * Records a constructor call.
+     *
+     * @param q_class Class constructed
+     */
+    void construct(Quack::Class * q_class) { constructed_.emplace_back(q_class); }
+
+    /** Classes used */
+    std::vector<Quack::Class*> used_;
+    /** Static receiver type and method of each call */
+    std::vector<std::pair<Quack::Class*, std::string>> calls_;
+    /** Classes constructed */
+    std::vector<Quack::Class*> constructed_;
+  };
+}
+
+namespace Quack {
+  /**
+   * Finds the methods and classes that code reachable from main can use.  Starting from main,
+   * each constructor call makes the constructor reachable, and each method call makes the
+   * implementation of the method in the receiver's static type and each of its subclasses
+   * reachable.  The bodies of reachable methods are then searched in turn.
+   *
+   * A class is kept if reachable code names it, if it is the super class of a kept class, or if
+   * it is the type of a field of a kept class.  Everything else is marked unreachable, and code
+   * generation leaves it out of the C.  Since the method tables of kept classes have the same
+   * layout, an unreachable method's entry is NULL.
+   */
+  class Reachability {
+   public:
+    Reachability() = default;
+
+    void run(Program * prog);
+
+   private:
+    /**
+     * Searches the body of a reachable method for the classes and methods it uses.
+     *
+     * @param method Method, constructor, or main
+     */
+    void visit(Method * method);
+    /**
+     * Marks a class and the classes its objects depend on as kept.
+     *
+     * @param q_class Class used
+     */
+    void use(Class * q_class);
+    /**
+     * Marks every implementation a call may dispatch to as reachable.
+     *
+     * @param receiver_type Static type of the receiver
+     * @param method_name Method called
+     */
+    void call(Class * receiver_type, const std::string &method_name);
+
+    /** Calls already resolved */
+    std::set<std::pair<Class*, std::string>> calls_;
+    /** Reachable methods whose bodies have not been searched yet */
+    std::vector<Method*> pending_;
+  };
+}
+
+#endif //TYPE_CHECKER_REACHABILITY_H
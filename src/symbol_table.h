@@ -13,12 +13,13 @@
 typedef std::pair<std::string, bool> SymbolKey;
 
 // Forward declarations
-namespace Quack{ class Class; }
+namespace Quack{ class Class; class EscapeAnalysis; }
 namespace CodeGen { class Gen; }
 
 class Symbol {
   friend class CodeGen::Gen;
   friend class Quack::Class;
+  friend class Quack::EscapeAnalysis;
   friend class Table;
  public:
   class Table {
@@ -113,6 +114,18 @@ class Symbol {
      * @return End of the symbol table
      */
     typename std::map<SymbolKey, Symbol*>::iterator end() { return objs_.end(); }
+    /**
+     * Checks whether the specified symbol exists in the symbol table.  Unlike get, this
+     * function can be safely called on names that are not symbols (e.g., generated temporaries).
+     *
+     * @param symbol_name Name of the symbol
+     * @param is_field True if the symbol is a field.
+     *
+     * @return True if the symbol exists.
+     */
+    bool exists(const std::string &symbol_name, bool is_field) const {
+      return exists(SymbolKey(symbol_name, is_field));
+    }
    private:
     /**
      * Checks whether the specified key exists in the symbol table.
@@ -144,6 +157,20 @@ class Symbol {
    * @param q_class New class for the symbol.
    */
   Quack::Class* get_type() const { return class_; }
+  /**
+   * Accessor for whether the symbol is stored as a native C value (e.g., int or bool) rather
+   * than as a boxed object in the generated code.
+   *
+   * @return True if the symbol is unboxed.
+   */
+  bool is_unboxed() const { return is_unboxed_; }
+  /**
+   * Accessor for the class of the object a local is stored in when the object lives on the
+   * C stack rather than the heap (see Quack::EscapeAnalysis).
+   *
+   * @return Exact class of the local's only object or nullptr if it is heap allocated.
+   */
+  Quack::Class * stack_class() const { return stack_class_; }
 
  private:
   /**
@@ -156,6 +183,10 @@ class Symbol {
   std::string name_;
   bool is_field_;
   Quack::Class * class_;
+  /** Set during code generation when the symbol is declared as a native C local */
+  bool is_unboxed_ = false;
+  /** Set by escape analysis when the local's only object never leaves its method */
+  Quack::Class * stack_class_ = nullptr;
 };
 
 #endif //PROJECT02_SYMBOL_TABLE_H